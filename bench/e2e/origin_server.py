@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+"""
+Local http origin for surffs end-to-end benchmarks.
+
+Serves a synthetic site generated from a seed, so every run sees the same
+tree: page 0 is "/", page N is "/p/N.html". Every page links to its
+`fanout` children (a tree of `pages` pages) and to `density` random pages
+of the site (these become symlinks in surffs). Pages are padded with text
+up to `page-size` bytes.
+
+Network is shaped per request: `latency` (+ random `jitter`) ms is slept
+before the response headers and the body is sent at `bandwidth` bytes/s.
+
+usage: origin_server.py [--port 8080] [--pages 1000] [--fanout 8] ...
+"""
+import argparse
+import random
+import re
+import signal
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+FILLER = ("Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+          "eiusmod tempor incididunt ut labore et dolore magna aliqua. ")
+
+PAGE_RE = re.compile(r"^/p/(\d+)\.html$")
+
+
+class Site:
+    def __init__(self, pages, fanout, page_size, density, seed):
+        self.pages = pages
+        self.fanout = fanout
+        self.page_size = page_size
+        self.density = density
+        self.seed = seed
+
+    def links(self, n):
+        children = [n * self.fanout + k for k in range(1, self.fanout + 1)]
+        children = [c for c in children if c < self.pages]
+
+        rng = random.Random(self.seed * 1000003 + n)
+        extra = [rng.randrange(self.pages) for _ in range(self.density)]
+
+        return children + extra
+
+    def render(self, n):
+        parts = ["<html><head><title>Page %d</title></head><body>\n" % n,
+                 "<h1>Page %d</h1>\n<ul>\n" % n]
+        for i, target in enumerate(self.links(n)):
+            parts.append('<li><a href="/p/%d.html">Page %d link %d</a></li>\n'
+                         % (target, target, i))
+        parts.append("</ul>\n")
+
+        size = sum(len(p) for p in parts)
+        tail = "</body></html>\n"
+        while size + len(tail) < self.page_size:
+            chunk = "<p>" + FILLER + "</p>\n"
+            parts.append(chunk)
+            size += len(chunk)
+        parts.append(tail)
+
+        return "".join(parts).encode()
+
+    def page_number(self, path):
+        if path == "/":
+            return 0
+        m = PAGE_RE.match(path)
+        if not m:
+            return None
+        n = int(m.group(1))
+        return n if n < self.pages else None
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.requests = 0
+        self.errors = 0
+        self.bytes = 0
+
+    def add(self, nbytes, error):
+        with self.lock:
+            self.requests += 1
+            self.bytes += nbytes
+            if error:
+                self.errors += 1
+
+
+class Handler(BaseHTTPRequestHandler):
+    # surffs reads the response until the connection is closed
+    protocol_version = "HTTP/1.0"
+    server_version = "surffs-bench-origin"
+
+    def log_message(self, fmt, *args):
+        if self.server.args.verbose:
+            sys.stderr.write("%s %s\n" % (self.address_string(), fmt % args))
+
+    def shape_latency(self):
+        args = self.server.args
+        delay = args.latency
+        if args.jitter:
+            delay += random.uniform(0, args.jitter)
+        if delay > 0:
+            time.sleep(delay / 1000.0)
+
+    def send_body(self, body):
+        bandwidth = self.server.args.bandwidth
+        if not bandwidth:
+            self.wfile.write(body)
+            return
+
+        # send in slices of ~10ms worth of data
+        chunk = max(1, bandwidth // 100)
+        start = time.monotonic()
+        sent = 0
+        while sent < len(body):
+            self.wfile.write(body[sent:sent + chunk])
+            sent += min(chunk, len(body) - sent)
+            ahead = sent / bandwidth - (time.monotonic() - start)
+            if ahead > 0:
+                time.sleep(ahead)
+
+    def do_GET(self):
+        site = self.server.site
+        n = site.page_number(self.path)
+
+        self.shape_latency()
+
+        if n is None:
+            body = b"<html><body>not found</body></html>\n"
+            status = 404
+        else:
+            body = site.render(n)
+            status = 200
+
+        self.send_response(status)
+        self.send_header("Content-Type", "text/html")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.send_body(body)
+
+        self.server.stats.add(len(body), status != 200)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="synthetic http origin for surffs benchmarks")
+    parser.add_argument("--bind", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--pages", type=int, default=1000, help="pages in site")
+    parser.add_argument("--fanout", type=int, default=8, help="child pages per page")
+    parser.add_argument("--page-size", type=int, default=16384, help="bytes per page")
+    parser.add_argument("--density", type=int, default=4,
+                        help="extra links per page to random pages of site")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--latency", type=float, default=0, help="ms before response")
+    parser.add_argument("--jitter", type=float, default=0, help="random extra ms, 0..jitter")
+    parser.add_argument("--bandwidth", type=int, default=0,
+                        help="bytes/s per connection, 0 is unlimited")
+    parser.add_argument("--verbose", action="store_true")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer((args.bind, args.port), Handler)
+    server.daemon_threads = True
+    server.args = args
+    server.site = Site(args.pages, args.fanout, args.page_size, args.density, args.seed)
+    server.stats = Stats()
+
+    def stop(signum, frame):
+        threading.Thread(target=server.shutdown).start()
+
+    signal.signal(signal.SIGTERM, stop)
+    signal.signal(signal.SIGINT, stop)
+
+    print("serving %d pages on http://%s:%d/ (latency %gms jitter %gms bandwidth %s)"
+          % (args.pages, args.bind, args.port, args.latency, args.jitter,
+             "%d B/s" % args.bandwidth if args.bandwidth else "unlimited"),
+          flush=True)
+
+    server.serve_forever()
+
+    print("requests %d errors %d bytes %d"
+          % (server.stats.requests, server.stats.errors, server.stats.bytes), flush=True)
+
+
+if __name__ == "__main__":
+    main()
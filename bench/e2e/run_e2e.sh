@@ -0,0 +1,48 @@
+#!/bin/bash
+# End-to-end benchmark: starts origin_server.py and runs every workload on a
+# freshly loaded surffs.ko (cold page cache). Needs root.
+#
+# usage: run_e2e.sh [results.json] [baseline.json]
+#
+# environment (defaults in brackets):
+#   SURFFS_KO [./surffs.ko]  MNT [/mnt/surffs-bench]  PORT [8080]
+#   PAGES [1000]  FANOUT [8]  PAGE_SIZE [16384]  DENSITY [4]
+#   LATENCY [0] ms  JITTER [0] ms  BANDWIDTH [0] bytes/s
+#   WORKLOADS [ls find grep random parallel]  DRIVER_ARGS [] - passed to workloads.py
+
+dir=$(cd "$(dirname "$0")" && pwd)
+results=${1:-}
+baseline=${2:-}
+
+SURFFS_KO=${SURFFS_KO:-./surffs.ko}
+MNT=${MNT:-/mnt/surffs-bench}
+PORT=${PORT:-8080}
+WORKLOADS=${WORKLOADS:-ls find grep random parallel}
+
+if [ -n "$results" ]; then
+    rm -f "$results"
+fi
+
+python3 "$dir/origin_server.py" --port "$PORT" \
+    --pages "${PAGES:-1000}" --fanout "${FANOUT:-8}" \
+    --page-size "${PAGE_SIZE:-16384}" --density "${DENSITY:-4}" \
+    --latency "${LATENCY:-0}" --jitter "${JITTER:-0}" \
+    --bandwidth "${BANDWIDTH:-0}" &
+origin=$!
+trap 'umount "$MNT" 2>/dev/null; rmmod surffs 2>/dev/null; kill $origin 2>/dev/null' EXIT
+sleep 1
+
+mkdir -p "$MNT"
+rc=0
+for w in $WORKLOADS; do
+    insmod "$SURFFS_KO" || exit 1
+    mount -t surffs http://bench.local/ -o ip=127.0.0.1,port="$PORT" "$MNT" || exit 1
+
+    python3 "$dir/workloads.py" --mount "$MNT" --workload "$w" $DRIVER_ARGS \
+        ${results:+--json "$results"} ${baseline:+--baseline "$baseline"} || rc=1
+
+    umount "$MNT"
+    rmmod surffs
+done
+
+exit $rc
@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+"""
+Workload drivers for a mounted surffs.
+
+Every workload is a list of timed operations; the report gives number of
+operations, p50/p99 latency of one operation, wall time and pages/s, where
+pages are pages_fetched of the mount (/sys/fs/surffs/<major:minor>/).
+
+    ls        - "ls -R" of the mount, one op per directory listed
+    find      - "find <mount>", one op for the whole run
+    grep      - "grep -r" through every page.html, one op for the whole run
+    random    - random walks from the root, one op per directory listed
+    parallel  - threads reading page.html of random directories, one op per read
+
+Symlinks are not followed, so ls/random stop at pages seen before.
+Page cache of surffs lives until rmmod, so for cold numbers run each
+workload on a freshly loaded module (run_e2e.sh does this).
+
+usage: workloads.py --mount /mnt/surffs [--workload ls,random] [--json out.json]
+                    [--baseline old.json]
+"""
+import argparse
+import json
+import os
+import random
+import subprocess
+import sys
+import threading
+import time
+
+WORKLOADS = ["ls", "find", "grep", "random", "parallel"]
+
+
+def percentile(values, p):
+    """nearest-rank percentile"""
+    if not values:
+        return 0.0
+    values = sorted(values)
+    rank = max(1, int(round(p / 100.0 * len(values) + 0.5)))
+    return values[min(rank, len(values)) - 1]
+
+
+class Mount:
+    def __init__(self, path):
+        self.path = path
+        st = os.stat(path)
+        self.stats_dir = "/sys/fs/surffs/%d:%d" % (os.major(st.st_dev), os.minor(st.st_dev))
+
+    def counter(self, name):
+        try:
+            with open(os.path.join(self.stats_dir, name)) as f:
+                return int(f.read())
+        except (OSError, ValueError):
+            return 0
+
+
+def timed(fn, *args):
+    start = time.monotonic()
+    fn(*args)
+    return time.monotonic() - start
+
+
+def listdir(path):
+    with os.scandir(path) as it:
+        return [e for e in it]
+
+
+def subdirs(entries):
+    return [e.path for e in entries if e.is_dir(follow_symlinks=False)]
+
+
+def run_ls(mount, opts):
+    """"ls -R": breadth first, so a --limit cuts the deepest levels"""
+    latencies = []
+    queue = [mount.path]
+
+    while queue and len(latencies) < opts.limit:
+        path = queue.pop(0)
+        start = time.monotonic()
+        entries = listdir(path)
+        for e in entries:
+            e.stat(follow_symlinks=False)
+        latencies.append(time.monotonic() - start)
+        queue.extend(subdirs(entries))
+
+    return latencies
+
+
+def run_command(mount, opts, argv):
+    with open(os.devnull, "w") as null:
+        start = time.monotonic()
+        subprocess.call(argv, stdout=null, stderr=null)
+        return [time.monotonic() - start]
+
+
+def run_find(mount, opts):
+    argv = ["find", mount.path]
+    if opts.depth:
+        argv += ["-maxdepth", str(opts.depth)]
+    return run_command(mount, opts, argv)
+
+
+def run_grep(mount, opts):
+    # grep -r does not follow symlinks, so every page is read once
+    return run_command(mount, opts, ["grep", "-r", "-c", "--include=page.html",
+                                     opts.pattern, mount.path])
+
+
+def random_dir(rng, root, depth):
+    path = root
+    for _ in range(rng.randint(0, depth)):
+        dirs = subdirs(listdir(path))
+        if not dirs:
+            break
+        path = rng.choice(dirs)
+    return path
+
+
+def run_random(mount, opts):
+    rng = random.Random(opts.seed)
+    latencies = []
+
+    while len(latencies) < opts.ops:
+        path = mount.path
+        for _ in range(opts.depth):
+            start = time.monotonic()
+            dirs = subdirs(listdir(path))
+            latencies.append(time.monotonic() - start)
+            if not dirs or len(latencies) >= opts.ops:
+                break
+            path = rng.choice(dirs)
+
+    return latencies
+
+
+def run_parallel(mount, opts):
+    latencies = []
+    lock = threading.Lock()
+    per_thread = max(1, opts.ops // opts.threads)
+
+    def reader(seed):
+        rng = random.Random(seed)
+        local = []
+        for _ in range(per_thread):
+            path = os.path.join(random_dir(rng, mount.path, opts.depth), "page.html")
+            start = time.monotonic()
+            with open(path, "rb") as f:
+                while f.read(65536):
+                    pass
+            local.append(time.monotonic() - start)
+        with lock:
+            latencies.extend(local)
+
+    threads = [threading.Thread(target=reader, args=(opts.seed + i,))
+               for i in range(opts.threads)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    return latencies
+
+
+RUNNERS = {
+    "ls": run_ls,
+    "find": run_find,
+    "grep": run_grep,
+    "random": run_random,
+    "parallel": run_parallel,
+}
+
+
+def run_workload(mount, name, opts):
+    fetched = mount.counter("pages_fetched")
+    start = time.monotonic()
+    latencies = RUNNERS[name](mount, opts)
+    wall = time.monotonic() - start
+    fetched = mount.counter("pages_fetched") - fetched
+
+    return {
+        "workload": name,
+        "ops": len(latencies),
+        "p50_ms": percentile(latencies, 50) * 1000,
+        "p99_ms": percentile(latencies, 99) * 1000,
+        "wall_s": wall,
+        "pages_fetched": fetched,
+        "pages_per_s": fetched / wall if wall > 0 else 0.0,
+    }
+
+
+def print_report(results, baseline):
+    print("%-10s %8s %10s %10s %8s %8s %10s"
+          % ("workload", "ops", "p50_ms", "p99_ms", "wall_s", "pages", "pages/s"))
+    for r in results:
+        print("%-10s %8d %10.2f %10.2f %8.2f %8d %10.1f"
+              % (r["workload"], r["ops"], r["p50_ms"], r["p99_ms"], r["wall_s"],
+                 r["pages_fetched"], r["pages_per_s"]))
+
+        old = baseline.get(r["workload"])
+        if not old:
+            continue
+        print("%-10s %8s %10s %10s %8s %8s %10s"
+              % ("  vs base", "",
+                 delta(r["p50_ms"], old["p50_ms"]), delta(r["p99_ms"], old["p99_ms"]),
+                 delta(r["wall_s"], old["wall_s"]), "",
+                 delta(r["pages_per_s"], old["pages_per_s"])))
+
+
+def delta(new, old):
+    if not old:
+        return "-"
+    return "%+.1f%%" % ((new - old) * 100.0 / old)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="surffs workload drivers")
+    parser.add_argument("--mount", required=True, help="mounted surffs")
+    parser.add_argument("--workload", default=",".join(WORKLOADS),
+                        help="comma separated: " + ",".join(WORKLOADS))
+    parser.add_argument("--ops", type=int, default=500, help="ops of random/parallel")
+    parser.add_argument("--limit", type=int, default=1000, help="max directories of ls")
+    parser.add_argument("--depth", type=int, default=4,
+                        help="depth of random walks and find -maxdepth (0 - no limit for find)")
+    parser.add_argument("--threads", type=int, default=8, help="threads of parallel")
+    parser.add_argument("--pattern", default="Page 1 ", help="pattern of grep")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--json", help="append results to this file")
+    parser.add_argument("--baseline", help="results file of previous run to compare with")
+    opts = parser.parse_args()
+
+    names = [w for w in opts.workload.split(",") if w]
+    for name in names:
+        if name not in RUNNERS:
+            parser.error("unknown workload '%s'" % name)
+
+    baseline = {}
+    if opts.baseline:
+        with open(opts.baseline) as f:
+            baseline = {r["workload"]: r for r in json.load(f)}
+
+    mount = Mount(opts.mount)
+    if not os.path.isdir(mount.stats_dir):
+        sys.stderr.write("warning: %s not found, pages/s will be 0\n" % mount.stats_dir)
+
+    results = [run_workload(mount, name, opts) for name in names]
+
+    if opts.json:
+        previous = []
+        if os.path.exists(opts.json):
+            with open(opts.json) as f:
+                previous = json.load(f)
+        with open(opts.json, "w") as f:
+            json.dump(previous + results, f, indent=2)
+
+    print_report(results, baseline)
+
+
+if __name__ == "__main__":
+    main()
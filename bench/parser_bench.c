@@ -0,0 +1,264 @@
+/*
+ * Userspace benchmark of surffs text processing: make_html_links() and
+ * extract_url_params() over a corpus of html files.
+ *
+ * usage: parser_bench [-n iterations] [-H host] file.html...
+ * host is the host of mounted site: links to other hosts are skipped as in surffs
+ */
+#include <time.h>
+#include <unistd.h>
+#include "shim/shim.h"
+#include "surffs_helpers.h"
+#include "surffs_arena.h"
+#include "surffs_eventlog.h"
+#include "surffs_webpages.h"
+#include "surffs_links.h"
+#include "surffs_parser.h"
+
+struct corpus_file
+{
+    const char *name;
+    char *text;
+    size_t len;
+};
+
+static double now_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int read_file(const char *name, struct corpus_file *file)
+{
+    FILE *f;
+    long len;
+
+    f = fopen(name, "rb");
+    if (!f) return -errno;
+
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    file->name = name;
+    file->len = len;
+    file->text = malloc(len + 1);
+    if (!file->text) {fclose(f); return -ENOMEM;}
+
+    if (fread(file->text, 1, len, f) != (size_t)len) {fclose(f); return -EIO;}
+    file->text[len] = 0;
+
+    fclose(f);
+    return 0;
+}
+
+static void free_links(struct list_head *links)
+{
+    struct SURFFS_HTML_LINK *link;
+    struct SURFFS_HTML_LINK *tmp;
+
+    list_for_each_entry_safe(link, tmp, links, html_links)
+    {
+        list_del(&link->html_links);
+        SURFFS_HTML_LINK_free(link);
+    }
+}
+
+/*parses page as obtain_webpage() does, links are returned in list*/
+static int parse_page(struct corpus_file *file, struct SURFFS_WEB_ADDRESS *parent,
+                      struct sfs_arena *arena, struct list_head *links, u32 *count)
+{
+    struct sfs_event_log events;
+
+    sfs_arena_init(arena);
+    sfs_event_log_init(&events, arena);
+    INIT_LIST_HEAD(links);
+
+    return make_html_links(file->text, links, *parent, 0, arena, &events, count);
+}
+
+static void print_allocs(const char *what, struct shim_alloc_stats *before,
+                         u64 units)
+{
+    struct shim_alloc_stats *after = &shim_alloc_stats;
+
+    printf("  allocs     %.1f kmalloc + %.1f krealloc per %s (%.0f bytes)\n",
+           (double)(after->allocs - before->allocs) / units,
+           (double)(after->reallocs - before->reallocs) / units,
+           what,
+           (double)(after->bytes - before->bytes) / units);
+}
+
+static int bench_links(struct corpus_file *files, int nfiles, int iterations,
+                       struct SURFFS_WEB_ADDRESS *parent)
+{
+    int ret = 0;
+    int i;
+    int f;
+    struct sfs_arena arena;
+    struct list_head links;
+    struct shim_alloc_stats before = shim_alloc_stats;
+    u64 total_bytes = 0;
+    u64 total_links = 0;
+    u32 count;
+    double start;
+    double elapsed;
+
+    start = now_sec();
+    for (i = 0; i < iterations; i++)
+    {
+        for (f = 0; f < nfiles; f++)
+        {
+            ret = parse_page(&files[f], parent, &arena, &links, &count);
+            free_links(&links);
+            sfs_arena_free(&arena);
+            if (ret) return ret;
+
+            total_bytes += files[f].len;
+            total_links += count;
+        }
+    }
+    elapsed = now_sec() - start;
+
+    printf("make_html_links: %d files x %d iterations\n", nfiles, iterations);
+    printf("  input      %.2f MB in %.3f s: %.1f MB/s\n",
+           total_bytes / 1e6, elapsed, total_bytes / 1e6 / elapsed);
+    printf("  links      %llu: %.0f links/s, %.1f per page\n",
+           (unsigned long long)total_links, total_links / elapsed,
+           (double)total_links / ((u64)nfiles * iterations));
+    print_allocs("page", &before, (u64)nfiles * iterations);
+
+    return 0;
+}
+
+static int bench_urls(struct corpus_file *files, int nfiles, int iterations,
+                      struct SURFFS_WEB_ADDRESS *parent)
+{
+    int ret = 0;
+    int i;
+    int f;
+    struct sfs_arena arena[nfiles];
+    struct list_head links[nfiles];
+    struct SURFFS_HTML_LINK *link;
+    sfs_string protocol = {0};
+    sfs_string host = {0};
+    sfs_string path = {0};
+    struct shim_alloc_stats before;
+    u64 total_bytes = 0;
+    u64 total_urls = 0;
+    u32 count;
+    double start;
+    double elapsed;
+
+    for (f = 0; f < nfiles; f++)
+    {
+        ret = parse_page(&files[f], parent, &arena[f], &links[f], &count);
+        if (ret) return ret;
+    }
+
+    /*strings are reused between calls as at mounting*/
+    ret = sfs_string_createz(&protocol, 16); if (ret) return ret;
+    ret = sfs_string_createz(&host, 64); if (ret) return ret;
+    ret = sfs_string_createz(&path, 64); if (ret) return ret;
+
+    before = shim_alloc_stats;
+    start = now_sec();
+    for (i = 0; i < iterations; i++)
+    {
+        for (f = 0; f < nfiles; f++)
+        {
+            list_for_each_entry(link, &links[f], html_links)
+            {
+                ret = extract_url_params(link->full_url.data, &protocol, &host, &path,
+                                         PREFER_PATH);
+                if (ret) return ret;
+
+                total_bytes += link->full_url.textlen;
+                total_urls++;
+            }
+        }
+    }
+    elapsed = now_sec() - start;
+
+    printf("extract_url_params: %llu urls x %d iterations\n",
+           (unsigned long long)(iterations ? total_urls / iterations : 0), iterations);
+    if (total_urls)
+    {
+        printf("  input      %.2f MB in %.3f s: %.1f MB/s\n",
+               total_bytes / 1e6, elapsed, total_bytes / 1e6 / elapsed);
+        printf("  urls       %.0f urls/s\n", total_urls / elapsed);
+        print_allocs("url", &before, total_urls);
+    }
+
+    for (f = 0; f < nfiles; f++)
+    {
+        free_links(&links[f]);
+        sfs_arena_free(&arena[f]);
+    }
+    sfs_string_free(&protocol);
+    sfs_string_free(&host);
+    sfs_string_free(&path);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int ret = 0;
+    int opt;
+    int iterations = 100;
+    const char *hostname = "www.example.com";
+    struct corpus_file *files;
+    struct SURFFS_WEB_ADDRESS parent;
+    int nfiles;
+    int i;
+
+    while ((opt = getopt(argc, argv, "n:H:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': iterations = atoi(optarg); break;
+            case 'H': hostname = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-n iterations] [-H host] file.html...\n", argv[0]);
+                return 2;
+        }
+    }
+
+    nfiles = argc - optind;
+    if (nfiles <= 0 || iterations <= 0)
+    {
+        fprintf(stderr, "usage: %s [-n iterations] [-H host] file.html...\n", argv[0]);
+        return 2;
+    }
+
+    files = calloc(nfiles, sizeof(struct corpus_file));
+    if (!files) return 1;
+
+    for (i = 0; i < nfiles; i++)
+    {
+        ret = read_file(argv[optind + i], &files[i]);
+        if (ret)
+        {
+            fprintf(stderr, "cannot read '%s': %s\n", argv[optind + i], strerror(-ret));
+            return 1;
+        }
+    }
+
+    if (sfs_string_create(&parent.ip, "127.0.0.1") ||
+        sfs_string_create(&parent.host, hostname) ||
+        sfs_string_create(&parent.path, "/"))
+        return 1;
+
+    ret = bench_links(files, nfiles, iterations, &parent);
+    if (!ret) ret = bench_urls(files, nfiles, iterations, &parent);
+    if (ret)
+    {
+        fprintf(stderr, "error: %d\n", ret);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,14 @@
+#ifndef _BENCH_SHIM_LINUX_ATOMIC_H_
+#define _BENCH_SHIM_LINUX_ATOMIC_H_
+
+typedef struct
+{
+    int counter;
+} atomic_t;
+
+#define atomic_read(v)          ((v)->counter)
+#define atomic_set(v, i)        ((v)->counter = (i))
+#define atomic_inc(v)           ((v)->counter++)
+#define atomic_dec_and_test(v)  (--(v)->counter == 0)
+
+#endif
@@ -0,0 +1 @@
+#include <linux/list.h>
@@ -0,0 +1,12 @@
+#ifndef _BENCH_SHIM_LINUX_JUMP_LABEL_H_
+#define _BENCH_SHIM_LINUX_JUMP_LABEL_H_
+
+struct static_key
+{
+    int enabled;
+};
+
+#define STATIC_KEY_INIT_FALSE   {0}
+#define static_key_false(key)   ((key)->enabled)
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef _BENCH_SHIM_LINUX_KERNEL_H_
+#define _BENCH_SHIM_LINUX_KERNEL_H_
+
+/*userspace replacement of kernel definitions used by surffs text processing*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+typedef unsigned gfp_t;
+
+#define __printf(a, b)      __attribute__((format(printf, a, b)))
+#define likely(x)           __builtin_expect(!!(x), 1)
+#define unlikely(x)         __builtin_expect(!!(x), 0)
+
+#define min(a, b)           ((a) < (b) ? (a) : (b))
+#define max(a, b)           ((a) > (b) ? (a) : (b))
+#define min_t(t, a, b)      ((t)(a) < (t)(b) ? (t)(a) : (t)(b))
+#define max_t(t, a, b)      ((t)(a) > (t)(b) ? (t)(a) : (t)(b))
+#define U32_MAX             ((u32)~0U)
+#define ARRAY_SIZE(a)       (sizeof(a) / sizeof((a)[0]))
+#define ALIGN(x, a)         (((x) + ((a) - 1)) & ~((__typeof__(x))(a) - 1))
+
+#define container_of(ptr, type, member) \
+            ((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define KERN_INFO           ""
+#define printk(fmt, ...)    fprintf(stderr, fmt, ##__VA_ARGS__)
+#define pr_info(fmt, ...)   fprintf(stderr, fmt, ##__VA_ARGS__)
+
+#endif
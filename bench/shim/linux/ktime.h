@@ -0,0 +1,11 @@
+#ifndef _BENCH_SHIM_LINUX_KTIME_H_
+#define _BENCH_SHIM_LINUX_KTIME_H_
+
+#include <linux/types.h>
+
+typedef union
+{
+    s64 tv64;
+} ktime_t;
+
+#endif
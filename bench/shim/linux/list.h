@@ -0,0 +1,71 @@
+#ifndef _BENCH_SHIM_LINUX_LIST_H_
+#define _BENCH_SHIM_LINUX_LIST_H_
+
+#include <linux/kernel.h>
+
+struct list_head
+{
+    struct list_head *next, *prev;
+};
+
+#define LIST_HEAD_INIT(name) { &(name), &(name) }
+#define LIST_HEAD(name) struct list_head name = LIST_HEAD_INIT(name)
+
+static inline void INIT_LIST_HEAD(struct list_head *list)
+{
+    list->next = list;
+    list->prev = list;
+}
+
+static inline void __list_add(struct list_head *new, struct list_head *prev,
+                              struct list_head *next)
+{
+    next->prev = new;
+    new->next = next;
+    new->prev = prev;
+    prev->next = new;
+}
+
+static inline void list_add(struct list_head *new, struct list_head *head)
+{
+    __list_add(new, head, head->next);
+}
+
+static inline void list_add_tail(struct list_head *new, struct list_head *head)
+{
+    __list_add(new, head->prev, head);
+}
+
+static inline void list_del(struct list_head *entry)
+{
+    entry->next->prev = entry->prev;
+    entry->prev->next = entry->next;
+    entry->next = 0;
+    entry->prev = 0;
+}
+
+static inline int list_empty(const struct list_head *head)
+{
+    return head->next == head;
+}
+
+#define list_entry(ptr, type, member) container_of(ptr, type, member)
+
+#define list_for_each(pos, head) \
+    for (pos = (head)->next; pos != (head); pos = pos->next)
+
+#define list_for_each_safe(pos, n, head) \
+    for (pos = (head)->next, n = pos->next; pos != (head); pos = n, n = pos->next)
+
+#define list_for_each_entry(pos, head, member) \
+    for (pos = list_entry((head)->next, __typeof__(*pos), member); \
+         &pos->member != (head); \
+         pos = list_entry(pos->member.next, __typeof__(*pos), member))
+
+#define list_for_each_entry_safe(pos, n, head, member) \
+    for (pos = list_entry((head)->next, __typeof__(*pos), member), \
+         n = list_entry(pos->member.next, __typeof__(*pos), member); \
+         &pos->member != (head); \
+         pos = n, n = list_entry(n->member.next, __typeof__(*n), member))
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef _BENCH_SHIM_LINUX_MUTEX_H_
+#define _BENCH_SHIM_LINUX_MUTEX_H_
+
+/*benchmark is single-threaded*/
+struct mutex
+{
+    int unused;
+};
+
+#define DEFINE_MUTEX(name)  struct mutex name = {0}
+#define mutex_lock(m)       ((void)(m))
+#define mutex_unlock(m)     ((void)(m))
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef _BENCH_SHIM_LINUX_SLAB_H_
+#define _BENCH_SHIM_LINUX_SLAB_H_
+
+#include <linux/kernel.h>
+
+#define GFP_KERNEL 0
+
+/*implemented in shim.c, every call is counted (see shim.h)*/
+void *kmalloc(size_t size, gfp_t flags);
+void *kzalloc(size_t size, gfp_t flags);
+void *krealloc(const void *p, size_t new_size, gfp_t flags);
+char *kstrdup(const char *s, gfp_t flags);
+void kfree(const void *p);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef _BENCH_SHIM_LINUX_SPINLOCK_H_
+#define _BENCH_SHIM_LINUX_SPINLOCK_H_
+
+/*benchmark is single-threaded*/
+typedef struct
+{
+    int unused;
+} spinlock_t;
+
+#define spin_lock_init(l)   ((void)(l))
+#define spin_lock(l)        ((void)(l))
+#define spin_unlock(l)      ((void)(l))
+
+#endif
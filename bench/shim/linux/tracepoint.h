@@ -0,0 +1,14 @@
+#ifndef _BENCH_SHIM_LINUX_TRACEPOINT_H_
+#define _BENCH_SHIM_LINUX_TRACEPOINT_H_
+
+/*tracepoints are compiled out*/
+#define TP_PROTO(...)   __VA_ARGS__
+#define TP_ARGS(...)    __VA_ARGS__
+
+#define TRACE_EVENT(name, proto, args, tstruct, assign, print) \
+    static inline void trace_##name(proto) {}
+#define DECLARE_EVENT_CLASS(name, proto, args, tstruct, assign, print)
+#define DEFINE_EVENT(template, name, proto, args) \
+    static inline void trace_##name(proto) {}
+
+#endif
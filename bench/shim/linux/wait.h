@@ -0,0 +1,10 @@
+#ifndef _BENCH_SHIM_LINUX_WAIT_H_
+#define _BENCH_SHIM_LINUX_WAIT_H_
+
+/*only the type is needed: nothing waits in benchmark*/
+typedef struct
+{
+    int unused;
+} wait_queue_head_t;
+
+#endif
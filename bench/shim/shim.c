@@ -0,0 +1,67 @@
+#include "shim.h"
+#include <linux/slab.h>
+#include "surffs_debug.h"
+#include "surffs_mem.h"
+#include "surffs_webpages.h"
+#include "surffs_socket.h"
+
+struct shim_alloc_stats shim_alloc_stats;
+
+int sfs_loglevel = SURFFS_DEFAULT_LOGLEVEL;
+struct static_key sfs_info_enabled = STATIC_KEY_INIT_FALSE;
+
+void *kmalloc(size_t size, gfp_t flags)
+{
+    shim_alloc_stats.allocs++;
+    shim_alloc_stats.bytes += size;
+    return malloc(size);
+}
+
+void *kzalloc(size_t size, gfp_t flags)
+{
+    shim_alloc_stats.allocs++;
+    shim_alloc_stats.bytes += size;
+    return calloc(1, size);
+}
+
+void *krealloc(const void *p, size_t new_size, gfp_t flags)
+{
+    shim_alloc_stats.reallocs++;
+    shim_alloc_stats.bytes += new_size;
+    return realloc((void *)p, new_size);
+}
+
+char *kstrdup(const char *s, gfp_t flags)
+{
+    size_t len = strlen(s) + 1;
+    char *p = kmalloc(len, flags);
+
+    if (p) memcpy(p, s, len);
+    return p;
+}
+
+void kfree(const void *p)
+{
+    if (!p) return;
+    shim_alloc_stats.frees++;
+    free((void *)p);
+}
+
+/*only html links are allocated from slab caches in parser code*/
+void *surffs_cache_zalloc(enum SURFFS_CACHE cache)
+{
+    if (cache != SFS_CACHE_HTML_LINK) return 0;
+    return kzalloc(sizeof(struct SURFFS_HTML_LINK), GFP_KERNEL);
+}
+
+void surffs_cache_free(enum SURFFS_CACHE cache, void *obj)
+{
+    kfree(obj);
+}
+
+/*loading.log rendering is not benchmarked*/
+int surffs_make_request(char *path, char *host, struct surffs_validators *cond,
+                        sfs_string *request)
+{
+    return -ENOSYS;
+}
@@ -0,0 +1,17 @@
+#ifndef _BENCH_SHIM_H_
+#define _BENCH_SHIM_H_
+
+#include <linux/kernel.h>
+
+/*allocation counters of shim kmalloc family (including slab caches)*/
+struct shim_alloc_stats
+{
+    u64 allocs;
+    u64 reallocs;
+    u64 frees;
+    u64 bytes;
+};
+
+extern struct shim_alloc_stats shim_alloc_stats;
+
+#endif
@@ -0,0 +1 @@
+/*tracepoints are compiled out, see linux/tracepoint.h*/
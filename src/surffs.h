@@ -9,8 +9,12 @@
 #define SURFFS_ROOT_INO 1
 #define SURFFS_HTTP_PORT 80
 #define SURFFS_HTTP_CHUNK_SIZE 4096
-#define SURFFS_SOCKET_TOUT_SEC  2
-#define SURFFS_SOCKET_TOUT_USEC 0
+/*default fetch timeouts (ms), can be changed by mount options*/
+#define SURFFS_CONNECT_TOUT_MS  2000
+#define SURFFS_TTFB_TOUT_MS     2000
+#define SURFFS_TRANSFER_TOUT_MS 0 /*no limit*/
+/*lower limit of RTT-adaptive timeouts, as initial RTO of TCP*/
+#define SURFFS_ADAPTIVE_TOUT_MIN_MS 1000
 #define SURFFS_VERSION "0.1 beta"
 
 #endif
@@ -0,0 +1,120 @@
+#include "surffs_arena.h"
+#include <linux/slab.h>
+#include <linux/string.h>
+
+struct sfs_arena_chunk
+{
+    struct list_head chunks;
+    size_t size;
+    size_t used;
+    char data[0];
+};
+
+/*whole chunk including header fits into one kmalloc-4096 object*/
+#define SFS_ARENA_CHUNK_SIZE    4096
+#define SFS_ARENA_ALIGN         sizeof(void*)
+
+void sfs_arena_init(struct sfs_arena *arena)
+{
+    INIT_LIST_HEAD(&arena->chunks);
+    arena->allocated = 0;
+}
+
+static inline struct sfs_arena_chunk *current_chunk(struct sfs_arena *arena)
+{
+    if (list_empty(&arena->chunks)) return 0;
+    return list_entry(arena->chunks.prev, struct sfs_arena_chunk, chunks);
+}
+
+/*min_chunk is payload size of new chunk if current one is full*/
+static void *arena_alloc(struct sfs_arena *arena, size_t size, size_t min_chunk)
+{
+    struct sfs_arena_chunk *chunk;
+    size_t offset;
+    size_t chunk_size;
+
+    chunk = current_chunk(arena);
+    if (chunk)
+    {
+        offset = ALIGN(chunk->used, SFS_ARENA_ALIGN);
+        if (offset + size <= chunk->size)
+        {
+            chunk->used = offset + size;
+            return chunk->data + offset;
+        }
+    }
+
+    chunk_size = SFS_ARENA_CHUNK_SIZE - sizeof(struct sfs_arena_chunk);
+    if (chunk_size < min_chunk) chunk_size = min_chunk;
+    if (chunk_size < size) chunk_size = size;
+
+    chunk = kmalloc(sizeof(struct sfs_arena_chunk) + chunk_size, GFP_KERNEL);
+    if (!chunk) return 0;
+
+    chunk->size = chunk_size;
+    chunk->used = size;
+    list_add_tail(&chunk->chunks, &arena->chunks);
+    arena->allocated += chunk_size;
+
+    return chunk->data;
+}
+
+void *sfs_arena_alloc(struct sfs_arena *arena, size_t size)
+{
+    return arena_alloc(arena, size, 0);
+}
+
+/*
+ * Grows the last allocation of the current chunk in place. Otherwise data
+ * is moved to a new place (old space is wasted till arena is freed),
+ * so a new chunk gets twice as much room for further growth.
+ */
+void *sfs_arena_realloc(struct sfs_arena *arena, void *ptr,
+                        size_t old_size, size_t new_size)
+{
+    struct sfs_arena_chunk *chunk;
+    void *newptr;
+
+    if (!ptr) return arena_alloc(arena, new_size, 0);
+    if (new_size <= old_size) return ptr;
+
+    chunk = current_chunk(arena);
+    if (chunk &&
+        ((char*)ptr + old_size == chunk->data + chunk->used) &&
+        ((char*)ptr - chunk->data) + new_size <= chunk->size)
+    {
+        chunk->used += new_size - old_size;
+        return ptr;
+    }
+
+    newptr = arena_alloc(arena, new_size, new_size * 2);
+    if (!newptr) return 0;
+
+    memcpy(newptr, ptr, old_size);
+    return newptr;
+}
+
+void sfs_arena_free(struct sfs_arena *arena)
+{
+    struct sfs_arena_chunk *chunk;
+    struct sfs_arena_chunk *tmp;
+
+    list_for_each_entry_safe(chunk, tmp, &arena->chunks, chunks)
+    {
+        list_del(&chunk->chunks);
+        kfree(chunk);
+    }
+
+    arena->allocated = 0;
+}
+
+size_t sfs_arena_used(struct sfs_arena *arena)
+{
+    struct sfs_arena_chunk *chunk;
+    size_t used = 0;
+
+    list_for_each_entry(chunk, &arena->chunks, chunks)
+        used += chunk->used;
+
+    return used;
+}
@@ -0,0 +1,25 @@
+#ifndef _SURFFS_ARENA_H_
+#define _SURFFS_ARENA_H_
+
+#include <linux/kernel.h>
+#include <linux/list.h>
+
+/*
+ * Bump allocator for variable-size data owned by one web page
+ * (link strings, titles, log). Single allocations are never freed,
+ * the whole arena is released at once by sfs_arena_free().
+ */
+struct sfs_arena
+{
+    struct list_head chunks;
+    size_t allocated;
+};
+
+void sfs_arena_init(struct sfs_arena *arena);
+void *sfs_arena_alloc(struct sfs_arena *arena, size_t size);
+void *sfs_arena_realloc(struct sfs_arena *arena, void *ptr,
+                        size_t old_size, size_t new_size);
+void sfs_arena_free(struct sfs_arena *arena);
+size_t sfs_arena_used(struct sfs_arena *arena);
+
+#endif
@@ -0,0 +1,137 @@
+#include "surffs_async.h"
+#include "surffs_inode.h"
+#include "surffs_sb.h"
+#include "surffs_debug.h"
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/workqueue.h>
+
+static struct workqueue_struct *async_wq;
+
+struct surffs_async_fetch
+{
+    struct work_struct work;
+    struct inode *dir;          /*referenced until fetch ends*/
+};
+
+int surffs_async_init(void)
+{
+    async_wq = alloc_workqueue("surffs_async", WQ_UNBOUND, 0);
+    if (!async_wq) return -ENOMEM;
+
+    return 0;
+}
+
+void surffs_async_exit(void)
+{
+    if (async_wq) destroy_workqueue(async_wq);
+    async_wq = 0;
+}
+
+void surffs_async_flush(void)
+{
+    flush_workqueue(async_wq);
+}
+
+int surffs_async_wanted(struct file *file)
+{
+    return (file->f_flags & O_NONBLOCK) && SURFFS_SB(file->f_inode->i_sb)->nonblock;
+}
+
+/*page is fetched without i_mutex, so readdir and lookups of directory do not wait for it*/
+static void async_fetch_work(struct work_struct *work)
+{
+    struct surffs_async_fetch *af = container_of(work, struct surffs_async_fetch, work);
+    struct inode *dir = af->dir;
+    struct SURFFS_DIR_INODE_PRIVATE *prvt = SURFFS_DIR_INODE(dir);
+    struct SURFFS_WEB_PAGE *webpage;
+    int ret = 0;
+
+    ret = surffs_fetch_dir_webpage(dir, &webpage);
+    if (!ret)
+    {
+        mutex_lock(&dir->i_mutex);
+        ret = surffs_attach_dir_webpage(dir, webpage);
+        mutex_unlock(&dir->i_mutex);
+    }
+
+    if (ret) sfs_info("async fetch of %s failed, error code %d\n", prvt->webPath.data, ret);
+
+    spin_lock(&dir->i_lock);
+    prvt->fetch_state = ret ? SFS_DIR_FETCH_FAILED : SFS_DIR_FETCH_IDLE;
+    prvt->fetch_error = ret;
+    spin_unlock(&dir->i_lock);
+
+    wake_up_all(&prvt->fetch_wait);
+
+    iput(dir);
+    kfree(af);
+}
+
+int surffs_async_fetch_dir(struct inode *dir)
+{
+    int ret = -EAGAIN;
+    struct SURFFS_DIR_INODE_PRIVATE *prvt = SURFFS_DIR_INODE(dir);
+    struct surffs_async_fetch *af;
+
+    if (SURFFS_INODE(dir)->webpage) return 0;
+
+    af = kzalloc(sizeof(struct surffs_async_fetch), GFP_KERNEL);
+    if (!af) return -ENOMEM;
+
+    spin_lock(&dir->i_lock);
+    if (SURFFS_INODE(dir)->webpage)
+    {
+        ret = 0;
+    }
+    else if (prvt->fetch_state == SFS_DIR_FETCH_FAILED)
+    {
+        /*the next access tries again*/
+        ret = prvt->fetch_error;
+        prvt->fetch_state = SFS_DIR_FETCH_IDLE;
+    }
+    else if (prvt->fetch_state == SFS_DIR_FETCH_IDLE)
+    {
+        prvt->fetch_state = SFS_DIR_FETCH_RUNNING;
+        ihold(dir);
+        af->dir = dir;
+        INIT_WORK(&af->work, async_fetch_work);
+        queue_work(async_wq, &af->work);
+        af = 0;
+    }
+    spin_unlock(&dir->i_lock);
+
+    kfree(af);
+
+    return ret;
+}
+
+static int async_fetch_ended(struct inode *dir)
+{
+    return ACCESS_ONCE(SURFFS_DIR_INODE(dir)->fetch_state) != SFS_DIR_FETCH_RUNNING;
+}
+
+int surffs_async_wait(struct inode *dir)
+{
+    return wait_event_interruptible(SURFFS_DIR_INODE(dir)->fetch_wait, async_fetch_ended(dir));
+}
+
+unsigned int surffs_async_poll(struct inode *dir, struct file *file, poll_table *wait)
+{
+    struct SURFFS_DIR_INODE_PRIVATE *prvt = SURFFS_DIR_INODE(dir);
+    unsigned int mask = 0;
+
+    poll_wait(file, &prvt->fetch_wait, wait);
+
+    spin_lock(&dir->i_lock);
+    if (SURFFS_INODE(dir)->webpage)
+        mask = POLLIN | POLLRDNORM;
+    else if (prvt->fetch_state == SFS_DIR_FETCH_FAILED)
+        mask = POLLERR;
+    spin_unlock(&dir->i_lock);
+
+    /*polling alone keeps directory loading*/
+    if (!mask && prvt->fetch_state == SFS_DIR_FETCH_IDLE) surffs_async_fetch_dir(dir);
+
+    return mask;
+}
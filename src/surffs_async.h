@@ -0,0 +1,38 @@
+#ifndef _SURFFS_ASYNC_H_
+#define _SURFFS_ASYNC_H_
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/poll.h>
+
+/*
+ * Non-blocking loading of directories (mount option nonblock): open and
+ * readdir with O_NONBLOCK of a directory which page is not fetched yet
+ * queue the fetch to a workqueue and fail with -EAGAIN. Status file of
+ * such directory exists before the page; poll() on it reports POLLIN when
+ * the page is there and POLLERR when fetching failed, so one thread can
+ * keep many directories loading. Without the option O_NONBLOCK is ignored,
+ * as opendir() of libc always passes it.
+ */
+
+int  surffs_async_init(void);
+void surffs_async_exit(void);
+
+/*waits for fetches running for mount being unmounted*/
+void surffs_async_flush(void);
+
+/*O_NONBLOCK access on mount with option nonblock*/
+int  surffs_async_wanted(struct file *file);
+
+/*
+ * 0 if page of directory is there, -EAGAIN while it is being fetched
+ * (fetch is started if it is not), error of failed fetch once
+ */
+int  surffs_async_fetch_dir(struct inode *dir);
+
+/*waits until fetch of directory ends, -ERESTARTSYS on signal*/
+int  surffs_async_wait(struct inode *dir);
+
+unsigned int surffs_async_poll(struct inode *dir, struct file *file, poll_table *wait);
+
+#endif
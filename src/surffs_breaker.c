@@ -0,0 +1,92 @@
+#include "surffs_breaker.h"
+#include "surffs_debug.h"
+#include <linux/jiffies.h>
+#include <linux/errno.h>
+
+void surffs_breaker_init(struct surffs_breaker *breaker)
+{
+    breaker->threshold = SURFFS_BREAKER_FAILS;
+    breaker->probe_ms = SURFFS_BREAKER_PROBE_MS;
+    spin_lock_init(&breaker->lock);
+    breaker->state = SFS_BREAKER_CLOSED;
+    breaker->fails = 0;
+    breaker->next_probe = 0;
+}
+
+int surffs_breaker_get(struct surffs_breaker *breaker, int *probe)
+{
+    int ret = 0;
+
+    *probe = 0;
+    if (!breaker->threshold) return 0;
+
+    spin_lock(&breaker->lock);
+
+    if (breaker->state == SFS_BREAKER_PROBING)
+    {
+        ret = -EHOSTDOWN;
+    }
+    else if (breaker->state == SFS_BREAKER_OPEN)
+    {
+        if (time_before(jiffies, breaker->next_probe))
+        {
+            ret = -EHOSTDOWN;
+        }
+        else
+        {
+            breaker->state = SFS_BREAKER_PROBING;
+            *probe = 1;
+        }
+    }
+
+    spin_unlock(&breaker->lock);
+
+    return ret;
+}
+
+void surffs_breaker_put(struct surffs_breaker *breaker, int probe,
+                        enum SURFFS_BREAKER_RESULT result)
+{
+    if (!breaker->threshold) return;
+
+    spin_lock(&breaker->lock);
+
+    if (result == SFS_BREAKER_OK)
+    {
+        if (breaker->state != SFS_BREAKER_CLOSED)
+            sfs_info("circuit breaker closed\n");
+        breaker->state = SFS_BREAKER_CLOSED;
+        breaker->fails = 0;
+    }
+    else if (result == SFS_BREAKER_FAILED)
+    {
+        breaker->fails++;
+        if (probe || (breaker->state == SFS_BREAKER_CLOSED &&
+                      breaker->fails >= breaker->threshold))
+        {
+            if (breaker->state == SFS_BREAKER_CLOSED)
+                sfs_warning("circuit breaker opened after %u failed fetches\n", breaker->fails);
+            breaker->state = SFS_BREAKER_OPEN;
+            breaker->next_probe = jiffies + msecs_to_jiffies(breaker->probe_ms);
+        }
+    }
+    else if (probe)
+    {
+        /*probe was interrupted, the next fetch probes again*/
+        breaker->state = SFS_BREAKER_OPEN;
+    }
+
+    spin_unlock(&breaker->lock);
+}
+
+const char *surffs_breaker_state_name(enum SURFFS_BREAKER_STATE state)
+{
+    switch (state)
+    {
+        case SFS_BREAKER_CLOSED:    return "closed";
+        case SFS_BREAKER_OPEN:      return "open";
+        case SFS_BREAKER_PROBING:   return "probing";
+    }
+
+    return "unknown";
+}
@@ -0,0 +1,57 @@
+#ifndef _SURFFS_BREAKER_H_
+#define _SURFFS_BREAKER_H_
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/spinlock.h>
+
+/*
+ * Circuit breaker of mount: after "threshold" fetches in a row could not
+ * reach any origin, it opens and new fetches fail at once with -EHOSTDOWN
+ * instead of waiting for their own timeouts. Every probe_ms one fetch is let
+ * through as a probe: its success closes the breaker, its failure keeps it
+ * open for another probe_ms. Cached pages are not fetched, so they are
+ * served as usual while breaker is open.
+ */
+#define SURFFS_BREAKER_FAILS        5
+#define SURFFS_BREAKER_PROBE_MS     5000
+
+enum SURFFS_BREAKER_STATE
+{
+    SFS_BREAKER_CLOSED = 0,
+    SFS_BREAKER_OPEN,
+    SFS_BREAKER_PROBING
+};
+
+/*result of fetch let through by breaker*/
+enum SURFFS_BREAKER_RESULT
+{
+    SFS_BREAKER_OK = 0,
+    SFS_BREAKER_FAILED,
+    SFS_BREAKER_NEUTRAL     /*interrupted fetch says nothing about server*/
+};
+
+struct surffs_breaker
+{
+    unsigned int threshold;     /*0 - breaker is disabled*/
+    unsigned int probe_ms;
+
+    spinlock_t lock;
+    enum SURFFS_BREAKER_STATE state;
+    u32 fails;
+    unsigned long next_probe;
+};
+
+void surffs_breaker_init(struct surffs_breaker *breaker);
+
+/*
+ * 0 if fetch may go on, then its result must be given to
+ * surffs_breaker_put(), -EHOSTDOWN if breaker is open
+ */
+int  surffs_breaker_get(struct surffs_breaker *breaker, int *probe);
+void surffs_breaker_put(struct surffs_breaker *breaker, int probe,
+                        enum SURFFS_BREAKER_RESULT result);
+
+const char *surffs_breaker_state_name(enum SURFFS_BREAKER_STATE state);
+
+#endif
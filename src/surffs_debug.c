@@ -1,75 +1,42 @@
 #include "surffs_debug.h"
-#include "surffs_internet.h"
-#include "surffs_helpers.h"
-#include "surffs_socket.h"
-#include <linux/hashtable.h>
-#include <linux/slab.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
 
-enum SFS_LOG_MODE
-{
-    LOG_NORMAL = 0,
-    LOG_ENTER
-};
-
-int sfs_log_nesting = 0;
-enum SFS_LOG_MODE sfs_log_mode = LOG_NORMAL;
-
-inline void sfs_enter(void)
-{
-    sfs_log_mode = LOG_ENTER;
-    sfs_log_nesting++;
-}
+/*tracepoints are instantiated once, here*/
+#define CREATE_TRACE_POINTS
+#include "surffs_trace.h"
 
-inline void sfs_leave(void)
-{
-    sfs_log_mode = LOG_NORMAL;
-    if (sfs_log_nesting) sfs_log_nesting--;
-}
+int sfs_loglevel = SURFFS_DEFAULT_LOGLEVEL;
+struct static_key sfs_info_enabled = STATIC_KEY_INIT_FALSE;
 
-char sfs_log_paddings[256];
-int logpd_init = 0;
-
-inline void log_paddings_init(void)
-{
-    memset(sfs_log_paddings, ' ', sizeof(sfs_log_paddings) - 1);
-    sfs_log_paddings[sizeof(sfs_log_paddings) - 1] = 0;
-}
+static DEFINE_MUTEX(sfs_loglevel_lock);
+static int sfs_info_key_on = 0;
 
-char *get_sfs_log_padding(void)
+static int sfs_loglevel_set(const char *val, const struct kernel_param *kp)
 {
-    char *res;
-    int shift;
-    #define one_shift_size 4
-
-    if (!logpd_init)
-    {
-        log_paddings_init();
-        logpd_init = 1;
-    }
+    int ret = 0;
+    int on;
 
-    shift = sfs_log_nesting * one_shift_size;
-    if (shift > sizeof(sfs_log_paddings) - 1) return "";
+    mutex_lock(&sfs_loglevel_lock);
 
-    res = sfs_log_paddings + sizeof(sfs_log_paddings) - 1 - shift;
+    ret = param_set_int(val, kp);
+    if (ret) goto out;
 
-    return res;
-}
-
-char *get_sfs_log_start(void)
-{
-    switch (sfs_log_mode)
-    {
-        case LOG_NORMAL: return "|";
-        case LOG_ENTER: return ">";
-        default: return "";
-    }
-}
+    on = (sfs_loglevel >= SURFFS_LOGLEVEL_INFO);
+    if (on && !sfs_info_key_on) static_key_slow_inc(&sfs_info_enabled);
+    if (!on && sfs_info_key_on) static_key_slow_dec(&sfs_info_enabled);
+    sfs_info_key_on = on;
 
-inline void sfs_after_log(void)
-{
-    sfs_log_mode = LOG_NORMAL;
+out:
+    mutex_unlock(&sfs_loglevel_lock);
+    return ret;
 }
 
+static const struct kernel_param_ops sfs_loglevel_ops = {
+    .set = sfs_loglevel_set,
+    .get = param_get_int,
+};
 
-
-
+module_param_cb(loglevel, &sfs_loglevel_ops, &sfs_loglevel, 0644);
+MODULE_PARM_DESC(loglevel, "0 - quiet, 1 - errors, 2 - warnings, 3 - info");
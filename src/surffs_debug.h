@@ -3,34 +3,34 @@
 
 #include <linux/kernel.h>
 #include <linux/printk.h>
-
-extern int sfs_log_nesting;
+#include <linux/jump_label.h>
 
 #define SURFFS_LOGLEVEL_QUIET       0
 #define SURFFS_LOGLEVEL_ERROR       1
 #define SURFFS_LOGLEVEL_WARNING     2
 #define SURFFS_LOGLEVEL_INFO        3
-#define SURFFS_LOGLEVEL_DEBUG       4
-#define SURFFS_LOGLEVEL_TRACE       5
-#define SURFFS_CURRENT_LOGLEVEL     SURFFS_LOGLEVEL_ERROR
-
-#define sfs_print_log(level, tag, fmt, ...) { \
-            if (SURFFS_CURRENT_LOGLEVEL >= level) { \
-                pr_info("[surffs "tag"]: %s%s"fmt, \
-                    get_sfs_log_padding(), get_sfs_log_start(), ##__VA_ARGS__); \
-            } sfs_after_log();}
-
+#define SURFFS_DEFAULT_LOGLEVEL     SURFFS_LOGLEVEL_ERROR
+
+/*
+ * Log level can be changed at runtime:
+ *   echo 3 > /sys/module/surffs/parameters/loglevel
+ * Info messages are printed from hot paths (lookup, readdir), so they are
+ * additionally guarded by static key which is enabled only when level >= INFO.
+ * Detailed tracing is done by tracepoints, see surffs_trace.h
+ */
+extern int sfs_loglevel;
+extern struct static_key sfs_info_enabled;
+
+#define sfs_print_log(level, tag, fmt, ...) do { \
+            if (sfs_loglevel >= level) \
+                pr_info("[surffs "tag"]: "fmt, ##__VA_ARGS__); \
+        } while (0)
 
 #define sfs_error(fmt, ...)     sfs_print_log(SURFFS_LOGLEVEL_ERROR,   "ERR", fmt, ##__VA_ARGS__)
 #define sfs_warning(fmt, ...)   sfs_print_log(SURFFS_LOGLEVEL_WARNING, "WRN", fmt, ##__VA_ARGS__)
-#define sfs_info(fmt, ...)      sfs_print_log(SURFFS_LOGLEVEL_INFO,    "inf", fmt, ##__VA_ARGS__)
-#define sfs_debug(fmt, ...)     sfs_print_log(SURFFS_LOGLEVEL_DEBUG,   "dbg", fmt, ##__VA_ARGS__)
-#define sfs_trace(fmt, ...)     sfs_print_log(SURFFS_LOGLEVEL_TRACE,   "trc", fmt, ##__VA_ARGS__)
-
-char *get_sfs_log_padding(void);
-char *get_sfs_log_start(void);
-inline void sfs_after_log(void);
-inline void sfs_enter(void);
-inline void sfs_leave(void);
+#define sfs_info(fmt, ...)      do { \
+            if (static_key_false(&sfs_info_enabled)) \
+                sfs_print_log(SURFFS_LOGLEVEL_INFO, "inf", fmt, ##__VA_ARGS__); \
+        } while (0)
 
 #endif
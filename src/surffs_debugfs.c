@@ -0,0 +1,430 @@
+#include "surffs_debugfs.h"
+#include "surffs_debug.h"
+#include "surffs_webpages.h"
+#include "surffs_mem.h"
+#include "surffs_sb.h"
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/jiffies.h>
+#include <linux/kdev_t.h>
+#include <linux/err.h>
+
+static struct dentry *surffs_debugfs_root;
+
+static size_t link_table_bytes(struct SURFFS_WEB_PAGE *page)
+{
+    struct SURFFS_HTML_LINK *link;
+    size_t bytes = 0;
+
+    list_for_each_entry(link, &page->html_links, html_links)
+    {
+        bytes += sizeof(struct SURFFS_HTML_LINK);
+        bytes += link->title.memlen + link->protocol.memlen + link->host.memlen
+                 + link->path.memlen + link->full_url.memlen;
+    }
+
+    return bytes;
+}
+
+static size_t header_bytes(struct SURFFS_WEB_PAGE *page)
+{
+    if (!page->http_payload) return page->http_resp.textlen;
+    return page->http_payload - page->http_resp.data;
+}
+
+static size_t log_bytes(struct SURFFS_WEB_PAGE *page)
+{
+    return page->events.capacity * sizeof(struct sfs_log_record);
+}
+
+/*pages*/
+
+static void *pages_seq_start(struct seq_file *m, loff_t *pos)
+{
+    mutex_lock(&webpages_lock);
+    return seq_list_start_head(&webpages_list, *pos);
+}
+
+static void *pages_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+    return seq_list_next(v, &webpages_list, pos);
+}
+
+static void pages_seq_stop(struct seq_file *m, void *v)
+{
+    mutex_unlock(&webpages_lock);
+}
+
+static int pages_seq_show(struct seq_file *m, void *v)
+{
+    struct SURFFS_WEB_PAGE *page;
+
+    if (v == &webpages_list)
+    {
+        seq_puts(m, "status body_bytes header_bytes links link_table_bytes "
+                    "log_bytes arena_bytes refcount last_access_sec_ago url\n");
+        return 0;
+    }
+
+    page = list_entry(v, struct SURFFS_WEB_PAGE, webpages);
+
+    seq_printf(m, "%s %zu %zu %u %zu %zu %zu %d %u %s\n",
+               page->status_str.data,
+               page->http_resp.textlen - header_bytes(page),
+               header_bytes(page),
+               page->links_count,
+               link_table_bytes(page),
+               log_bytes(page),
+               page->arena.allocated,
+               atomic_read(&page->refcount),
+               jiffies_to_msecs(jiffies - page->last_access) / 1000,
+               page->full_url.data);
+
+    return 0;
+}
+
+static const struct seq_operations pages_seq_ops = {
+    .start  = pages_seq_start,
+    .next   = pages_seq_next,
+    .stop   = pages_seq_stop,
+    .show   = pages_seq_show,
+};
+
+static int pages_open(struct inode *inode, struct file *file)
+{
+    return seq_open(file, &pages_seq_ops);
+}
+
+static const struct file_operations pages_fops = {
+    .owner      = THIS_MODULE,
+    .open       = pages_open,
+    .read       = seq_read,
+    .llseek     = seq_lseek,
+    .release    = seq_release,
+};
+
+/*memory*/
+
+static int memory_show(struct seq_file *m, void *v)
+{
+    struct SURFFS_WEB_PAGE *page;
+    enum SURFFS_CACHE cache;
+    u64 resp_bytes = 0;
+    u64 arena_bytes = 0;
+    u64 arena_used = 0;
+    u64 link_strings = 0;
+    u64 log = 0;
+    u64 pages = 0;
+    long objects;
+
+    seq_printf(m, "%-20s %10s %10s %12s\n", "type", "objects", "objsize", "bytes");
+
+    for (cache = 0; cache < SFS_CACHES_NUM; cache++)
+    {
+        objects = surffs_cache_objects(cache);
+        seq_printf(m, "%-20s %10ld %10zu %12llu\n",
+                   surffs_cache_name(cache), objects, surffs_cache_objsize(cache),
+                   (u64)objects * surffs_cache_objsize(cache));
+    }
+
+    mutex_lock(&webpages_lock);
+    list_for_each_entry(page, &webpages_list, webpages)
+    {
+        pages++;
+        resp_bytes += page->http_resp.memlen;
+        arena_bytes += page->arena.allocated;
+        arena_used += sfs_arena_used(&page->arena);
+        link_strings += link_table_bytes(page)
+                        - page->links_count * sizeof(struct SURFFS_HTML_LINK);
+        log += log_bytes(page);
+    }
+    mutex_unlock(&webpages_lock);
+
+    seq_printf(m, "%-20s %10llu %10s %12llu\n", "http_responses", pages, "-", resp_bytes);
+    seq_printf(m, "%-20s %10llu %10s %12llu\n", "page_arenas", pages, "-", arena_bytes);
+    seq_printf(m, "%-20s %10s %10s %12llu\n", "  link_strings", "-", "-", link_strings);
+    seq_printf(m, "%-20s %10s %10s %12llu\n", "  event_logs", "-", "-", log);
+    seq_printf(m, "%-20s %10s %10s %12llu\n", "  page_strings", "-", "-",
+               arena_used - link_strings - log);
+    seq_printf(m, "%-20s %10s %10s %12llu\n", "  unused", "-", "-",
+               arena_bytes - arena_used);
+
+    return 0;
+}
+
+static int memory_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, memory_show, inode->i_private);
+}
+
+static const struct file_operations memory_fops = {
+    .owner      = THIS_MODULE,
+    .open       = memory_open,
+    .read       = seq_read,
+    .llseek     = seq_lseek,
+    .release    = single_release,
+};
+
+/*discovred_paths of mount*/
+
+static int discovred_paths_show(struct seq_file *m, void *v)
+{
+    struct super_block *sb = m->private;
+    struct surffs_sb_info *fsi = SURFFS_SB(sb);
+    struct string_hash_node *node;
+    unsigned long entries = 0;
+    unsigned long used_buckets = 0;
+    unsigned long chain;
+    unsigned long max_chain = 0;
+    unsigned long bytes = 0;
+    int bkt;
+
+    spin_lock(&fsi->discovred_lock);
+    for (bkt = 0; bkt < HASH_SIZE(fsi->discovred_paths); bkt++)
+    {
+        chain = 0;
+        hlist_for_each_entry(node, &fsi->discovred_paths[bkt], hashlist)
+        {
+            chain++;
+            bytes += surffs_cache_objsize(SFS_CACHE_HASH_NODE)
+                     + node->key.memlen + node->value.memlen;
+        }
+
+        entries += chain;
+        if (chain) used_buckets++;
+        if (chain > max_chain) max_chain = chain;
+    }
+    spin_unlock(&fsi->discovred_lock);
+
+    seq_printf(m, "entries %lu\n", entries);
+    seq_printf(m, "buckets %lu\n", (unsigned long)HASH_SIZE(fsi->discovred_paths));
+    seq_printf(m, "used_buckets %lu\n", used_buckets);
+    seq_printf(m, "max_chain %lu\n", max_chain);
+    seq_printf(m, "bytes %lu\n", bytes);
+
+    return 0;
+}
+
+static int discovred_paths_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, discovred_paths_show, inode->i_private);
+}
+
+static const struct file_operations discovred_paths_fops = {
+    .owner      = THIS_MODULE,
+    .open       = discovred_paths_open,
+    .read       = seq_read,
+    .llseek     = seq_lseek,
+    .release    = single_release,
+};
+
+/*timeouts of mount*/
+
+static int timeouts_show(struct seq_file *m, void *v)
+{
+    struct super_block *sb = m->private;
+    struct surffs_timeouts *touts = &SURFFS_SB(sb)->timeouts;
+    struct surffs_rtt_estimator rtt;
+    enum SURFFS_TIMEOUT_PHASE phase;
+
+    seq_printf(m, "adaptive %d\n", touts->adaptive);
+    seq_printf(m, "%-12s %10s %10s %10s %10s %8s\n",
+               "phase", "config_ms", "current_ms", "srtt_us", "rttvar_us", "samples");
+
+    for (phase = 0; phase < SFS_TOUT_PHASES_NUM; phase++)
+    {
+        spin_lock(&touts->lock);
+        rtt = touts->rtt[phase];
+        spin_unlock(&touts->lock);
+
+        seq_printf(m, "%-12s %10u %10u %10u %10u %8u\n",
+                   surffs_timeout_phase_name(phase), touts->ms[phase],
+                   surffs_timeout_ms(touts, phase),
+                   rtt.srtt_us, rtt.rttvar_us, rtt.samples);
+    }
+
+    return 0;
+}
+
+static int timeouts_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, timeouts_show, inode->i_private);
+}
+
+static const struct file_operations timeouts_fops = {
+    .owner      = THIS_MODULE,
+    .open       = timeouts_open,
+    .read       = seq_read,
+    .llseek     = seq_lseek,
+    .release    = single_release,
+};
+
+/*origins of mount*/
+
+static void origins_table_show(struct seq_file *m, struct surffs_origins *origins)
+{
+    struct surffs_origin *o;
+    int i;
+
+    seq_printf(m, "%-16s %5s %8s %10s %10s %6s\n",
+               "ip", "state", "inflight", "fetches", "failures", "fails");
+
+    spin_lock(&origins->lock);
+    for (i = 0; i < origins->count; i++)
+    {
+        o = &origins->origin[i];
+        seq_printf(m, "%-16s %5s %8d %10llu %10llu %6u\n",
+                   o->ip, surffs_origin_is_down(o) ? "down" : "up",
+                   atomic_read(&o->inflight), o->fetches, o->failures, o->fails);
+    }
+    spin_unlock(&origins->lock);
+}
+
+static int origins_show(struct seq_file *m, void *v)
+{
+    struct super_block *sb = m->private;
+    struct surffs_origins *origins = &SURFFS_SB(sb)->origins;
+    struct surffs_breaker *breaker = &SURFFS_SB(sb)->breaker;
+
+    spin_lock(&breaker->lock);
+    seq_printf(m, "breaker %s, %u failed fetches in a row, threshold %u, probe %ums\n",
+               surffs_breaker_state_name(breaker->state), breaker->fails,
+               breaker->threshold, breaker->probe_ms);
+    spin_unlock(&breaker->lock);
+
+    seq_printf(m, "policy %s\n", origins->policy == SFS_LB_LO ? "lo" : "rr");
+    origins_table_show(m, origins);
+
+    return 0;
+}
+
+static int origins_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, origins_show, inode->i_private);
+}
+
+static const struct file_operations origins_fops = {
+    .owner      = THIS_MODULE,
+    .open       = origins_open,
+    .read       = seq_read,
+    .llseek     = seq_lseek,
+    .release    = single_release,
+};
+
+/*other hosts of multi-host mode*/
+
+static int hosts_show(struct seq_file *m, void *v)
+{
+    struct super_block *sb = m->private;
+    struct surffs_hosts *hosts = &SURFFS_SB(sb)->hosts;
+    struct surffs_host *host;
+
+    seq_printf(m, "hosts %u\n", hosts->count);
+
+    list_for_each_entry(host, &hosts->list, hosts)
+    {
+        seq_printf(m, "\nhost %s\n", host->name.data);
+        origins_table_show(m, &host->origins);
+    }
+
+    return 0;
+}
+
+static int hosts_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, hosts_show, inode->i_private);
+}
+
+static const struct file_operations hosts_fops = {
+    .owner      = THIS_MODULE,
+    .open       = hosts_open,
+    .read       = seq_read,
+    .llseek     = seq_lseek,
+    .release    = single_release,
+};
+
+/*sitemap of mount*/
+
+static int sitemap_show(struct seq_file *m, void *v)
+{
+    struct super_block *sb = m->private;
+    struct surffs_sitemap *sitemap = &SURFFS_SB(sb)->sitemap;
+    struct surffs_sitemap_entry *entry;
+    int bkt;
+
+    seq_printf(m, "files %u\n", sitemap->files);
+    seq_printf(m, "urls %u\n", sitemap->count);
+    seq_printf(m, "%-12s %s\n", "lastmod", "path");
+
+    hash_for_each(sitemap->table, bkt, entry, hashlist)
+        seq_printf(m, "%-12lu %s\n", entry->lastmod, entry->path);
+
+    return 0;
+}
+
+static int sitemap_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, sitemap_show, inode->i_private);
+}
+
+static const struct file_operations sitemap_fops = {
+    .owner      = THIS_MODULE,
+    .open       = sitemap_open,
+    .read       = seq_read,
+    .llseek     = seq_lseek,
+    .release    = single_release,
+};
+
+static int debugfs_ok(struct dentry *d)
+{
+    return d && !IS_ERR(d);
+}
+
+void surffs_debugfs_init(void)
+{
+    surffs_debugfs_root = debugfs_create_dir("surffs", NULL);
+    if (!debugfs_ok(surffs_debugfs_root))
+    {
+        sfs_warning("debugfs is not available\n");
+        surffs_debugfs_root = 0;
+        return;
+    }
+
+    debugfs_create_file("pages", S_IRUSR, surffs_debugfs_root, NULL, &pages_fops);
+    debugfs_create_file("memory", S_IRUSR, surffs_debugfs_root, NULL, &memory_fops);
+}
+
+void surffs_debugfs_exit(void)
+{
+    if (surffs_debugfs_root) debugfs_remove_recursive(surffs_debugfs_root);
+    surffs_debugfs_root = 0;
+}
+
+void surffs_debugfs_add_sb(struct super_block *sb)
+{
+    struct surffs_sb_info *fsi = SURFFS_SB(sb);
+    char name[32];
+
+    if (!surffs_debugfs_root) return;
+
+    snprintf(name, sizeof(name), "%u:%u", MAJOR(sb->s_dev), MINOR(sb->s_dev));
+    fsi->debugfs_dir = debugfs_create_dir(name, surffs_debugfs_root);
+    if (!debugfs_ok(fsi->debugfs_dir))
+    {
+        fsi->debugfs_dir = 0;
+        return;
+    }
+
+    debugfs_create_file("discovred_paths", S_IRUSR, fsi->debugfs_dir, sb,
+                        &discovred_paths_fops);
+    debugfs_create_file("timeouts", S_IRUSR, fsi->debugfs_dir, sb, &timeouts_fops);
+    debugfs_create_file("origins", S_IRUSR, fsi->debugfs_dir, sb, &origins_fops);
+    debugfs_create_file("sitemap", S_IRUSR, fsi->debugfs_dir, sb, &sitemap_fops);
+    debugfs_create_file("hosts", S_IRUSR, fsi->debugfs_dir, sb, &hosts_fops);
+}
+
+void surffs_debugfs_remove_sb(struct surffs_sb_info *fsi)
+{
+    if (fsi->debugfs_dir) debugfs_remove_recursive(fsi->debugfs_dir);
+    fsi->debugfs_dir = 0;
+}
@@ -0,0 +1,25 @@
+#ifndef _SURFFS_DEBUGFS_H_
+#define _SURFFS_DEBUGFS_H_
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+
+/*
+ * /sys/kernel/debug/surffs/
+ *     pages               - every cached web page and its memory footprint
+ *     memory              - memory used by surffs grouped by structure type
+ *     <major:minor>/
+ *         discovred_paths - occupancy of discovred_paths hash of mount
+ *         timeouts        - fetch timeouts and RTT estimates of mount
+ *         origins         - state and load of every ip of mount
+ * debugfs is optional, so errors of creating files are not fatal
+ */
+void surffs_debugfs_init(void);
+void surffs_debugfs_exit(void);
+
+struct surffs_sb_info;
+
+void surffs_debugfs_add_sb(struct super_block *sb);
+void surffs_debugfs_remove_sb(struct surffs_sb_info *fsi);
+
+#endif
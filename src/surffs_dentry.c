@@ -3,17 +3,11 @@
 
 int surffs_dentry_delete(const struct dentry *dentry)
 {
-    sfs_enter();
-    sfs_debug("surffs_dentry_delete: '%s'\n", dentry->d_name.name);
-    sfs_leave();
     return 0;
 }
 
 void surffs_dentry_release(struct dentry *dentry)
 {
-    sfs_enter();
-    sfs_debug("surffs_dentry_release: '%s'\n", dentry->d_name.name);
-    sfs_leave();
 }
 
 static int reverse_path(sfs_string *path, sfs_string *reversed)
@@ -60,9 +54,6 @@ int get_relative_dentry_path(struct dentry *dentry, sfs_string *path)
     struct super_block *sb = dentry->d_sb;
     sfs_string tmp = {0};
 
-    sfs_enter();
-    sfs_trace("get_relative_dentry_path\n");
-
     ret = sfs_string_clear(path);
     if (ret) goto out;
 
@@ -83,7 +74,7 @@ int get_relative_dentry_path(struct dentry *dentry, sfs_string *path)
 
 out:
     sfs_string_free(&tmp);
-    sfs_leave();
+
     return ret;
 }
 
@@ -0,0 +1,325 @@
+#include "surffs_diskcache.h"
+#include "surffs_debug.h"
+#include "surffs_links.h"
+#include <linux/fs.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/crc32.h>
+#include <linux/jhash.h>
+#include <linux/time.h>
+#include <asm/byteorder.h>
+
+int surffs_diskcache_init(struct surffs_diskcache *dc, const char *dir)
+{
+    return surffs_local_dir_init(&dc->dir, dir, "cache_dir");
+}
+
+void surffs_diskcache_free(struct surffs_diskcache *dc)
+{
+    surffs_local_dir_free(&dc->dir);
+}
+
+static int disk_key(struct SURFFS_WEB_ADDRESS *address, sfs_string *key)
+{
+    int ret = 0;
+
+    ret = sfs_string_clear(key);
+    if (ret) return ret;
+
+    return sfs_string_catf(key, "%s:%u%s", address->host.data, address->port,
+                           address->path.data);
+}
+
+static int disk_file_name(sfs_string *key, sfs_string *name)
+{
+    int ret = 0;
+
+    ret = sfs_string_clear(name);
+    if (ret) return ret;
+
+    return sfs_string_catf(name, "%08x%08x",
+                           jhash(key->data, key->textlen, 0),
+                           jhash(key->data, key->textlen, 1));
+}
+
+/*appends len bytes from file to str*/
+static int disk_read(struct file *file, loff_t *pos, u32 len, sfs_string *str, u32 *crc)
+{
+    int ret = 0;
+    int n;
+
+    ret = sfs_string_reserve(str, len);
+    if (ret) return ret;
+
+    n = kernel_read(file, *pos, str->data + str->textlen, len);
+    if (n < 0) return n;
+    if (n != len) return -ENOENT;
+
+    *crc = crc32_le(*crc, str->data + str->textlen, len);
+    *pos += len;
+    str->textlen += len;
+    str->data[str->textlen] = 0;
+
+    return 0;
+}
+
+static int disk_write(struct file *file, loff_t *pos, const void *data, u32 len)
+{
+    ssize_t n;
+
+    n = kernel_write(file, data, len, *pos);
+    if (n < 0) return n;
+    if (n != len) return -EIO;
+
+    *pos += len;
+
+    return 0;
+}
+
+static int check_header(struct surffs_disk_header *hdr)
+{
+    if (le32_to_cpu(hdr->magic) != SURFFS_DISK_MAGIC) return 0;
+    if (le32_to_cpu(hdr->version) != SURFFS_DISK_VERSION) return 0;
+
+    if (le32_to_cpu(hdr->key_len) > SURFFS_DISK_MAX_SECTION) return 0;
+    if (le32_to_cpu(hdr->etag_len) > SURFFS_DISK_MAX_SECTION) return 0;
+    if (le32_to_cpu(hdr->last_modified_len) > SURFFS_DISK_MAX_SECTION) return 0;
+    if (le32_to_cpu(hdr->resp_len) > SURFFS_DISK_MAX_SECTION) return 0;
+    if (le32_to_cpu(hdr->links_len) > SURFFS_DISK_MAX_SECTION) return 0;
+
+    return le32_to_cpu(hdr->payload_offset) < le32_to_cpu(hdr->resp_len);
+}
+
+int surffs_disk_page_read(struct surffs_diskcache *dc, struct SURFFS_WEB_ADDRESS *address,
+                          struct surffs_disk_page *dp)
+{
+    int ret = 0;
+    sfs_string key = {0};
+    sfs_string name = {0};
+    sfs_string stored_key = {0};
+    struct surffs_disk_header hdr;
+    struct file *file = 0;
+    loff_t pos = 0;
+    u32 crc = ~0;
+    int n;
+
+    memset(dp, 0, sizeof(*dp));
+
+    ret = sfs_string_createz(&key, 128); if (ret) goto out;
+    ret = sfs_string_createz(&name, 128); if (ret) goto out;
+    ret = sfs_string_createz(&stored_key, 128); if (ret) goto out;
+    ret = sfs_string_createz(&dp->validators.etag, 64); if (ret) goto out;
+    ret = sfs_string_createz(&dp->validators.last_modified, 64); if (ret) goto out;
+    ret = sfs_string_createz(&dp->resp, 4096); if (ret) goto out;
+    ret = sfs_string_createz(&dp->links, 1024); if (ret) goto out;
+
+    ret = disk_key(address, &key); if (ret) goto out;
+    ret = disk_file_name(&key, &name); if (ret) goto out;
+
+    file = surffs_local_open(&dc->dir, name.data, O_RDONLY, 0);
+    if (IS_ERR(file)) {file = 0; ret = -ENOENT; goto out;}
+
+    n = kernel_read(file, pos, (char *)&hdr, sizeof(hdr));
+    if (n < 0) {ret = n; goto out;}
+    if (n != sizeof(hdr) || !check_header(&hdr)) {ret = -ENOENT; goto out;}
+    pos += sizeof(hdr);
+
+    /*another page with the same hash*/
+    ret = disk_read(file, &pos, le32_to_cpu(hdr.key_len), &stored_key, &crc);
+    if (ret) goto out;
+    if (strcmp(stored_key.data, key.data) != 0) {ret = -ENOENT; goto out;}
+
+    ret = disk_read(file, &pos, le32_to_cpu(hdr.etag_len), &dp->validators.etag, &crc);
+    if (ret) goto out;
+    ret = disk_read(file, &pos, le32_to_cpu(hdr.last_modified_len),
+                    &dp->validators.last_modified, &crc);
+    if (ret) goto out;
+    ret = disk_read(file, &pos, le32_to_cpu(hdr.resp_len), &dp->resp, &crc);
+    if (ret) goto out;
+    ret = disk_read(file, &pos, le32_to_cpu(hdr.links_len), &dp->links, &crc);
+    if (ret) goto out;
+
+    if (crc != le32_to_cpu(hdr.crc))
+    {
+        sfs_warning("disk cache file %s is corrupted\n", name.data);
+        ret = -ENOENT;
+        goto out;
+    }
+
+    dp->payload_offset = le32_to_cpu(hdr.payload_offset);
+    dp->links_count = le32_to_cpu(hdr.links_count);
+    dp->stored = le64_to_cpu(hdr.stored);
+
+out:
+    if (file) filp_close(file, NULL);
+    if (ret) surffs_disk_page_free(dp);
+    sfs_string_free(&key);
+    sfs_string_free(&name);
+    sfs_string_free(&stored_key);
+
+    return ret;
+}
+
+void surffs_disk_page_free(struct surffs_disk_page *dp)
+{
+    sfs_string_free(&dp->validators.etag);
+    sfs_string_free(&dp->validators.last_modified);
+    sfs_string_free(&dp->resp);
+    sfs_string_free(&dp->links);
+}
+
+/*next NUL-terminated string of link table, NULL at end of table*/
+static char *links_next_str(char **p, char *end)
+{
+    char *str = *p;
+    char *nul;
+
+    if (str >= end) return 0;
+    nul = memchr(str, 0, end - str);
+    if (!nul) return 0;
+
+    *p = nul + 1;
+
+    return str;
+}
+
+int surffs_disk_page_install(struct surffs_disk_page *dp, struct SURFFS_WEB_PAGE *page)
+{
+    int ret = 0;
+    char *p = dp->links.data;
+    char *end = dp->links.data + dp->links.textlen;
+    struct SURFFS_HTML_LINK src;
+    struct SURFFS_HTML_LINK *link;
+    sfs_string tmp;
+    __le32 number;
+    char *title, *protocol, *host, *path, *full_url;
+    u32 i;
+
+    for (i = 0; i < dp->links_count; i++)
+    {
+        if (end - p < sizeof(number)) {ret = -EINVAL; goto out;}
+        memcpy(&number, p, sizeof(number));
+        p += sizeof(number);
+
+        title = links_next_str(&p, end);
+        protocol = links_next_str(&p, end);
+        host = links_next_str(&p, end);
+        path = links_next_str(&p, end);
+        full_url = links_next_str(&p, end);
+        if (!full_url) {ret = -EINVAL; goto out;}
+
+        sfs_string_bind(&src.title, title);
+        sfs_string_bind(&src.protocol, protocol);
+        sfs_string_bind(&src.host, host);
+        sfs_string_bind(&src.path, path);
+        sfs_string_bind(&src.full_url, full_url);
+
+        ret = SURFFS_HTML_LINK_clone(&src, &page->arena, &link);
+        if (ret) goto out;
+        link->number = le32_to_cpu(number);
+
+        list_add_tail(&link->html_links, &page->html_links);
+        page->links_count++;
+    }
+
+    tmp = page->http_resp;
+    page->http_resp = dp->resp;
+    dp->resp = tmp;
+    page->http_payload = page->http_resp.data + dp->payload_offset;
+
+out:
+    return ret;
+}
+
+/*link table in order of page links list*/
+static int make_links_table(struct SURFFS_WEB_PAGE *page, sfs_string *table)
+{
+    int ret = 0;
+    struct SURFFS_HTML_LINK *link;
+    __le32 number;
+
+    list_for_each_entry(link, &page->html_links, html_links)
+    {
+        number = cpu_to_le32(link->number);
+
+        ret = sfs_string_ncat(table, (char *)&number, sizeof(number));
+        if (!ret) ret = sfs_string_ncat(table, link->title.data, link->title.textlen + 1);
+        if (!ret) ret = sfs_string_ncat(table, link->protocol.data, link->protocol.textlen + 1);
+        if (!ret) ret = sfs_string_ncat(table, link->host.data, link->host.textlen + 1);
+        if (!ret) ret = sfs_string_ncat(table, link->path.data, link->path.textlen + 1);
+        if (!ret) ret = sfs_string_ncat(table, link->full_url.data, link->full_url.textlen + 1);
+        if (ret) goto out;
+    }
+
+out:
+    return ret;
+}
+
+int surffs_disk_page_write(struct surffs_diskcache *dc, struct SURFFS_WEB_PAGE *page)
+{
+    int ret = 0;
+    sfs_string key = {0};
+    sfs_string name = {0};
+    sfs_string links = {0};
+    struct surffs_validators validators = {{0}};
+    struct surffs_disk_header hdr;
+    struct file *file = 0;
+    loff_t pos = 0;
+    u32 crc = ~0;
+
+    if (!page->http_payload) goto out;
+
+    ret = sfs_string_createz(&key, 128); if (ret) goto out;
+    ret = sfs_string_createz(&name, 128); if (ret) goto out;
+    ret = sfs_string_createz(&links, 1024); if (ret) goto out;
+    ret = sfs_string_createz(&validators.etag, 64); if (ret) goto out;
+    ret = sfs_string_createz(&validators.last_modified, 64); if (ret) goto out;
+
+    ret = disk_key(&page->address, &key); if (ret) goto out;
+    ret = disk_file_name(&key, &name); if (ret) goto out;
+    ret = surffs_http_header(&page->http_resp, "ETag", &validators.etag); if (ret) goto out;
+    ret = surffs_http_header(&page->http_resp, "Last-Modified", &validators.last_modified);
+    if (ret) goto out;
+    ret = make_links_table(page, &links); if (ret) goto out;
+
+    crc = crc32_le(crc, key.data, key.textlen);
+    crc = crc32_le(crc, validators.etag.data, validators.etag.textlen);
+    crc = crc32_le(crc, validators.last_modified.data, validators.last_modified.textlen);
+    crc = crc32_le(crc, page->http_resp.data, page->http_resp.textlen);
+    crc = crc32_le(crc, links.data, links.textlen);
+
+    hdr.magic = cpu_to_le32(SURFFS_DISK_MAGIC);
+    hdr.version = cpu_to_le32(SURFFS_DISK_VERSION);
+    hdr.crc = cpu_to_le32(crc);
+    hdr.key_len = cpu_to_le32(key.textlen);
+    hdr.etag_len = cpu_to_le32(validators.etag.textlen);
+    hdr.last_modified_len = cpu_to_le32(validators.last_modified.textlen);
+    hdr.resp_len = cpu_to_le32(page->http_resp.textlen);
+    hdr.payload_offset = cpu_to_le32(page->http_payload - page->http_resp.data);
+    hdr.links_count = cpu_to_le32(page->links_count);
+    hdr.links_len = cpu_to_le32(links.textlen);
+    hdr.stored = cpu_to_le64(get_seconds());
+
+    file = surffs_local_open(&dc->dir, name.data, O_WRONLY | O_CREAT | O_TRUNC,
+                             S_IRUSR | S_IWUSR);
+    if (IS_ERR(file)) {ret = PTR_ERR(file); file = 0; goto out;}
+
+    ret = disk_write(file, &pos, &hdr, sizeof(hdr)); if (ret) goto out;
+    ret = disk_write(file, &pos, key.data, key.textlen); if (ret) goto out;
+    ret = disk_write(file, &pos, validators.etag.data, validators.etag.textlen); if (ret) goto out;
+    ret = disk_write(file, &pos, validators.last_modified.data,
+                     validators.last_modified.textlen);
+    if (ret) goto out;
+    ret = disk_write(file, &pos, page->http_resp.data, page->http_resp.textlen); if (ret) goto out;
+    ret = disk_write(file, &pos, links.data, links.textlen); if (ret) goto out;
+
+out:
+    if (file) filp_close(file, NULL);
+    sfs_string_free(&key);
+    sfs_string_free(&name);
+    sfs_string_free(&links);
+    sfs_string_free(&validators.etag);
+    sfs_string_free(&validators.last_modified);
+
+    return ret;
+}
@@ -0,0 +1,79 @@
+#ifndef _SURFFS_DISKCACHE_H_
+#define _SURFFS_DISKCACHE_H_
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include "surffs_helpers.h"
+#include "surffs_localfile.h"
+#include "surffs_webpages.h"
+#include "surffs_socket.h"
+
+/*
+ * Disk cache of mount (option cache_dir=<absolute path>): every fetched page
+ * is written to its own file <cache_dir>/<hash of host:port/path> with
+ * validators (ETag, Last-Modified), http response and link table.
+ * Nothing is read at mounting: the file of a page is looked up when the
+ * page is missing in memory, then the page is revalidated by conditional
+ * GET. "304 Not Modified" or an unreachable server make the page be taken
+ * from disk. Torn or foreign files are detected by key and crc and ignored.
+ */
+#define SURFFS_DISK_MAGIC       0x43444653      /*"SFDC"*/
+#define SURFFS_DISK_VERSION     1
+/*larger sections mean a corrupted file*/
+#define SURFFS_DISK_MAX_SECTION (64 << 20)
+
+struct surffs_diskcache
+{
+    struct surffs_local_dir dir;    /*path is NULL - no disk cache*/
+};
+
+/*file: header, key, etag, last_modified, http response, link table*/
+struct surffs_disk_header
+{
+    __le32 magic;
+    __le32 version;
+    __le32 crc;                 /*crc32 of everything after header*/
+    __le32 key_len;
+    __le32 etag_len;
+    __le32 last_modified_len;
+    __le32 resp_len;
+    __le32 payload_offset;
+    __le32 links_count;
+    __le32 links_len;
+    __le64 stored;              /*seconds*/
+};
+
+/*
+ * link table entry: __le32 number, then NUL-terminated title, protocol,
+ * host, path and full_url
+ */
+
+/*copy of page read from disk*/
+struct surffs_disk_page
+{
+    struct surffs_validators validators;
+    sfs_string resp;
+    u32 payload_offset;
+    sfs_string links;
+    u32 links_count;
+    unsigned long stored;       /*seconds*/
+};
+
+int  surffs_diskcache_init(struct surffs_diskcache *dc, const char *dir);
+void surffs_diskcache_free(struct surffs_diskcache *dc);
+
+static inline int surffs_diskcache_enabled(struct surffs_diskcache *dc)
+{
+    return dc && dc->dir.path;
+}
+
+/*-ENOENT if there is no valid copy of page at address*/
+int  surffs_disk_page_read(struct surffs_diskcache *dc, struct SURFFS_WEB_ADDRESS *address,
+                           struct surffs_disk_page *dp);
+/*moves response and links of disk copy to page which has none yet*/
+int  surffs_disk_page_install(struct surffs_disk_page *dp, struct SURFFS_WEB_PAGE *page);
+void surffs_disk_page_free(struct surffs_disk_page *dp);
+
+int  surffs_disk_page_write(struct surffs_diskcache *dc, struct SURFFS_WEB_PAGE *page);
+
+#endif
@@ -0,0 +1,300 @@
+#include "surffs_eventlog.h"
+#include "surffs_debug.h"
+#include "surffs_webpages.h"
+#include "surffs_parser.h"
+#include "surffs_socket.h"
+#include "surffs_timeout.h"
+#include <linux/string.h>
+
+#define SFS_EVENT_LOG_MIN_RECORDS 16
+
+void sfs_event_log_init(struct sfs_event_log *log, struct sfs_arena *arena)
+{
+    log->records = 0;
+    log->count = 0;
+    log->capacity = 0;
+    log->arena = arena;
+}
+
+int sfs_event_log_add(struct sfs_event_log *log, enum SURFFS_LOG_EVENT event,
+                      u8 arg, u32 index, s32 value)
+{
+    struct sfs_log_record *records;
+    struct sfs_log_record *rec;
+    u32 newcapacity;
+
+    if (log->count == log->capacity)
+    {
+        newcapacity = log->capacity ? log->capacity * 2 : SFS_EVENT_LOG_MIN_RECORDS;
+        records = sfs_arena_realloc(log->arena, log->records,
+                                    log->capacity * sizeof(struct sfs_log_record),
+                                    newcapacity * sizeof(struct sfs_log_record));
+        if (!records) return -ENOMEM;
+
+        log->records = records;
+        log->capacity = newcapacity;
+    }
+
+    rec = &log->records[log->count++];
+    rec->event = event;
+    rec->arg = arg;
+    rec->reserved = 0;
+    rec->index = index;
+    rec->value = value;
+
+    return 0;
+}
+
+static int render_link_added(struct SURFFS_WEB_PAGE *page,
+                             struct sfs_log_record *rec,
+                             struct list_head **cursor,
+                             sfs_string *text)
+{
+    struct list_head *pos;
+    struct SURFFS_HTML_LINK *link;
+
+    /*
+     * links are prepended to page list in order of their numbers,
+     * so walking list backwards meets them in order of records
+     */
+    pos = (*cursor)->prev;
+    if (pos != &page->html_links)
+    {
+        link = list_entry(pos, struct SURFFS_HTML_LINK, html_links);
+        if (link->number == rec->index)
+        {
+            *cursor = pos;
+            goto found;
+        }
+    }
+
+    list_for_each(pos, &page->html_links)
+    {
+        link = list_entry(pos, struct SURFFS_HTML_LINK, html_links);
+        if (link->number == rec->index) goto found;
+    }
+
+    return sfs_string_catf(text, "add html link #%u\n", rec->index);
+
+found:
+    return sfs_string_catf(text, "add html link: title = '%s' url = '%s'\n",
+                           link->title.data, link->full_url.data);
+}
+
+/*skipped links are not stored, so link is parsed again from page text*/
+static int render_link_skipped(struct SURFFS_WEB_PAGE *page,
+                               struct sfs_log_record *rec,
+                               sfs_string *a_block,
+                               struct SURFFS_HTML_LINK *link,
+                               sfs_string *text)
+{
+    int ret = 0;
+    const char *textpos;
+    const char *url;
+    size_t kept = page->http_resp.textlen - (page->http_payload - page->http_resp.data);
+
+    /*lazy body keeps only head of page text, link past it is not parsed again*/
+    if (rec->index >= kept)
+        return sfs_string_catf(text, "skip html link at offset %u\n", rec->index);
+
+    textpos = page->http_payload + rec->index;
+
+    ret = extract_html_block(&textpos, "a", a_block);
+    if (ret) return ret;
+
+    ret = extract_html_link_params(a_block->data, link);
+    if (ret) return ret;
+
+    url = link->full_url.data;
+
+    switch (rec->arg)
+    {
+        case LINK_EMPTY_TITLE:
+            return sfs_string_catf(text, "error check link '%s': empty title\n", url);
+
+        case LINK_EMPTY_URL:
+            return sfs_string_catf(text, "error check link '%s': empty url\n", url);
+
+        case LINK_BAD_PROTOCOL:
+            return sfs_string_catf(text, "error check link '%s': protocol '%s' not supported\n",
+                                   url, link->protocol.data);
+
+        case LINK_OTHER_HOST:
+            return sfs_string_catf(text,
+                "error check link '%s': links to another host not supported (parent host = '%s')\n",
+                url, page->address.host.data);
+
+        case LINK_SAME_PATH:
+            return sfs_string_catf(text,
+                "error check link '%s': link to same path (parent path = '%s')\n",
+                url, page->address.path.data);
+
+        default:
+            return sfs_string_catf(text, "skip html link '%s'\n", url);
+    }
+}
+
+static const char *disk_loaded_str(u8 reason)
+{
+    switch (reason)
+    {
+        case DISK_STALE:    return "server unreachable, stale page taken from disk cache\n";
+        case DISK_SITEMAP:  return "page taken from disk cache, it is newer than lastmod of sitemap\n";
+        default:            return "page taken from disk cache\n";
+    }
+}
+
+static const char *redirect_refused_str(u8 reason)
+{
+    switch (reason)
+    {
+        case REDIRECT_NO_LOCATION:  return "no Location header";
+        case REDIRECT_OTHER_HOST:   return "redirects to another host are not supported";
+        case REDIRECT_TOO_MANY:     return "too many redirects";
+        default:                    return "unknown reason";
+    }
+}
+
+int sfs_event_log_render(struct SURFFS_WEB_PAGE *page, sfs_string *text)
+{
+    int ret = 0;
+    u32 i;
+    struct sfs_log_record *rec;
+    struct list_head *cursor = &page->html_links;
+    sfs_string request = {0};
+    sfs_string a_block = {0};
+    struct SURFFS_HTML_LINK *scratch = 0;
+
+    ret = sfs_string_clear(text);
+    if (ret) goto out;
+
+    for (i = 0; i < page->events.count; i++)
+    {
+        rec = &page->events.records[i];
+
+        switch (rec->event)
+        {
+            case EV_CONNECTED:
+                ret = sfs_string_catf(text, "connected to %pI4:%d\n",
+                                      &rec->index, rec->value);
+            break;
+
+            case EV_CONNECT_ERROR:
+                ret = sfs_string_catf(text, "error connecting to %pI4:%u, errcode = %d\n",
+                                      &rec->index, page->address.port, rec->value);
+            break;
+
+            case EV_REQUEST:
+                ret = surffs_make_request(page->address.path.data,
+                                          page->address.host.data, 0, &request);
+                if (ret) goto out;
+                ret = sfs_string_catf(text, "request:\n%s\n----------\n", request.data);
+            break;
+
+            case EV_SEND_ERROR:
+                ret = sfs_string_catf(text,
+                        "error sending data to socket: sent only %d of %u bytes\n",
+                        rec->value, rec->index);
+            break;
+
+            case EV_RECEIVED:
+                ret = sfs_string_catf(text, "received %d bytes\n", rec->value);
+            break;
+
+            case EV_EMPTY_RESPONSE:
+                ret = sfs_string_cat(text,
+                        "error extract http payload: empty server response\n");
+            break;
+
+            case EV_BAD_STATUS:
+                ret = sfs_string_catf(text,
+                        "error extract http payload: bad http status code (\"200 OK\" not found). "
+                        "Server response:\n%s\n---------\n",
+                        page->http_resp.textlen ? page->http_resp.data : "");
+            break;
+
+            case EV_NO_HEADERS_END:
+                ret = sfs_string_cat(text,
+                        "error extract http payload: http headers separator not found ('\\r\\n\\r\\n')\n");
+            break;
+
+            case EV_NO_BODY:
+                ret = sfs_string_cat(text, "error extract http payload: no http body\n");
+            break;
+
+            case EV_PAYLOAD_EXTRACTED:
+                ret = sfs_string_cat(text, "http data extracted\n");
+            break;
+
+            case EV_TIMEOUT:
+                ret = sfs_string_catf(text, "error: %s timeout (%d ms) expired (%pI4)\n",
+                                      surffs_timeout_phase_name(rec->arg), rec->value,
+                                      &rec->index);
+            break;
+
+            case EV_HEDGED:
+                ret = sfs_string_catf(text, "no first byte in %d ms, hedged request sent\n",
+                                      rec->value);
+            break;
+
+            case EV_REDIRECT:
+                ret = sfs_string_catf(text, "redirect (http status %d)\n", rec->value);
+            break;
+
+            case EV_REDIRECT_REFUSED:
+                ret = sfs_string_catf(text, "error: redirect not followed: %s\n",
+                                      redirect_refused_str(rec->arg));
+            break;
+
+            case EV_NOT_MODIFIED:
+                ret = sfs_string_cat(text, "not modified (http status 304)\n");
+            break;
+
+            case EV_DISK_LOADED:
+                ret = sfs_string_cat(text, disk_loaded_str(rec->arg));
+            break;
+
+            case EV_FILE_ERROR:
+                ret = sfs_string_catf(text, "error reading page from mirror, errcode = %d\n",
+                                      rec->value);
+            break;
+
+            case EV_OFFLOADED:
+                ret = sfs_string_catf(text, "request queued to fetch daemon, slot %d\n",
+                                      rec->value);
+            break;
+
+            case EV_OFFLOAD_ERROR:
+                ret = sfs_string_catf(text, "error fetching by fetch daemon, errcode = %d\n",
+                                      rec->value);
+            break;
+
+            case EV_LINK_ADDED:
+                ret = render_link_added(page, rec, &cursor, text);
+            break;
+
+            case EV_LINK_SKIPPED:
+                if (!page->http_payload) break;
+                if (!scratch)
+                {
+                    ret = SURFFS_HTML_LINK_alloc(&scratch);
+                    if (ret) goto out;
+                }
+                ret = render_link_skipped(page, rec, &a_block, scratch, text);
+            break;
+
+            default:
+                ret = sfs_string_catf(text, "unknown event %u\n", rec->event);
+            break;
+        }
+
+        if (ret) goto out;
+    }
+
+out:
+    if (scratch) SURFFS_HTML_LINK_free(scratch);
+    sfs_string_free(&a_block);
+    sfs_string_free(&request);
+
+    return ret;
+}
@@ -0,0 +1,91 @@
+#ifndef _SURFFS_EVENTLOG_H_
+#define _SURFFS_EVENTLOG_H_
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include "surffs_helpers.h"
+#include "surffs_arena.h"
+
+/*
+ * Loading events of web page are stored as compact records and rendered
+ * to human-readable text only when loading.log is read.
+ */
+enum SURFFS_LOG_EVENT
+{
+    EV_NONE = 0,
+    EV_CONNECTED,           /*value = port, index = ip (__be32)*/
+    EV_CONNECT_ERROR,       /*value = errcode, index = ip*/
+    EV_REQUEST,
+    EV_SEND_ERROR,          /*value = sent bytes, index = request length*/
+    EV_RECEIVED,            /*value = received bytes*/
+    EV_EMPTY_RESPONSE,
+    EV_BAD_STATUS,
+    EV_NO_HEADERS_END,
+    EV_NO_BODY,
+    EV_PAYLOAD_EXTRACTED,
+    EV_LINK_ADDED,          /*index = link number*/
+    EV_LINK_SKIPPED,        /*arg = SURFFS_LINK_CHECK, index = offset of <a> in payload*/
+    EV_TIMEOUT,             /*arg = SURFFS_TIMEOUT_PHASE, value = timeout in ms, index = ip*/
+    EV_HEDGED,              /*value = hedge delay in ms*/
+    EV_REDIRECT,            /*value = http status*/
+    EV_REDIRECT_REFUSED,    /*arg = SURFFS_REDIRECT_CHECK*/
+    EV_NOT_MODIFIED,
+    EV_DISK_LOADED,         /*arg = SURFFS_DISK_LOAD*/
+    EV_FILE_ERROR,          /*value = errcode*/
+    EV_OFFLOADED,           /*value = slot of fetch daemon*/
+    EV_OFFLOAD_ERROR        /*value = errcode given by fetch daemon*/
+};
+
+/*reason of not following redirect*/
+enum SURFFS_REDIRECT_CHECK
+{
+    REDIRECT_NO_LOCATION = 0,
+    REDIRECT_OTHER_HOST,
+    REDIRECT_TOO_MANY
+};
+
+/*why page is taken from disk cache*/
+enum SURFFS_DISK_LOAD
+{
+    DISK_NOT_MODIFIED = 0,
+    DISK_STALE,
+    DISK_SITEMAP                /*copy is newer than lastmod of sitemap*/
+};
+
+/*result of checking html link*/
+enum SURFFS_LINK_CHECK
+{
+    LINK_OK = 0,
+    LINK_EMPTY_TITLE,
+    LINK_EMPTY_URL,
+    LINK_BAD_PROTOCOL,
+    LINK_OTHER_HOST,
+    LINK_SAME_PATH
+};
+
+struct sfs_log_record
+{
+    u8 event;
+    u8 arg;
+    u16 reserved;
+    u32 index;
+    s32 value;
+};
+
+/*records array lives in arena of web page*/
+struct sfs_event_log
+{
+    struct sfs_log_record *records;
+    u32 count;
+    u32 capacity;
+    struct sfs_arena *arena;
+};
+
+struct SURFFS_WEB_PAGE;
+
+void sfs_event_log_init(struct sfs_event_log *log, struct sfs_arena *arena);
+int  sfs_event_log_add(struct sfs_event_log *log, enum SURFFS_LOG_EVENT event,
+                       u8 arg, u32 index, s32 value);
+int  sfs_event_log_render(struct SURFFS_WEB_PAGE *page, sfs_string *text);
+
+#endif
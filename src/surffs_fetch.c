@@ -0,0 +1,234 @@
+#include "surffs_fetch.h"
+#include "surffs_debug.h"
+#include "surffs_socket.h"
+#include "surffs_sb.h"
+#include "surffs_hedge.h"
+#include "surffs_mirror.h"
+#include "surffs_offload.h"
+#include <linux/mutex.h>
+#include <linux/string.h>
+
+static LIST_HEAD(backends_list);
+static DEFINE_MUTEX(backends_lock);
+
+/*interrupted fetch or lack of memory say nothing about origin*/
+static int fetch_aborted(int ret)
+{
+    return ret == -EINTR || ret == -ERESTARTSYS || ret == -ECANCELED || ret == -ENOMEM;
+}
+
+/*
+ * request waits for rate limiter of mount, response is charged to it.
+ * With offload page is fetched by daemon if there is one
+ */
+static int limited_get_http(struct surffs_sb_info *fsi, char *ip,
+                            struct SURFFS_WEB_ADDRESS *address,
+                            struct surffs_validators *cond,
+                            sfs_string *http_response,
+                            char **http_payload_start,
+                            struct sfs_event_log *log,
+                            int *failed,
+                            struct surffs_http_ctl *ctl)
+{
+    int ret = 0;
+
+    if (fsi)
+    {
+        ret = surffs_ratelimit_get(&fsi->ratelimit, &fsi->stats, ctl ? &ctl->cancelled : 0);
+        if (ret)
+        {
+            *http_payload_start = 0;
+            *failed = 0;
+            return ret;
+        }
+    }
+
+    ret = -ENODEV;
+    if (fsi && fsi->offload)
+    {
+        ret = surffs_offload_get_http(fsi, ip, address->port, address->host.data,
+                                      address->path.data, cond, http_response,
+                                      http_payload_start, log, failed, ctl);
+        if (ret == -ENODEV) sfs_stat_inc(&fsi->stats, SFS_STAT_OFFLOAD_FALLBACKS);
+    }
+
+    if (ret == -ENODEV)
+        ret = surffs_get_http(fsi, ip, address->port, address->host.data, address->path.data,
+                              cond, http_response, http_payload_start, log, failed, ctl);
+
+    if (fsi) surffs_ratelimit_put(&fsi->ratelimit, http_response->textlen);
+
+    return ret;
+}
+
+/*
+ * every origin of host (except ones in tried mask) is tried once until one
+ * of them gives response, loading.log keeps events of all attempts
+ */
+static int fetch_origins(struct surffs_sb_info *fsi,
+                         struct SURFFS_WEB_ADDRESS *address,
+                         struct surffs_validators *cond,
+                         sfs_string *http_response,
+                         char **http_payload_start,
+                         struct sfs_event_log *log,
+                         struct surffs_http_ctl *ctl,
+                         unsigned long tried,
+                         int *failed)
+{
+    int ret = 0;
+    int index;
+    struct surffs_origin *origin;
+    struct surffs_origins *origins = fsi ? surffs_host_origins(fsi, address->host.data) : 0;
+
+    *failed = 0;
+
+    if (!origins || !origins->count)
+        return limited_get_http(fsi, address->ip.data, address, cond,
+                                http_response, http_payload_start, log, failed, ctl);
+
+    while ((origin = surffs_origin_get(origins, tried)))
+    {
+        index = surffs_origin_index(origins, origin);
+        if (*failed) sfs_stat_inc(&fsi->stats, SFS_STAT_FAILOVERS);
+        tried |= 1UL << index;
+        if (ctl) ctl->origin = index;
+
+        ret = limited_get_http(fsi, origin->ip, address, cond,
+                               http_response, http_payload_start, log, failed, ctl);
+
+        if (fetch_aborted(ret)) *failed = 0;
+        surffs_origin_put(origins, origin, *failed);
+
+        if (!*failed) break;
+    }
+
+    return ret;
+}
+
+/*fetch through circuit breaker of mount*/
+int surffs_http_fetch(struct surffs_sb_info *fsi,
+                      struct SURFFS_WEB_ADDRESS *address,
+                      struct surffs_validators *cond,
+                      sfs_string *http_response,
+                      char **http_payload_start,
+                      struct sfs_event_log *log,
+                      struct surffs_http_ctl *ctl,
+                      unsigned long tried)
+{
+    int ret = 0;
+    int failed = 0;
+    int probe = 0;
+    enum SURFFS_BREAKER_RESULT result;
+
+    if (fsi)
+    {
+        ret = surffs_breaker_get(&fsi->breaker, &probe);
+        if (ret)
+        {
+            *http_payload_start = 0;
+            sfs_stat_inc(&fsi->stats, SFS_STAT_BREAKER_REJECTS);
+            goto out;
+        }
+    }
+
+    ret = fetch_origins(fsi, address, cond, http_response, http_payload_start, log, ctl,
+                        tried, &failed);
+
+    if (fsi)
+    {
+        result = fetch_aborted(ret) ? SFS_BREAKER_NEUTRAL :
+                 failed ? SFS_BREAKER_FAILED : SFS_BREAKER_OK;
+        surffs_breaker_put(&fsi->breaker, probe, result);
+    }
+
+out:
+    return ret;
+}
+
+static int http_fetch(struct surffs_sb_info *fsi,
+                      struct SURFFS_WEB_ADDRESS *address,
+                      struct surffs_validators *cond,
+                      sfs_string *http_response,
+                      char **http_payload_start,
+                      struct sfs_event_log *log)
+{
+    if (fsi && fsi->hedge_percentile)
+        return surffs_hedged_fetch(fsi, address, cond, http_response, http_payload_start, log);
+
+    return surffs_http_fetch(fsi, address, cond, http_response, http_payload_start, log, 0, 0);
+}
+
+struct surffs_fetch_backend surffs_http_backend = {
+    .name   = "http",
+    .fetch  = http_fetch,
+};
+
+/*called with backends_lock held*/
+static struct surffs_fetch_backend *lookup_backend(const char *name)
+{
+    struct surffs_fetch_backend *backend;
+
+    /*url without scheme is http one*/
+    if (!name[0]) return &surffs_http_backend;
+    if (strcmp(name, surffs_http_backend.name) == 0) return &surffs_http_backend;
+    if (strcmp(name, surffs_file_backend.name) == 0) return &surffs_file_backend;
+
+    list_for_each_entry(backend, &backends_list, backends)
+        if (strcmp(name, backend->name) == 0)
+            return backend;
+
+    return 0;
+}
+
+/*backends are not refcounted: they live as long as module does*/
+int surffs_register_backend(struct surffs_fetch_backend *backend)
+{
+    int ret = 0;
+
+    mutex_lock(&backends_lock);
+
+    if (lookup_backend(backend->name))
+    {
+        sfs_error("fetch backend '%s' is already registered\n", backend->name);
+        ret = -EEXIST;
+        goto out;
+    }
+
+    list_add_tail(&backend->backends, &backends_list);
+
+out:
+    mutex_unlock(&backends_lock);
+    return ret;
+}
+
+void surffs_unregister_backend(struct surffs_fetch_backend *backend)
+{
+    mutex_lock(&backends_lock);
+    list_del_init(&backend->backends);
+    mutex_unlock(&backends_lock);
+}
+
+struct surffs_fetch_backend *surffs_find_backend(const char *name)
+{
+    struct surffs_fetch_backend *backend;
+
+    mutex_lock(&backends_lock);
+    backend = lookup_backend(name);
+    mutex_unlock(&backends_lock);
+
+    return backend;
+}
+
+int surffs_fetch(struct surffs_sb_info *fsi,
+                 struct SURFFS_WEB_ADDRESS *address,
+                 struct surffs_validators *cond,
+                 sfs_string *http_response,
+                 char **http_payload_start,
+                 struct sfs_event_log *log)
+{
+    struct surffs_fetch_backend *backend = &surffs_http_backend;
+
+    if (fsi && fsi->backend) backend = fsi->backend;
+
+    return backend->fetch(fsi, address, cond, http_response, http_payload_start, log);
+}
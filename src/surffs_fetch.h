@@ -0,0 +1,61 @@
+#ifndef _SURFFS_FETCH_H_
+#define _SURFFS_FETCH_H_
+
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include "surffs_helpers.h"
+#include "surffs_eventlog.h"
+#include "surffs_webpages.h"
+
+struct surffs_sb_info;
+struct surffs_validators;
+
+/*
+ * Fetch backend gets raw http response of one page. Backend is chosen at
+ * mounting by url scheme ("http://..." - surffs_http_backend), so tests can
+ * mount a site served from memory.
+ * fetch() fills http_response and sets http_payload_start to the body
+ * (0 if page has no body or bad status), loading events go to log.
+ * cond (may be NULL) are validators of cached copy: backend may answer
+ * "304 Not Modified" then.
+ */
+struct surffs_fetch_backend
+{
+    const char *name;
+    int local;                  /*pages are on local disk, no ip= is needed*/
+    struct list_head backends;
+
+    int (*fetch)(struct surffs_sb_info *fsi,
+                 struct SURFFS_WEB_ADDRESS *address,
+                 struct surffs_validators *cond,
+                 sfs_string *http_response,
+                 char **http_payload_start,
+                 struct sfs_event_log *log);
+};
+
+extern struct surffs_fetch_backend surffs_http_backend;
+
+int  surffs_register_backend(struct surffs_fetch_backend *backend);
+void surffs_unregister_backend(struct surffs_fetch_backend *backend);
+struct surffs_fetch_backend *surffs_find_backend(const char *name);
+
+struct surffs_http_ctl;
+
+/*fetch by http from origins of mount, origins in tried mask are skipped*/
+int surffs_http_fetch(struct surffs_sb_info *fsi,
+                      struct SURFFS_WEB_ADDRESS *address,
+                      struct surffs_validators *cond,
+                      sfs_string *http_response,
+                      char **http_payload_start,
+                      struct sfs_event_log *log,
+                      struct surffs_http_ctl *ctl,
+                      unsigned long tried);
+
+int surffs_fetch(struct surffs_sb_info *fsi,
+                 struct SURFFS_WEB_ADDRESS *address,
+                 struct surffs_validators *cond,
+                 sfs_string *http_response,
+                 char **http_payload_start,
+                 struct sfs_event_log *log);
+
+#endif
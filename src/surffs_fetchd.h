@@ -0,0 +1,55 @@
+#ifndef _SURFFS_FETCHD_H_
+#define _SURFFS_FETCHD_H_
+
+/*
+ * Protocol of /dev/surffs-fetch, shared by module and fetch daemon
+ * (tools/surffs_fetchd.c), see src/surffs_offload.h.
+ *
+ * Daemon opens the device (one daemon at a time) and maps
+ * SURFFS_FETCHD_AREA_SIZE bytes of it: SURFFS_FETCHD_SLOTS slots of
+ * SURFFS_FETCHD_SLOT_SIZE bytes, slot n starts at n * SURFFS_FETCHD_SLOT_SIZE.
+ * read() gives whole surffs_fetchd_request records (blocks unless
+ * O_NONBLOCK, poll() says POLLIN when there are some). Daemon puts raw http
+ * response (status line, headers and body) to the slot of request and
+ * write()s surffs_fetchd_reply with the same slot and seq.
+ * A response which does not fit slot is answered with error -EFBIG: module
+ * fetches the page itself then.
+ */
+
+#include <linux/types.h>
+
+#define SURFFS_FETCHD_DEVICE        "/dev/surffs-fetch"
+#define SURFFS_FETCHD_SLOTS         32
+#define SURFFS_FETCHD_SLOT_SIZE     (256 * 1024)
+#define SURFFS_FETCHD_AREA_SIZE     (SURFFS_FETCHD_SLOTS * SURFFS_FETCHD_SLOT_SIZE)
+
+#define SURFFS_FETCHD_IP_LEN        48
+#define SURFFS_FETCHD_HOST_LEN      256
+#define SURFFS_FETCHD_PATH_LEN      2048
+#define SURFFS_FETCHD_ETAG_LEN      256
+#define SURFFS_FETCHD_DATE_LEN      64
+
+struct surffs_fetchd_request
+{
+    __u32 slot;
+    __u32 seq;                  /*reply must carry it back*/
+    __u16 port;
+    __u16 reserved;
+    __u32 timeout_ms;           /*whole fetch, 0 - no limit*/
+    char ip[SURFFS_FETCHD_IP_LEN];
+    char host[SURFFS_FETCHD_HOST_LEN];
+    char path[SURFFS_FETCHD_PATH_LEN];
+    /*validators of cached copy, empty - unconditional GET*/
+    char etag[SURFFS_FETCHD_ETAG_LEN];
+    char last_modified[SURFFS_FETCHD_DATE_LEN];
+};
+
+struct surffs_fetchd_reply
+{
+    __u32 slot;
+    __u32 seq;
+    __s32 error;                /*0 or -errno of failed fetch*/
+    __u32 len;                  /*bytes of response in slot*/
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include "surffs_hedge.h"
+#include "surffs_debug.h"
+#include "surffs_fetch.h"
+#include "surffs_socket.h"
+#include "surffs_sb.h"
+#include "surffs_stats.h"
+#include <linux/workqueue.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+static struct workqueue_struct *hedge_wq;
+
+struct hedge_attempt
+{
+    struct work_struct work;
+    struct hedge_fetch *hf;
+    struct surffs_http_ctl ctl;
+    unsigned long tried;
+
+    sfs_string resp;
+    char *payload;
+    struct sfs_arena arena;
+    struct sfs_event_log log;
+
+    int ret;
+    int done;
+};
+
+struct hedge_fetch
+{
+    struct surffs_sb_info *fsi;
+    struct SURFFS_WEB_ADDRESS *address;
+    struct surffs_validators *cond;
+    wait_queue_head_t wq;
+
+    struct hedge_attempt attempts[2];
+    int started;
+};
+
+int surffs_hedge_init(void)
+{
+    hedge_wq = alloc_workqueue("surffs_hedge", WQ_UNBOUND, 0);
+    if (!hedge_wq) return -ENOMEM;
+
+    return 0;
+}
+
+void surffs_hedge_exit(void)
+{
+    if (hedge_wq) destroy_workqueue(hedge_wq);
+    hedge_wq = 0;
+}
+
+unsigned int surffs_hedge_delay_ms(struct surffs_sb_info *fsi)
+{
+    u64 samples;
+    u64 connect_us;
+    u64 ttfb_us;
+
+    ttfb_us = surffs_stats_percentile_us(&fsi->stats, SFS_PHASE_TTFB,
+                                         fsi->hedge_percentile, &samples);
+    if (samples < SURFFS_HEDGE_MIN_SAMPLES) return 0;
+
+    connect_us = surffs_stats_percentile_us(&fsi->stats, SFS_PHASE_CONNECT,
+                                            fsi->hedge_percentile, &samples);
+
+    return max_t(u64, DIV_ROUND_UP(connect_us + ttfb_us, 1000), 1);
+}
+
+static void hedge_attempt_work(struct work_struct *work)
+{
+    struct hedge_attempt *a = container_of(work, struct hedge_attempt, work);
+    struct hedge_fetch *hf = a->hf;
+
+    a->ret = surffs_http_fetch(hf->fsi, hf->address, hf->cond, &a->resp, &a->payload,
+                               &a->log, &a->ctl, a->tried);
+    smp_wmb();
+    a->done = 1;
+    wake_up(&hf->wq);
+}
+
+static int hedge_start(struct hedge_fetch *hf, unsigned long tried)
+{
+    struct hedge_attempt *a = &hf->attempts[hf->started];
+    int ret = 0;
+
+    a->hf = hf;
+    a->tried = tried;
+    surffs_http_ctl_init(&a->ctl, &hf->wq);
+    sfs_arena_init(&a->arena);
+    sfs_event_log_init(&a->log, &a->arena);
+    INIT_WORK(&a->work, hedge_attempt_work);
+
+    ret = sfs_string_createz(&a->resp, 4096);
+    if (ret) goto out;
+
+    hf->started++;
+    queue_work(hedge_wq, &a->work);
+
+out:
+    if (ret)
+    {
+        sfs_string_free(&a->resp);
+        sfs_arena_free(&a->arena);
+    }
+
+    return ret;
+}
+
+/*attempt which started answering first, or the last one if all have finished*/
+static struct hedge_attempt *hedge_winner(struct hedge_fetch *hf)
+{
+    struct hedge_attempt *winner = 0;
+    struct hedge_attempt *a;
+    int done = 0;
+    int i;
+
+    smp_rmb();
+    for (i = 0; i < hf->started; i++)
+    {
+        a = &hf->attempts[i];
+        if (a->done) done++;
+        if (!a->ctl.first_byte) continue;
+
+        if (!winner || ktime_compare(a->ctl.first_byte_at, winner->ctl.first_byte_at) < 0)
+            winner = a;
+    }
+
+    if (!winner && done == hf->started) winner = &hf->attempts[hf->started - 1];
+
+    return winner;
+}
+
+static int wait_error(void)
+{
+    return fatal_signal_pending(current) ? -EINTR : -ERESTARTSYS;
+}
+
+/*results of winner are moved to page*/
+static int hedge_take(struct hedge_attempt *a, sfs_string *http_response,
+                      char **http_payload_start, struct sfs_event_log *log)
+{
+    int ret = 0;
+    sfs_string tmp;
+    u32 i;
+
+    tmp = *http_response;
+    *http_response = a->resp;
+    a->resp = tmp;
+    *http_payload_start = a->payload;
+
+    for (i = 0; i < a->log.count && !ret; i++)
+        ret = sfs_event_log_add(log, a->log.records[i].event, a->log.records[i].arg,
+                                a->log.records[i].index, a->log.records[i].value);
+
+    return ret ? ret : a->ret;
+}
+
+int surffs_hedged_fetch(struct surffs_sb_info *fsi,
+                        struct SURFFS_WEB_ADDRESS *address,
+                        struct surffs_validators *cond,
+                        sfs_string *http_response,
+                        char **http_payload_start,
+                        struct sfs_event_log *log)
+{
+    int ret = 0;
+    struct hedge_fetch *hf = 0;
+    struct hedge_attempt *winner = 0;
+    unsigned int delay_ms;
+    long waited;
+    int i;
+
+    delay_ms = surffs_hedge_delay_ms(fsi);
+    if (!delay_ms)
+        return surffs_http_fetch(fsi, address, cond, http_response, http_payload_start, log, 0, 0);
+
+    *http_payload_start = 0;
+
+    hf = kzalloc(sizeof(struct hedge_fetch), GFP_KERNEL);
+    if (!hf) {ret = -ENOMEM; goto out;}
+
+    hf->fsi = fsi;
+    hf->address = address;
+    hf->cond = cond;
+    init_waitqueue_head(&hf->wq);
+
+    ret = hedge_start(hf, 0);
+    if (ret) goto out;
+
+    waited = wait_event_interruptible_timeout(hf->wq,
+                hf->attempts[0].done || hf->attempts[0].ctl.first_byte,
+                msecs_to_jiffies(delay_ms));
+    if (waited < 0) {ret = wait_error(); goto out;}
+
+    if (!waited)
+    {
+        /*prefer another origin if there is one*/
+        ret = hedge_start(hf, fsi->origins.count > 1 && hf->attempts[0].ctl.origin >= 0 ?
+                              1UL << hf->attempts[0].ctl.origin : 0);
+        if (ret) goto out;
+
+        sfs_stat_inc(&fsi->stats, SFS_STAT_HEDGES);
+        ret = sfs_event_log_add(log, EV_HEDGED, 0, 0, delay_ms);
+        if (ret) goto out;
+    }
+
+    if (wait_event_interruptible(hf->wq, (winner = hedge_winner(hf)) != 0))
+    {
+        ret = wait_error();
+        goto out;
+    }
+
+    for (i = 0; i < hf->started; i++)
+        if (&hf->attempts[i] != winner) surffs_http_cancel(&hf->attempts[i].ctl);
+
+    if (wait_event_interruptible(hf->wq, winner->done))
+    {
+        ret = wait_error();
+        goto out;
+    }
+
+    if (winner == &hf->attempts[1]) sfs_stat_inc(&fsi->stats, SFS_STAT_HEDGE_WINS);
+
+    ret = hedge_take(winner, http_response, http_payload_start, log);
+
+out:
+    if (hf)
+    {
+        for (i = 0; i < hf->started; i++)
+        {
+            surffs_http_cancel(&hf->attempts[i].ctl);
+            flush_work(&hf->attempts[i].work);
+            sfs_string_free(&hf->attempts[i].resp);
+            sfs_arena_free(&hf->attempts[i].arena);
+        }
+        kfree(hf);
+    }
+
+    return ret;
+}
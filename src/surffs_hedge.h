@@ -0,0 +1,35 @@
+#ifndef _SURFFS_HEDGE_H_
+#define _SURFFS_HEDGE_H_
+
+#include <linux/kernel.h>
+#include "surffs_helpers.h"
+#include "surffs_eventlog.h"
+#include "surffs_webpages.h"
+
+/*
+ * Hedged requests (mount option hedge=<percentile>): if the first request
+ * has no first byte after the given percentile of connect + first byte
+ * times of mount, the same GET is sent on another connection (to another
+ * origin if there are several). The request which starts answering first
+ * wins, the other one is cancelled by shutting its socket down.
+ * Until SURFFS_HEDGE_MIN_SAMPLES responses were timed there is no hedging.
+ */
+#define SURFFS_HEDGE_MIN_SAMPLES 20
+
+struct surffs_sb_info;
+struct surffs_validators;
+
+int  surffs_hedge_init(void);
+void surffs_hedge_exit(void);
+
+/*0 if hedging is not possible yet*/
+unsigned int surffs_hedge_delay_ms(struct surffs_sb_info *fsi);
+
+int surffs_hedged_fetch(struct surffs_sb_info *fsi,
+                        struct SURFFS_WEB_ADDRESS *address,
+                        struct surffs_validators *cond,
+                        sfs_string *http_response,
+                        char **http_payload_start,
+                        struct sfs_event_log *log);
+
+#endif
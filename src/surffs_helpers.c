@@ -1,5 +1,6 @@
 #include "surffs_helpers.h"
 #include "surffs_debug.h"
+#include "surffs_arena.h"
 #include <linux/slab.h>
 
 static inline void zero_sfs_str(sfs_string *str)
@@ -7,6 +8,7 @@ static inline void zero_sfs_str(sfs_string *str)
     str->data = 0;
     str->memlen = 0;
     str->textlen = 0;
+    str->arena = 0;
 }
 
 int sfs_string_create(sfs_string *str, const char *data)
@@ -15,6 +17,7 @@ int sfs_string_create(sfs_string *str, const char *data)
     src_strlen = strlen(data);
     if (!src_strlen) {zero_sfs_str(str); return -EINVAL;}
 
+    str->arena = 0;
     str->data = kstrdup(data, GFP_KERNEL);
     if (str->data)
     {
@@ -29,6 +32,7 @@ int sfs_string_createz(sfs_string *str, size_t alloc_len)
 {
     if (!alloc_len) {zero_sfs_str(str); return -EINVAL;}
 
+    str->arena = 0;
     str->data = kmalloc(alloc_len, GFP_KERNEL);
     if (str->data)
     {
@@ -39,122 +43,176 @@ int sfs_string_createz(sfs_string *str, size_t alloc_len)
     } else {zero_sfs_str(str); return -ENOMEM;}
 }
 
+int sfs_string_create_in(sfs_string *str, struct sfs_arena *arena, const char *data)
+{
+    size_t src_strlen = strlen(data);
+
+    str->arena = arena;
+    str->data = sfs_arena_alloc(arena, src_strlen + 1);
+    if (!str->data) {zero_sfs_str(str); return -ENOMEM;}
+
+    memcpy(str->data, data, src_strlen + 1);
+    str->memlen = src_strlen + 1;
+    str->textlen = src_strlen;
+    return 0;
+}
+
+int sfs_string_createz_in(sfs_string *str, struct sfs_arena *arena, size_t alloc_len)
+{
+    if (!alloc_len) {zero_sfs_str(str); return -EINVAL;}
+
+    str->arena = arena;
+    str->data = sfs_arena_alloc(arena, alloc_len);
+    if (!str->data) {zero_sfs_str(str); return -ENOMEM;}
+
+    str->data[0] = 0;
+    str->memlen = alloc_len;
+    str->textlen = 0;
+    return 0;
+}
+
 void sfs_string_bind(sfs_string *str, char *data)
 {
     str->data = data;
     str->textlen = strlen(data);
     str->memlen = str->textlen + 1;
+    str->arena = 0;
 }
 
 int sfs_string_expandmem(sfs_string *str, size_t new_alloc_len)
 {
+    char *newdata;
+
     if (new_alloc_len <= str->memlen) return -EINVAL;
 
-    str->data = krealloc(str->data, new_alloc_len ,GFP_KERNEL);
-    if (str->data)
-    {
-        str->memlen = new_alloc_len;
-        return 0;
-    } else return -EINVAL;
+    if (str->arena)
+        newdata = sfs_arena_realloc(str->arena, str->data, str->memlen, new_alloc_len);
+    else
+        newdata = krealloc(str->data, new_alloc_len ,GFP_KERNEL);
+
+    if (!newdata) return -ENOMEM;
+
+    str->data = newdata;
+    str->memlen = new_alloc_len;
+    return 0;
 }
 
-int sfs_string_cat_param(sfs_string *str, const char* fmt, char* param)
+/*
+ * makes room for extra chars (plus terminating zero) after textlen.
+ * Memory grows geometrically, so appending is amortized O(1)
+ */
+int sfs_string_reserve(sfs_string *str, size_t extra)
 {
     int ret = 0;
+    int was_empty = !str->memlen;
+    size_t needed = str->textlen + extra + 1;
     size_t newmemlen;
 
-    size_t src_strlen = strlen(fmt) + strlen(param);
-    size_t new_chars_max = str->memlen - str->textlen - 1;
+    if (needed <= str->memlen) return 0;
 
-    if (src_strlen > new_chars_max)
+    newmemlen = str->memlen ? str->memlen : SFS_STRING_MIN_ALLOC;
+    while (newmemlen < needed) newmemlen *= 2;
+
+    ret = sfs_string_expandmem(str, newmemlen);
+    if (ret) return ret;
+
+    if (was_empty)
     {
-        newmemlen = str->memlen + (src_strlen - new_chars_max);
-        ret = sfs_string_expandmem(str, newmemlen);
-        if (ret) return ret;
-        str->memlen = newmemlen;
+        str->textlen = 0;
+        str->data[0] = 0;
     }
 
-    str->textlen += sprintf(str->data + str->textlen, fmt, param);
-
     return 0;
 }
 
-int sfs_string_ncat(sfs_string *str, const char* data, size_t len)
+int sfs_string_vcatf(sfs_string *str, const char* fmt, va_list args)
 {
     int ret = 0;
-    size_t newmemlen;
+    int len;
+    size_t avail = str->memlen ? str->memlen - str->textlen : 0;
+    va_list args_copy;
 
-    size_t src_strlen = len;
-    size_t new_chars_max = str->memlen - str->textlen - 1;
+    va_copy(args_copy, args);
+    len = vsnprintf(avail ? str->data + str->textlen : NULL, avail, fmt, args_copy);
+    va_end(args_copy);
 
-    if (src_strlen > new_chars_max)
+    if (len < 0) return -EINVAL;
+
+    if ((size_t)len >= avail)
     {
-        newmemlen = str->memlen + (src_strlen - new_chars_max);
-        ret = sfs_string_expandmem(str, newmemlen);
-        if (ret) return ret;
-        str->memlen = newmemlen;
+        ret = sfs_string_reserve(str, len);
+        if (ret)
+        {
+            if (str->memlen) str->data[str->textlen] = 0;
+            return ret;
+        }
+
+        vsnprintf(str->data + str->textlen, len + 1, fmt, args);
     }
 
-    strncat(str->data, data, len);
-    str->textlen += src_strlen;
+    str->textlen += len;
 
     return 0;
 }
 
-int sfs_string_cat(sfs_string *str, const char* data)
+int sfs_string_catf(sfs_string *str, const char* fmt, ...)
 {
-    int ret = 0;
-    size_t newmemlen;
+    int ret;
+    va_list args;
 
-    size_t src_strlen = strlen(data);
-    size_t new_chars_max = str->memlen - str->textlen - 1;
+    va_start(args, fmt);
+    ret = sfs_string_vcatf(str, fmt, args);
+    va_end(args);
 
-    if (src_strlen > new_chars_max)
-    {
-        newmemlen = str->memlen + (src_strlen - new_chars_max);
-        ret = sfs_string_expandmem(str, newmemlen);
-        if (ret) return ret;
-        str->memlen = newmemlen;
-    }
+    return ret;
+}
 
-    strcat(str->data, data);
-    str->textlen += src_strlen;
+int sfs_string_ncat(sfs_string *str, const char* data, size_t len)
+{
+    int ret = 0;
+
+    ret = sfs_string_reserve(str, len);
+    if (ret) return ret;
+
+    memcpy(str->data + str->textlen, data, len);
+    str->textlen += len;
+    str->data[str->textlen] = 0;
 
     return 0;
 }
 
+int sfs_string_cat(sfs_string *str, const char* data)
+{
+    return sfs_string_ncat(str, data, strlen(data));
+}
+
 int sfs_string_insert_begin(sfs_string *str, const char* data)
 {
     int ret = 0;
-    sfs_string tmp = {0};
-
-    ret = sfs_string_create(&tmp, str->data);
-    if (ret) goto out;
+    size_t len = strlen(data);
 
-    ret = sfs_string_set(str, data);
-    if (ret) goto out;
+    ret = sfs_string_reserve(str, len);
+    if (ret) return ret;
 
-    ret = sfs_string_cat(str, tmp.data);
-    if (ret) goto out;
+    memmove(str->data + len, str->data, str->textlen + 1);
+    memcpy(str->data, data, len);
+    str->textlen += len;
 
-out:
-    sfs_string_free(&tmp);
-    return ret;
+    return 0;
 }
 
 int sfs_string_clear(sfs_string *str)
 {
-    if (!str->memlen) return -EINVAL;
-
-    str->data[0] = 0;
     str->textlen = 0;
+    if (str->memlen) str->data[0] = 0;
 
     return 0;
 }
 
 void sfs_string_free(sfs_string *str)
 {
-    if (str->data) kfree(str->data);
+    if (str->data && !str->arena) kfree(str->data);
+    str->data = 0;
     str->memlen = 0;
     str->textlen = 0;
 }
@@ -168,9 +226,3 @@ int sfs_string_set(sfs_string *str, const char* data)
 
     return 0;
 }
-
-
-
-
-
-
@@ -8,23 +8,33 @@
 
 
 
+struct sfs_arena;
+
+#define SFS_STRING_MIN_ALLOC 16
+
 //some string helpers.
 //TODO: maybe it is already implemented somewhere in linux kernel?
+//strings created with sfs_string_create*_in() live in arena and aren't freed one by one
 typedef struct
 {
     char *data;
     size_t textlen;
     size_t memlen;
+    struct sfs_arena *arena;
 } sfs_string;
 
 int sfs_string_create(sfs_string *str, const char *data);
 int sfs_string_createz(sfs_string *str, size_t alloc_len);
+int sfs_string_create_in(sfs_string *str, struct sfs_arena *arena, const char *data);
+int sfs_string_createz_in(sfs_string *str, struct sfs_arena *arena, size_t alloc_len);
 int sfs_string_expandmem(sfs_string *str, size_t new_alloc_len);
+int sfs_string_reserve(sfs_string *str, size_t extra);
 int sfs_string_cat(sfs_string *str, const char* data);
 int sfs_string_insert_begin(sfs_string *str, const char* data);
 int sfs_string_ncat(sfs_string *str, const char* data, size_t len);
 int sfs_string_set(sfs_string *str, const char* data);
-int sfs_string_cat_param(sfs_string *str, const char* fmt, char* param);
+int sfs_string_catf(sfs_string *str, const char* fmt, ...) __printf(2, 3);
+int sfs_string_vcatf(sfs_string *str, const char* fmt, va_list args);
 int sfs_string_clear(sfs_string *str);
 void sfs_string_free(sfs_string *str);
 void sfs_string_bind(sfs_string *str, char *data);
@@ -0,0 +1,175 @@
+#include "surffs_hosts.h"
+#include "surffs_debug.h"
+#include "surffs_sb.h"
+#include <linux/slab.h>
+#include <linux/string.h>
+
+void surffs_hosts_init(struct surffs_hosts *hosts)
+{
+    INIT_LIST_HEAD(&hosts->list);
+    hosts->count = 0;
+    memset(hosts->names, 0, sizeof(hosts->names));
+}
+
+void surffs_hosts_free(struct surffs_hosts *hosts)
+{
+    struct surffs_host *host;
+    struct surffs_host *tmp;
+
+    list_for_each_entry_safe(host, tmp, &hosts->list, hosts)
+    {
+        list_del(&host->hosts);
+        sfs_string_free(&host->name);
+        sfs_string_free(&host->ip);
+        kfree(host);
+    }
+
+    surffs_hosts_init(hosts);
+}
+
+struct surffs_host *surffs_host_find(struct surffs_hosts *hosts, const char *name)
+{
+    struct surffs_host *host;
+
+    list_for_each_entry(host, &hosts->list, hosts)
+        if (strcmp(host->name.data, name) == 0) return host;
+
+    return 0;
+}
+
+int surffs_hosts_add(struct surffs_hosts *hosts, const char *spec, const char *mount_host)
+{
+    int ret = 0;
+    struct surffs_host *host = 0;
+    const char *eq = strchr(spec, '=');
+
+    if (!eq || eq == spec || !eq[1])
+    {
+        sfs_error("error mount surffs: hosts must be given as <name>=<ip>[:<ip>...]\n");
+        ret = -EINVAL;
+        goto out;
+    }
+
+    if (hosts->count == SURFFS_MAX_HOSTS)
+    {
+        sfs_error("error mount surffs: too many hosts, %d at most\n", SURFFS_MAX_HOSTS);
+        ret = -EINVAL;
+        goto out;
+    }
+
+    host = kzalloc(sizeof(struct surffs_host), GFP_KERNEL);
+    if (!host) {ret = -ENOMEM; goto out;}
+
+    ret = sfs_string_createz(&host->name, eq - spec + 1);
+    if (!ret) ret = sfs_string_ncat(&host->name, spec, eq - spec);
+    if (!ret) ret = sfs_string_create(&host->ip, eq + 1);
+    if (ret) goto out;
+
+    if (strcmp(host->name.data, mount_host) == 0 || surffs_host_find(hosts, host->name.data))
+    {
+        sfs_error("error mount surffs: host '%s' is given twice\n", host->name.data);
+        ret = -EINVAL;
+        goto out;
+    }
+
+    surffs_origins_init(&host->origins);
+    ret = surffs_origins_parse(&host->origins, host->ip.data);
+    if (ret) goto out;
+
+    list_add_tail(&host->hosts, &hosts->list);
+    hosts->names[0] = mount_host;
+    hosts->names[++hosts->count] = host->name.data;
+    host = 0;
+
+out:
+    if (host)
+    {
+        sfs_string_free(&host->name);
+        sfs_string_free(&host->ip);
+        kfree(host);
+    }
+
+    return ret;
+}
+
+void surffs_hosts_set_policy(struct surffs_hosts *hosts, enum SURFFS_LB_POLICY policy)
+{
+    struct surffs_host *host;
+
+    list_for_each_entry(host, &hosts->list, hosts)
+        host->origins.policy = policy;
+}
+
+struct surffs_origins *surffs_host_origins(struct surffs_sb_info *fsi, const char *host)
+{
+    struct surffs_host *h;
+
+    if (!fsi->hosts.count || strcmp(host, fsi->root_web_address->host.data) == 0)
+        return &fsi->origins;
+
+    h = surffs_host_find(&fsi->hosts, host);
+
+    return h ? &h->origins : &fsi->origins;
+}
+
+int surffs_webpath(struct surffs_sb_info *fsi, const char *host, const char *path,
+                   sfs_string *buf, const char **webpath)
+{
+    int ret = 0;
+
+    *webpath = path;
+    if (!host[0] || strcmp(host, fsi->root_web_address->host.data) == 0) return 0;
+
+    ret = sfs_string_clear(buf);
+    if (!ret) ret = sfs_string_catf(buf, "//%s%s", host, path);
+    if (!ret) *webpath = buf->data;
+
+    return ret;
+}
+
+const char *surffs_webpath_path(const char *webpath)
+{
+    const char *path;
+
+    if (webpath[0] != '/' || webpath[1] != '/') return webpath;
+
+    path = strchr(webpath + 2, '/');
+
+    return path ? path : "/";
+}
+
+int surffs_webpath_address(struct surffs_sb_info *fsi, sfs_string *webpath,
+                           struct SURFFS_WEB_ADDRESS *address, sfs_string *buf)
+{
+    int ret = 0;
+    struct surffs_host *host = 0;
+    const char *path = surffs_webpath_path(webpath->data);
+    struct surffs_host *h;
+
+    address->ip = fsi->root_web_address->ip;
+    address->port = fsi->root_web_address->port;
+    address->host = fsi->root_web_address->host;
+    address->path = *webpath;
+
+    if (!fsi->hosts.count || path == webpath->data) return 0;
+
+    list_for_each_entry(h, &fsi->hosts.list, hosts)
+    {
+        if (strncmp(webpath->data + 2, h->name.data, h->name.textlen) == 0 &&
+            webpath->data + 2 + h->name.textlen == path)
+        {
+            host = h;
+            break;
+        }
+    }
+    if (!host) return -ENOENT;
+
+    ret = sfs_string_set(buf, path);
+    if (ret) return ret;
+
+    address->ip = host->ip;
+    address->host = host->name;
+    address->path = *buf;
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef _SURFFS_HOSTS_H_
+#define _SURFFS_HOSTS_H_
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/list.h>
+#include "surffs_helpers.h"
+#include "surffs_origin.h"
+#include "surffs_webpages.h"
+
+/*
+ * Multi-host mode: option hosts=<name>=<ip>[:<ip>...] (may be repeated)
+ * lets links to the listed hosts be followed like same-host ones.
+ * Webpath of a page of another host is "//<host><path>", so discovered
+ * paths, redirects and directories keep hosts apart; webpaths of the
+ * mounted host stay "<path>". Every host has its own origins (load
+ * balancing, failover and their counters). Table is filled at mounting
+ * and is read-only afterwards.
+ */
+#define SURFFS_MAX_HOSTS 32
+
+struct surffs_host
+{
+    struct list_head hosts;
+    sfs_string name;
+    sfs_string ip;              /*as given, part of page cache key*/
+    struct surffs_origins origins;
+};
+
+struct surffs_hosts
+{
+    struct list_head list;
+    u32 count;
+    /*mounted host first, then listed ones, NULL-terminated*/
+    const char *names[SURFFS_MAX_HOSTS + 2];
+};
+
+struct surffs_sb_info;
+
+void surffs_hosts_init(struct surffs_hosts *hosts);
+void surffs_hosts_free(struct surffs_hosts *hosts);
+/*spec is "<name>=<ip>[:<ip>...]"*/
+int  surffs_hosts_add(struct surffs_hosts *hosts, const char *spec, const char *mount_host);
+struct surffs_host *surffs_host_find(struct surffs_hosts *hosts, const char *name);
+/*lb= of mount applies to every host*/
+void surffs_hosts_set_policy(struct surffs_hosts *hosts, enum SURFFS_LB_POLICY policy);
+
+/*hosts links may lead to, NULL in single-host mode*/
+static inline const char **surffs_hosts_names(struct surffs_hosts *hosts)
+{
+    return hosts->count ? hosts->names : 0;
+}
+
+/*origins serving host, ones of mount for the mounted host*/
+struct surffs_origins *surffs_host_origins(struct surffs_sb_info *fsi, const char *host);
+
+/*
+ * webpath of path on host: path itself for the mounted host, otherwise
+ * it is built in buf
+ */
+int surffs_webpath(struct surffs_sb_info *fsi, const char *host, const char *path,
+                   sfs_string *buf, const char **webpath);
+
+/*path part of webpath*/
+const char *surffs_webpath_path(const char *webpath);
+
+/*
+ * address of webpath: strings are shared with mount, hosts table and
+ * webpath, path of another host is copied to buf. -ENOENT for unknown host
+ */
+int surffs_webpath_address(struct surffs_sb_info *fsi, sfs_string *webpath,
+                           struct SURFFS_WEB_ADDRESS *address, sfs_string *buf);
+
+#endif
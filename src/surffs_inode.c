@@ -12,7 +12,12 @@
 #include "surffs_webpages.h"
 #include "surffs_sb.h"
 #include "surffs_dentry.h"
-
+#include "surffs_mem.h"
+#include "surffs_trace.h"
+#include "surffs_async.h"
+#include "surffs_lazybody.h"
+#include "surffs_probe.h"
+#include <linux/fsnotify.h>
 
 inline struct SURFFS_INODE_PRIVATE* SURFFS_INODE(struct inode *inode)
 {
@@ -20,28 +25,81 @@ inline struct SURFFS_INODE_PRIVATE* SURFFS_INODE(struct inode *inode)
     return inode->i_private;
 }
 
+inline struct SURFFS_DIR_INODE_PRIVATE* SURFFS_DIR_INODE(struct inode *inode)
+{
+    return container_of(SURFFS_INODE(inode), struct SURFFS_DIR_INODE_PRIVATE, base);
+}
+
+inline struct SURFFS_LINK_INODE_PRIVATE* SURFFS_LINK_INODE(struct inode *inode)
+{
+    return container_of(SURFFS_INODE(inode), struct SURFFS_LINK_INODE_PRIVATE, base);
+}
+
+static struct SURFFS_INODE_PRIVATE* alloc_inode_private(enum SURFFS_INODE_TYPE type)
+{
+    struct SURFFS_DIR_INODE_PRIVATE *dir;
+    struct SURFFS_LINK_INODE_PRIVATE *link;
+    struct SURFFS_INODE_PRIVATE *prvt;
+
+    switch (type)
+    {
+        case INODE_DIR:
+            dir = surffs_cache_zalloc(SFS_CACHE_INODE_DIR);
+            if (dir) init_waitqueue_head(&dir->fetch_wait);
+            prvt = dir ? &dir->base : 0;
+        break;
+
+        case INODE_LINK:
+            link = surffs_cache_zalloc(SFS_CACHE_INODE_LINK);
+            prvt = link ? &link->base : 0;
+        break;
+
+        default:
+            prvt = surffs_cache_zalloc(SFS_CACHE_INODE_FILE);
+        break;
+    }
+
+    if (prvt) prvt->type = type;
+    return prvt;
+}
+
 static void free_inode_private(struct SURFFS_INODE_PRIVATE* prvt)
 {
-    sfs_string_free(&prvt->webPath);
-    sfs_string_free(&prvt->linkto);
+    struct SURFFS_DIR_INODE_PRIVATE *dir;
+    struct SURFFS_LINK_INODE_PRIVATE *link;
+
+    SURFFS_WEB_PAGE_put(prvt->webpage);
+
+    switch (prvt->type)
+    {
+        case INODE_DIR:
+            dir = container_of(prvt, struct SURFFS_DIR_INODE_PRIVATE, base);
+            sfs_string_free(&dir->webPath);
+            surffs_probe_free(dir->probe);
+            surffs_cache_free(SFS_CACHE_INODE_DIR, dir);
+        break;
+
+        case INODE_LINK:
+            link = container_of(prvt, struct SURFFS_LINK_INODE_PRIVATE, base);
+            sfs_string_free(&link->linkto);
+            surffs_cache_free(SFS_CACHE_INODE_LINK, link);
+        break;
+
+        default:
+            surffs_cache_free(SFS_CACHE_INODE_FILE, prvt);
+        break;
+    }
 }
 
 int surffs_create_inode(struct super_block* sb, struct inode *dir,
                                   umode_t mode, unsigned long ino,
-                                  enum SURFFS_INODE_TYPE type, int file_size,
+                                  enum SURFFS_INODE_TYPE type, loff_t file_size,
                                   struct inode **output_inode)
 {
     int ret = 0;
     struct inode* inode = 0;
     struct SURFFS_INODE_PRIVATE* prvt = 0;
 
-    sfs_enter();
-    sfs_debug("surffs_create_inode, mode = %u\n", (unsigned int)mode);
-
-    if (dir)
-        {sfs_debug("dir ino = %lu\n", dir->i_ino);}
-
-
     inode = new_inode(sb);
     if (!inode) {ret = -ENOMEM; goto out;}
 
@@ -74,60 +132,48 @@ int surffs_create_inode(struct super_block* sb, struct inode *dir,
     inode->i_ctime = inode->i_atime = inode->i_mtime = CURRENT_TIME_SEC;
     if (dir) dir->i_mtime = dir->i_ctime = CURRENT_TIME;
 
-    prvt = kzalloc(sizeof(struct SURFFS_INODE_PRIVATE), GFP_KERNEL);
+    prvt = alloc_inode_private(type);
     if (!prvt) {ret = -ENOMEM; goto out;}
 
-    prvt->type = type;
-    ret = sfs_string_createz(&prvt->webPath, 64);
-    if (ret) goto out;
-
-    ret = sfs_string_createz(&prvt->linkto, 64);
-    if (ret) goto out;
-
     inode->i_private = prvt;
 
     insert_inode_hash(inode);
     *output_inode = inode;
 
-    sfs_debug("create inode OK: %ld\n", inode->i_ino);
-
 out:
     if (ret)
     {
-        if (prvt)
+        if (prvt) free_inode_private(prvt);
+        if (inode)
         {
-            free_inode_private(prvt);
-            kfree(prvt);
+            inode->i_private = 0;
+            iput(inode);
         }
-        if (inode) iput(inode);
     }
-    sfs_leave();
+
     return ret;
 }
 
 int surffs_delete_inode(struct inode *inode)
 {
-    sfs_enter();
-    sfs_debug("delete inode ino %ld\n", inode->i_ino);
     if (inode->i_private)
     {
         free_inode_private(SURFFS_INODE(inode));
-        kfree(inode->i_private);
+        inode->i_private = 0;
     }
-    sfs_leave();
+
     return 1;
 }
 
-static int get_webpath_by_dentry_name(struct inode *dir, const char* dentry_name, char **webpath)
+/*relative links lead to host of their page, webpath of another host is built in buf*/
+static int get_webpath_by_dentry_name(struct inode *dir, const char* dentry_name,
+                                      sfs_string *buf, const char **webpath)
 {
     int ret = 0;
     struct SURFFS_WEB_PAGE *webpage = 0;
     struct list_head *pos;
     struct SURFFS_HTML_LINK* link;
-
-    sfs_enter();
-    sfs_debug("get_webpath_by_dentry_name: dir inode ino = %ld; dentry name = '%s'\n",
-                            dir->i_ino, dentry_name);
+    const char *host;
 
     *webpath = 0;
 
@@ -139,17 +185,13 @@ static int get_webpath_by_dentry_name(struct inode *dir, const char* dentry_name
         link = list_entry(pos, struct SURFFS_HTML_LINK, html_links);
         if (strcmp(link->title.data, dentry_name) == 0)
         {
-            sfs_debug("found link, path = '%s'\n", link->path.data);
-            *webpath = link->path.data;
+            host = link->host.textlen ? link->host.data : webpage->address.host.data;
+            ret = surffs_webpath(SURFFS_SB(dir->i_sb), host, link->path.data, buf, webpath);
             goto out;
         }
     }
 
-    sfs_debug("cannot find link with title '%s' on inode %ld\n",
-                               dentry_name, dir->i_ino);
-
 out:
-    sfs_leave();
     return ret;
 }
 
@@ -170,9 +212,11 @@ const surffs_special_file_desc special_files[] =
 
 #define SPECIAL_FILES_COUNT ( (sizeof(special_files) / sizeof(surffs_special_file_desc)) - 1 )
 
-static int get_file_size(enum SURFFS_INODE_TYPE type,
-                         struct SURFFS_WEB_PAGE *webpage)
+static loff_t get_file_size(enum SURFFS_INODE_TYPE type,
+                            struct SURFFS_WEB_PAGE *webpage)
 {
+    if (!webpage) return 0;
+
     switch (type)
     {
         case INODE_FILE_URL:
@@ -182,17 +226,35 @@ static int get_file_size(enum SURFFS_INODE_TYPE type,
             return webpage->status_str.textlen;
 
         case INODE_FILE_PAGE:
-            return (webpage->http_payload) ?
-                webpage->http_resp.textlen - (webpage->http_payload - webpage->http_resp.data)
-                :0;
+            return surffs_page_body_len(webpage);
 
         case INODE_FILE_LOG:
-            return webpage->log.textlen;
+            return 0; /*rendered on open, size is unknown like in /proc*/
 
         default: return 0;
     }
 }
 
+/*url of directory which page is not fetched yet: host and path of its webpath*/
+static int unfetched_dir_url(struct inode *dir, sfs_string *url)
+{
+    int ret = 0;
+    struct SURFFS_WEB_ADDRESS address;
+    sfs_string buf = {0};
+
+    ret = surffs_webpath_address(SURFFS_SB(dir->i_sb), &SURFFS_DIR_INODE(dir)->webPath,
+                                 &address, &buf);
+    if (ret) goto out;
+
+    ret = sfs_string_catf(url, "%s%s", address.host.data, address.path.data);
+    if (ret) goto out;
+
+out:
+    sfs_string_free(&buf);
+
+    return ret;
+}
+
 static struct dentry *surffs_lookup_special_file(struct inode *dir,
                                                  struct dentry *dentry,
                                                  surffs_special_file_desc desc)
@@ -201,23 +263,41 @@ static struct dentry *surffs_lookup_special_file(struct inode *dir,
     struct inode *inode;
     struct super_block *sb = dentry->d_sb;
     struct SURFFS_WEB_PAGE *webpage;
-
-    sfs_enter();
-    sfs_info("surffs_lookup_special_file - %s\n", desc.filename);
+    struct surffs_head_probe *probe;
+    sfs_string url = {0};
+    loff_t size;
 
     webpage = SURFFS_INODE(dir)->webpage;
+    probe = SURFFS_DIR_INODE(dir)->probe;
+    size = get_file_size(desc.type, webpage);
+    if (!webpage && desc.type == INODE_FILE_URL)
+    {
+        ret = sfs_string_createz(&url, 64);
+        if (!ret) ret = unfetched_dir_url(dir, &url);
+        if (ret) goto out;
+        size = url.textlen;
+    }
+    else if (!webpage && probe && desc.type == INODE_FILE_PAGE)
+    {
+        size = surffs_probe_page_size(probe);
+    }
+    else if (!webpage && probe && desc.type == INODE_FILE_STATUS)
+    {
+        size = strlen(surffs_probe_status(probe));
+    }
+
     ret = surffs_create_inode(sb, dir, SURFFS_FILES_ACCESS_MODE | S_IFREG,
                               iunique(sb, SURFFS_ROOT_INO),
                               desc.type,
-                              get_file_size(desc.type, webpage),
+                              size,
                               &inode);
     if (ret) goto out;
+    if (webpage) SURFFS_WEB_PAGE_get(webpage);
     SURFFS_INODE(inode)->webpage = webpage;
 
-    sfs_debug("lookup result: inode ino %ld\n", inode->i_ino);
-
 out:
-    sfs_leave();
+    sfs_string_free(&url);
+
     return ret ? ERR_PTR(ret) : d_splice_alias(inode, dentry);
 }
 
@@ -226,14 +306,13 @@ static struct dentry *surffs_lookup_subdir(struct inode *dir, struct dentry *den
     int ret = 0;
     struct inode *inode = 0;
     struct super_block *sb = dentry->d_sb;
-    char* webpath = 0;
+    const char *webpath = 0;
+    sfs_string webpath_buf = {0};
     sfs_string dentry_path = {0};
     char *discovered_path = 0;
+    sfs_string *target;
 
-    sfs_enter();
-    sfs_info("surffs_lookup_dir - '%s'\n", dentry->d_name.name);
-
-    ret = get_webpath_by_dentry_name(dir, dentry->d_name.name, &webpath);
+    ret = get_webpath_by_dentry_name(dir, dentry->d_name.name, &webpath_buf, &webpath);
     if (ret) goto out;
     if (!webpath) goto out;
 
@@ -243,30 +322,28 @@ static struct dentry *surffs_lookup_subdir(struct inode *dir, struct dentry *den
     ret = get_relative_dentry_path(dentry, &dentry_path);
     if (ret) goto out;
 
+    /*link to a known redirect leads to directory of its target*/
+    target = surffs_redirect_find(&SURFFS_SB(sb)->redirects, webpath);
+    if (target) webpath = target->data;
+
     discovered_path = find_discovered_path(sb, webpath);
 
     if (discovered_path)
     {
-        sfs_debug("webpath '%s' was already discovered at dentry '%s' => "
-                  "make symlink instead of directrory\n"
-                  ,webpath, discovered_path);
-
         ret = surffs_create_inode(sb, dir, SURFFS_FILES_ACCESS_MODE | S_IFLNK,
                                     iunique(sb, SURFFS_ROOT_INO), INODE_LINK,
                                     0,
                                     &inode);
         if (ret) goto out;
 
-        ret = sfs_string_clear(&SURFFS_INODE(inode)->linkto);
+        ret = sfs_string_createz(&SURFFS_LINK_INODE(inode)->linkto, 64);
         if (ret) goto out;
 
-
         ret = get_relative_path_to_surffs_root(dentry->d_parent,
-                                               &SURFFS_INODE(inode)->linkto);
+                                               &SURFFS_LINK_INODE(inode)->linkto);
         if (ret) goto out;
 
-
-        ret = sfs_string_cat(&SURFFS_INODE(inode)->linkto, discovered_path);
+        ret = sfs_string_cat(&SURFFS_LINK_INODE(inode)->linkto, discovered_path);
         if (ret) goto out;
     }
     else
@@ -277,73 +354,247 @@ static struct dentry *surffs_lookup_subdir(struct inode *dir, struct dentry *den
                                     &inode);
         if (ret) goto out;
 
-        ret = sfs_string_set(&SURFFS_INODE(inode)->webPath, webpath);
+        ret = sfs_string_create(&SURFFS_DIR_INODE(inode)->webPath, webpath);
         if (ret) goto out;
 
         ret = add_discovered_path(sb, webpath, dentry_path.data);
         if (ret) goto out;
     }
 
-    sfs_debug("lookup result: inode ino %ld, webpath = '%s'\n",
-              inode->i_ino, webpath);
+out:
+    sfs_string_free(&dentry_path);
+    sfs_string_free(&webpath_buf);
+
+    return ret ? ERR_PTR(ret) : d_splice_alias(inode, dentry);
+}
+
+/*directory of redirected page also stands for the target path*/
+static int add_redirect_target(struct inode *inode, const char *target)
+{
+    int ret = 0;
+    struct dentry *dentry;
+    sfs_string dentry_path = {0};
+
+    if (find_discovered_path(inode->i_sb, target)) goto out;
+
+    dentry = d_find_alias(inode);
+    if (!dentry) goto out;
+
+    ret = sfs_string_createz(&dentry_path, 256);
+    if (!ret) ret = get_relative_dentry_path(dentry, &dentry_path);
+    if (!ret) ret = add_discovered_path(inode->i_sb, target, dentry_path.data);
 
+    dput(dentry);
 
 out:
     sfs_string_free(&dentry_path);
-    sfs_leave();
-    return ret ? ERR_PTR(ret) : d_splice_alias(inode, dentry);
+
+    return ret;
 }
 
-static int obtain_inode_webpage(struct inode* inode)
+int surffs_fetch_dir_webpage(struct inode *inode, struct SURFFS_WEB_PAGE **webpage)
 {
     int ret = 0;
-    struct SURFFS_WEB_PAGE* webpage;
     struct SURFFS_WEB_ADDRESS webaddr;
+    sfs_string path_buf = {0};
 
-    sfs_enter();
-    sfs_debug("obtain_inode_webpage, inode ino %ld, webpath = '%s'\n",
-              inode->i_ino, SURFFS_INODE(inode)->webPath.data);
-
-    if (!SURFFS_INODE(inode)->webPath.textlen)
+    if (SURFFS_INODE(inode)->type != INODE_DIR ||
+        !SURFFS_DIR_INODE(inode)->webPath.textlen)
     {
         sfs_error("obtain_inode_webpage error: no webpath at dir inode\n");
         ret = -EINVAL;
         goto out;
     }
 
-    webaddr.ip = SURFFS_SB(inode->i_sb)->root_web_address->ip;
-    webaddr.host = SURFFS_SB(inode->i_sb)->root_web_address->host;
-    webaddr.path = SURFFS_INODE(inode)->webPath;
+    ret = surffs_webpath_address(SURFFS_SB(inode->i_sb), &SURFFS_DIR_INODE(inode)->webPath,
+                                 &webaddr, &path_buf);
+    if (ret) goto out;
+
+    ret = get_webpage(SURFFS_SB(inode->i_sb), webaddr, webpage);
+
+out:
+    sfs_string_free(&path_buf);
+
+    return ret;
+}
+
+int surffs_attach_dir_webpage(struct inode *inode, struct SURFFS_WEB_PAGE *webpage)
+{
+    int ret = 0;
+    sfs_string target_buf = {0};
+    const char *target;
+
+    /*page of redirected path has path of target*/
+    if (strcmp(surffs_webpath_path(SURFFS_DIR_INODE(inode)->webPath.data),
+               webpage->address.path.data) != 0)
+    {
+        ret = surffs_webpath(SURFFS_SB(inode->i_sb), webpage->address.host.data,
+                             webpage->address.path.data, &target_buf, &target);
+        if (!ret) ret = add_redirect_target(inode, target);
+        if (ret)
+        {
+            SURFFS_WEB_PAGE_put(webpage);
+            goto out;
+        }
+    }
+
+    /*inode keeps reference got from get_webpage*/
+    if (SURFFS_INODE(inode)->webpage)
+        SURFFS_WEB_PAGE_put(webpage);
+    else
+        SURFFS_INODE(inode)->webpage = webpage;
+
+out:
+    sfs_string_free(&target_buf);
+
+    return ret;
+}
+
+/*special file of directory shows refreshed page from now*/
+static void replace_file_webpage(struct dentry *dir_dentry, const surffs_special_file_desc *desc,
+                                 struct SURFFS_WEB_PAGE *fresh)
+{
+    struct qstr name = QSTR_INIT(desc->filename, strlen(desc->filename));
+    struct dentry *dentry;
+    struct inode *inode;
+    struct SURFFS_WEB_PAGE *old;
+
+    dentry = d_hash_and_lookup(dir_dentry, &name);
+    if (IS_ERR_OR_NULL(dentry)) return;
+
+    inode = dentry->d_inode;
+    if (inode)
+    {
+        SURFFS_WEB_PAGE_get(fresh);
+        spin_lock(&inode->i_lock);
+        old = SURFFS_INODE(inode)->webpage;
+        SURFFS_INODE(inode)->webpage = fresh;
+        i_size_write(inode, get_file_size(desc->type, fresh));
+        inode->i_mtime = inode->i_ctime = CURRENT_TIME;
+        spin_unlock(&inode->i_lock);
+        SURFFS_WEB_PAGE_put(old);
+
+        if (desc->type == INODE_FILE_PAGE)
+            fsnotify(inode, FS_MODIFY, inode, FSNOTIFY_EVENT_INODE, NULL, 0);
+    }
+
+    dput(dentry);
+}
+
+static int has_same_link(struct SURFFS_WEB_PAGE *page, struct SURFFS_HTML_LINK *link)
+{
+    struct SURFFS_HTML_LINK *l;
+
+    list_for_each_entry(l, &page->html_links, html_links)
+    {
+        if (strcmp(l->title.data, link->title.data) == 0 &&
+            strcmp(l->host.data, link->host.data) == 0 &&
+            strcmp(l->path.data, link->path.data) == 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * links gone from page are reported deleted, new ones created; dentries
+ * of gone links stay, so paths discovered through them still work
+ */
+static void notify_links(struct inode *dir, struct SURFFS_WEB_PAGE *old,
+                         struct SURFFS_WEB_PAGE *fresh)
+{
+    struct SURFFS_HTML_LINK *link;
 
-    ret = get_webpage(webaddr, &webpage);
+    list_for_each_entry(link, &old->html_links, html_links)
+        if (!has_same_link(fresh, link))
+            fsnotify(dir, FS_DELETE | FS_ISDIR, dir, FSNOTIFY_EVENT_INODE,
+                     link->title.data, 0);
+
+    list_for_each_entry(link, &fresh->html_links, html_links)
+        if (!has_same_link(old, link))
+            fsnotify(dir, FS_CREATE | FS_ISDIR, dir, FSNOTIFY_EVENT_INODE,
+                     link->title.data, 0);
+}
+
+void surffs_dir_replace_webpage(struct dentry *dentry, struct SURFFS_WEB_PAGE *fresh)
+{
+    struct inode *dir = dentry->d_inode;
+    struct SURFFS_WEB_PAGE *old;
+    const surffs_special_file_desc *i;
+
+    SURFFS_WEB_PAGE_get(fresh);
+    spin_lock(&dir->i_lock);
+    old = SURFFS_INODE(dir)->webpage;
+    SURFFS_INODE(dir)->webpage = fresh;
+    spin_unlock(&dir->i_lock);
+    dir->i_mtime = dir->i_ctime = CURRENT_TIME;
+
+    for (i = special_files; i->filename; i++)
+        replace_file_webpage(dentry, i, fresh);
+
+    /*watch of directory hears about page.html even if it was never looked up*/
+    fsnotify(dir, FS_MODIFY | FS_EVENT_ON_CHILD, dir, FSNOTIFY_EVENT_INODE,
+             "page.html", 0);
+
+    /*old page keeps titles of its links until events are sent*/
+    if (old)
+    {
+        notify_links(dir, old, fresh);
+        SURFFS_WEB_PAGE_put(old);
+    }
+}
+
+static int obtain_inode_webpage(struct inode* inode)
+{
+    int ret = 0;
+    struct SURFFS_WEB_PAGE* webpage;
+
+    ret = surffs_fetch_dir_webpage(inode, &webpage);
     if (ret) goto out;
 
-    SURFFS_INODE(inode)->webpage = webpage;
-    sfs_debug("set webpage to inode %ld: '%s%s'\n",
-              inode->i_ino,
-              webpage->address.host.data,
-              webpage->address.path.data);
+    ret = surffs_attach_dir_webpage(inode, webpage);
 
 out:
-    sfs_leave();
     return ret;
 }
 
+/*
+ * url is known without page, status file can be polled before page of
+ * directory is fetched, page.html and status may be answered by HEAD
+ */
+static int lookup_needs_page(struct inode *dir, enum SURFFS_INODE_TYPE type)
+{
+    struct surffs_sb_info *fsi = SURFFS_SB(dir->i_sb);
+    struct surffs_head_probe *probe;
+
+    if (type == INODE_FILE_URL) return 0;
+    if (type == INODE_FILE_STATUS && fsi->nonblock) return 0;
+    if ((type == INODE_FILE_STATUS || type == INODE_FILE_PAGE) && fsi->head_probe)
+        return surffs_probe_dir(dir, &probe) != 0;
+
+    return 1;
+}
+
 struct dentry *surffs_lookup(struct inode *dir, struct dentry *dentry,
                    unsigned int flags)
 {
     const surffs_special_file_desc *i;
     int ret = 0;
 
-    if (!SURFFS_INODE(dir)->webpage)
+    trace_surffs_lookup(dir->i_ino, dentry->d_name.name);
+
+    for (i = special_files; i->filename; i++)
+        if (strcmp(dentry->d_name.name, i->filename) == 0)
+            break;
+
+    if (!SURFFS_INODE(dir)->webpage && lookup_needs_page(dir, i->type))
     {
         ret = obtain_inode_webpage(dir);
         if (ret) return ERR_PTR(ret);
     }
 
-    for (i = special_files; i->filename; i++)
-        if (strcmp(dentry->d_name.name, i->filename) == 0)
-            return surffs_lookup_special_file(dir, dentry, *i);
+    if (i->filename)
+        return surffs_lookup_special_file(dir, dentry, *i);
 
     return surffs_lookup_subdir(dir, dentry);
 }
@@ -356,9 +607,6 @@ static int emit_special_files(struct file *file, struct dir_context *ctx, loff_t
     int n;
     loff_t expected_pos;
 
-    sfs_enter();
-    sfs_debug("emit_special_files, expected start pos = %d\n", (int)expected_start_pos);
-
     if (ctx->pos < expected_start_pos)
     {
         sfs_error("emit_special_files position error\n");
@@ -369,12 +617,9 @@ static int emit_special_files(struct file *file, struct dir_context *ctx, loff_t
     for (i = special_files, n = 0; i->filename; i++, n++)
     {
         expected_pos = expected_start_pos + (loff_t)n;
-        sfs_debug("expected_pos: %d, fact pos: %d\n",
-                  (int)expected_pos, (int)ctx->pos);
 
         if (expected_pos == ctx->pos)
         {
-            sfs_debug("emit '%s'\n", i->filename);
             ret = ctx->actor(ctx,
                             i->filename,
                             strlen(i->filename),
@@ -387,7 +632,6 @@ static int emit_special_files(struct file *file, struct dir_context *ctx, loff_t
     }
 
 out:
-    sfs_leave();
     return ret;
 }
 
@@ -401,9 +645,6 @@ static int emit_dirs(struct file *file, struct dir_context *ctx, loff_t expected
     loff_t expected_pos;
     int i;
 
-    sfs_enter();
-    sfs_debug("emit_dirs, expected start pos = %d\n", (int)expected_start_pos);
-
     if (ctx->pos < expected_start_pos)
     {
         sfs_error("emit_dirs position error\n");
@@ -414,24 +655,15 @@ static int emit_dirs(struct file *file, struct dir_context *ctx, loff_t expected
     webpage = SURFFS_INODE(file->f_inode)->webpage;
     if (!webpage) {ret = -EINVAL; goto out;}
 
-    sfs_debug("webpage for dentry '%s': '%s%s'\n",
-              file->f_path.dentry->d_name.name,
-              webpage->address.host.data,
-              webpage->address.path.data);
-
     i = 0;
     list_for_each(pos, &webpage->html_links)
     {
         expected_pos = expected_start_pos + (loff_t)i;
-        sfs_debug("expected_pos: %d, fact pos: %d\n",
-                  (int)expected_pos, (int)ctx->pos);
 
         if (expected_pos == ctx->pos)
         {
             link = list_entry(pos, struct SURFFS_HTML_LINK, html_links);
 
-            sfs_debug("emit '%s'\n", link->title.data);
-
             ret = ctx->actor(ctx,
                             link->title.data,
                             link->title.textlen,
@@ -446,7 +678,6 @@ static int emit_dirs(struct file *file, struct dir_context *ctx, loff_t expected
     }
 
 out:
-    sfs_leave();
     return ret;
 }
 
@@ -454,17 +685,17 @@ int surffs_readdir(struct file *file, struct dir_context *ctx)
 {
     int ret = 0;
 
-    sfs_enter();
-    sfs_info("surffs_readdir: '%s'\n", file->f_path.dentry->d_name.name);
+    trace_surffs_readdir(file->f_inode->i_ino, ctx->pos);
 
     if (!SURFFS_INODE(file->f_inode)->webpage)
     {
-        ret = obtain_inode_webpage(file->f_inode);
+        if (surffs_async_wanted(file))
+            ret = surffs_async_fetch_dir(file->f_inode);
+        else
+            ret = obtain_inode_webpage(file->f_inode);
         if (ret) goto out;
     }
 
-    sfs_debug("pos before = %d\n", (int)ctx->pos);
-
     if (!dir_emit_dots(file, ctx)) {ret = -EINVAL; goto out;}
 
     ret = emit_special_files(file, ctx, 2);
@@ -473,17 +704,199 @@ int surffs_readdir(struct file *file, struct dir_context *ctx)
     ret = emit_dirs(file, ctx, 2 + SPECIAL_FILES_COUNT);
     if (ret) goto out;
 
-    sfs_debug("pos after = %d\n", (int)ctx->pos);
+out:
+    return ret;
+}
+
+/*non-blocking open of directory which page is not fetched yet starts fetching*/
+int surffs_dir_open(struct inode *inode, struct file *file)
+{
+    if (SURFFS_INODE(inode)->webpage || !surffs_async_wanted(file)) return 0;
+
+    return surffs_async_fetch_dir(inode);
+}
+
+/*referenced page of file, refresh may replace it any time*/
+static struct SURFFS_WEB_PAGE *file_webpage_get(struct inode *inode)
+{
+    struct SURFFS_WEB_PAGE *webpage;
+
+    spin_lock(&inode->i_lock);
+    webpage = SURFFS_INODE(inode)->webpage;
+    if (webpage) SURFFS_WEB_PAGE_get(webpage);
+    spin_unlock(&inode->i_lock);
+
+    return webpage;
+}
+
+/*status or page.html of directory looked up before page of directory was fetched*/
+static int file_dir_webpage(struct file *file)
+{
+    int ret = 0;
+    struct inode *inode = file->f_inode;
+    struct inode *dir = file->f_path.dentry->d_parent->d_inode;
+    struct SURFFS_WEB_PAGE *webpage;
+
+    if (SURFFS_INODE(inode)->type == INODE_FILE_STATUS)
+    {
+        while (!SURFFS_INODE(dir)->webpage)
+        {
+            ret = surffs_async_fetch_dir(dir);
+            if (ret == -EAGAIN && !(file->f_flags & O_NONBLOCK))
+                ret = surffs_async_wait(dir);
+            if (ret) goto out;
+        }
+    }
+    else
+    {
+        mutex_lock(&dir->i_mutex);
+        if (!SURFFS_INODE(dir)->webpage) ret = obtain_inode_webpage(dir);
+        mutex_unlock(&dir->i_mutex);
+        if (ret) goto out;
+    }
+
+    /*refresh may replace page of directory*/
+    spin_lock(&dir->i_lock);
+    webpage = SURFFS_INODE(dir)->webpage;
+    SURFFS_WEB_PAGE_get(webpage);
+    spin_unlock(&dir->i_lock);
+
+    spin_lock(&inode->i_lock);
+    if (!SURFFS_INODE(inode)->webpage)
+    {
+        SURFFS_INODE(inode)->webpage = webpage;
+        i_size_write(inode, get_file_size(SURFFS_INODE(inode)->type, webpage));
+        webpage = 0;
+    }
+    spin_unlock(&inode->i_lock);
+
+    SURFFS_WEB_PAGE_put(webpage);
+
+out:
+    return ret;
+}
+
+unsigned int surffs_file_poll(struct file *file, poll_table *wait)
+{
+    struct inode *inode = file->f_inode;
+
+    if (SURFFS_INODE(inode)->type != INODE_FILE_STATUS || SURFFS_INODE(inode)->webpage ||
+        file->private_data)
+        return DEFAULT_POLLMASK;
+
+    return surffs_async_poll(file->f_path.dentry->d_parent->d_inode, file, wait);
+}
+
+/*
+ * loading.log text is rendered from page events for every opened file,
+ * url of page not fetched yet from webpath of directory
+ */
+int surffs_file_open(struct inode *inode, struct file *file)
+{
+    int ret = 0;
+    sfs_string *text = 0;
+    struct SURFFS_WEB_PAGE *webpage = file_webpage_get(inode);
+    struct SURFFS_WEB_PAGE *dir_webpage = 0;
+    struct inode *dir = file->f_path.dentry->d_parent->d_inode;
+    struct surffs_head_probe *probe = SURFFS_DIR_INODE(dir)->probe;
+
+    file->private_data = 0;
+    if (webpage) webpage->last_access = jiffies;
+
+    /*status is told by HEAD probe until page of directory is fetched*/
+    if (!webpage && SURFFS_INODE(inode)->type == INODE_FILE_STATUS &&
+        probe && !SURFFS_INODE(dir)->webpage)
+    {
+        text = kzalloc(sizeof(sfs_string), GFP_KERNEL);
+        if (!text) {ret = -ENOMEM; goto out;}
+
+        ret = sfs_string_create(text, surffs_probe_status(probe));
+        if (ret) goto out;
+
+        file->private_data = text;
+        goto out;
+    }
+
+    /*non-blocking open of status starts fetching page, reading waits for it*/
+    if (!webpage && SURFFS_INODE(inode)->type == INODE_FILE_STATUS)
+    {
+        if (file->f_flags & O_NONBLOCK)
+        {
+            ret = surffs_async_fetch_dir(dir);
+            if (ret == -EAGAIN) ret = 0;
+        }
+        goto out;
+    }
+
+    /*url looked up before page of directory: fetched page, if any, tells final url*/
+    if (!webpage && SURFFS_INODE(inode)->type == INODE_FILE_URL)
+    {
+        text = kzalloc(sizeof(sfs_string), GFP_KERNEL);
+        if (!text) {ret = -ENOMEM; goto out;}
+
+        dir_webpage = file_webpage_get(dir);
+        ret = sfs_string_createz(text, 64);
+        if (!ret && dir_webpage) ret = sfs_string_cat(text, dir_webpage->full_url.data);
+        else if (!ret) ret = unfetched_dir_url(dir, text);
+        if (ret) goto out;
+
+        file->private_data = text;
+        goto out;
+    }
+
+    if (SURFFS_INODE(inode)->type != INODE_FILE_LOG) goto out;
+    if (!webpage) {ret = -EINVAL; goto out;}
+
+    text = kzalloc(sizeof(sfs_string), GFP_KERNEL);
+    if (!text) {ret = -ENOMEM; goto out;}
+
+    ret = sfs_event_log_render(webpage, text);
+    if (ret) goto out;
+
+    file->private_data = text;
 
 out:
-    sfs_leave();
+    if (ret && text)
+    {
+        sfs_string_free(text);
+        kfree(text);
+    }
+    SURFFS_WEB_PAGE_put(webpage);
+    SURFFS_WEB_PAGE_put(dir_webpage);
+
     return ret;
 }
 
-static int define_reading_source(struct SURFFS_WEB_PAGE *webpage,
+int surffs_file_release(struct inode *inode, struct file *file)
+{
+    sfs_string *text = file->private_data;
+
+    if (text)
+    {
+        sfs_string_free(text);
+        kfree(text);
+        file->private_data = 0;
+    }
+
+    return 0;
+}
+
+static int define_reading_source(struct file *file,
+                                 struct SURFFS_WEB_PAGE *webpage,
                                  enum SURFFS_INODE_TYPE filetype,
                                  void **source, size_t *source_len)
 {
+    sfs_string *text;
+
+    /*url and status rendered on open*/
+    if ((filetype == INODE_FILE_URL || filetype == INODE_FILE_STATUS) && file->private_data)
+    {
+        text = file->private_data;
+        *source = text->data;
+        *source_len = text->textlen;
+        return 0;
+    }
+
     if (!webpage) return -EINVAL;
 
     switch (filetype)
@@ -494,15 +907,17 @@ static int define_reading_source(struct SURFFS_WEB_PAGE *webpage,
         break;
 
         case INODE_FILE_LOG:
-            *source = webpage->log.data;
-            *source_len = webpage->log.textlen;
+            text = file->private_data;
+            if (!text) return -EINVAL;
+            *source = text->data;
+            *source_len = text->textlen;
         break;
 
         case INODE_FILE_PAGE:
             if (webpage->http_payload)
             {
                 *source = webpage->http_payload;
-                *source_len = strlen(webpage->http_payload);
+                *source_len = get_file_size(filetype, webpage);
             }
             else
             {
@@ -535,17 +950,36 @@ ssize_t surffs_aio_read(struct kiocb *iocb, const struct iovec *vec,
     void *start, *end;
     size_t read_len;
     size_t uncopyed_bytes;
+    ssize_t lazy_read;
     struct inode* inode = iocb->ki_filp->f_inode;
+    struct SURFFS_WEB_PAGE *webpage = 0;
+
+    /*page.html looked up by HEAD probe is fetched when it is read*/
+    if (!SURFFS_INODE(inode)->webpage && !iocb->ki_filp->private_data &&
+        (SURFFS_INODE(inode)->type == INODE_FILE_STATUS ||
+         SURFFS_INODE(inode)->type == INODE_FILE_PAGE))
+    {
+        ret = file_dir_webpage(iocb->ki_filp);
+        if (ret) goto out;
+    }
 
-    sfs_enter();
-    sfs_debug("surffs_aio_read, requested_len = %lu, pos before reading = %lu\n",
-           (unsigned long)requested_len, (unsigned long)iocb->ki_pos);
+    webpage = file_webpage_get(inode);
+    if (webpage && webpage->lazy && SURFFS_INODE(inode)->type == INODE_FILE_PAGE)
+    {
+        lazy_read = surffs_lazy_body_read(SURFFS_SB(inode->i_sb), webpage, vec->iov_base,
+                                          requested_len, iocb->ki_pos);
+        if (lazy_read < 0) {ret = lazy_read; goto out;}
+        read_len = lazy_read;
+        iocb->ki_pos += (loff_t)read_len;
+        goto out;
+    }
 
-    ret = define_reading_source(SURFFS_INODE(inode)->webpage,
+    ret = define_reading_source(iocb->ki_filp,
+                                webpage,
                                 SURFFS_INODE(inode)->type,
                                 &source, &source_len);
     if (ret) goto out;
-    if (!source) return 0;
+    if (!source) {read_len = 0; goto out;}
 
     if (requested_pos > source_len) {ret = -EINVAL; goto out;}
 
@@ -563,11 +997,9 @@ ssize_t surffs_aio_read(struct kiocb *iocb, const struct iovec *vec,
 
     iocb->ki_pos += (loff_t)read_len;
 
-    sfs_debug("my_aio_read OK, read_len = %lu. iocb->ki_pos after reading = %lu\n",
-                (unsigned long)read_len, (unsigned long)iocb->ki_pos);
-
 out:
-    sfs_leave();
+    SURFFS_WEB_PAGE_put(webpage);
+
     return ret ? ret : read_len;
 }
 
@@ -576,9 +1008,6 @@ void *surffs_follow_link(struct dentry *dentry, struct nameidata *nd)
     int ret = 0;
     struct inode *inode;
 
-    sfs_enter();
-    sfs_debug("surffs_follow_link for dentry '%s'\n", dentry->d_name.name);
-
     inode = dentry->d_inode;
     if (!inode)
     {
@@ -587,11 +1016,9 @@ void *surffs_follow_link(struct dentry *dentry, struct nameidata *nd)
         goto out;
     }
 
-    sfs_debug("link = '%s'\n", SURFFS_INODE(inode)->linkto.data);
-    nd_set_link(nd, SURFFS_INODE(inode)->linkto.data);
+    nd_set_link(nd, SURFFS_LINK_INODE(inode)->linkto.data);
 
 out:
-    sfs_leave();
     return ret ? ERR_PTR(ret) : NULL;
 }
 
@@ -7,9 +7,13 @@
 #include <linux/vfs.h>
 #include <linux/slab.h>
 #include <linux/dcache.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
 #include "surffs_webpages.h"
 #include "surffs_helpers.h"
 
+struct surffs_head_probe;
+
 enum SURFFS_INODE_TYPE
 {
     INODE_UNKNOWN = 0,
@@ -21,18 +25,44 @@ enum SURFFS_INODE_TYPE
     INODE_DIR
 };
 
+/*private part of regular file inodes, also the head of dir and link ones*/
 struct SURFFS_INODE_PRIVATE
 {
-    sfs_string webPath;
     struct SURFFS_WEB_PAGE *webpage;
     enum SURFFS_INODE_TYPE type;
+};
+
+/*fetch of page of directory started by non-blocking access (mount option nonblock)*/
+enum SURFFS_DIR_FETCH_STATE
+{
+    SFS_DIR_FETCH_IDLE = 0,     /*page is there or nobody asked for it yet*/
+    SFS_DIR_FETCH_RUNNING,
+    SFS_DIR_FETCH_FAILED        /*fetch_error is reported by the next access*/
+};
+
+struct SURFFS_DIR_INODE_PRIVATE
+{
+    struct SURFFS_INODE_PRIVATE base;
+    sfs_string webPath;
+
+    /*under i_lock*/
+    enum SURFFS_DIR_FETCH_STATE fetch_state;
+    int fetch_error;
+    wait_queue_head_t fetch_wait;   /*woken when fetch ends, status file polls it*/
+
+    struct surffs_head_probe *probe;  /*HEAD response, set under i_mutex*/
+};
+
+struct SURFFS_LINK_INODE_PRIVATE
+{
+    struct SURFFS_INODE_PRIVATE base;
     sfs_string linkto;
 };
 
 int surffs_create_inode(struct super_block* sb, struct inode *dir,
                                   umode_t mode, unsigned long ino,
                                   enum SURFFS_INODE_TYPE type,
-                                  int file_size,
+                                  loff_t file_size,
                                   struct inode **output_inode);
 
 int surffs_delete_inode(struct inode *inode);
@@ -42,10 +72,31 @@ struct dentry *surffs_lookup(struct inode *dir, struct dentry *dentry,
 
 int surffs_readdir(struct file *file, struct dir_context *ctx);
 
+int surffs_dir_open(struct inode *inode, struct file *file);
+
+/*page of directory by its webpath, does not touch inode*/
+int surffs_fetch_dir_webpage(struct inode *inode, struct SURFFS_WEB_PAGE **webpage);
+/*gives fetched page to directory (takes the reference), called under i_mutex*/
+int surffs_attach_dir_webpage(struct inode *inode, struct SURFFS_WEB_PAGE *webpage);
+
+/*
+ * refreshed page replaces page of directory and of its special files,
+ * fsnotify reports changes; called under i_mutex
+ */
+void surffs_dir_replace_webpage(struct dentry *dentry, struct SURFFS_WEB_PAGE *fresh);
+
+int surffs_file_open(struct inode *inode, struct file *file);
+
+int surffs_file_release(struct inode *inode, struct file *file);
+
+unsigned int surffs_file_poll(struct file *file, poll_table *wait);
+
 ssize_t surffs_aio_read(struct kiocb *iocb, const struct iovec *vec, unsigned long segs, loff_t loff);
 
 void *surffs_follow_link(struct dentry *dentry, struct nameidata *nd);
 
 inline struct SURFFS_INODE_PRIVATE* SURFFS_INODE(struct inode *inode);
+inline struct SURFFS_DIR_INODE_PRIVATE* SURFFS_DIR_INODE(struct inode *inode);
+inline struct SURFFS_LINK_INODE_PRIVATE* SURFFS_LINK_INODE(struct inode *inode);
 
 #endif
@@ -3,205 +3,355 @@
 #include "surffs_debug.h"
 #include <linux/slab.h>
 #include <linux/netpoll.h>
-#include "surffs_socket.h"
+#include "surffs_fetch.h"
 #include "surffs_helpers.h"
 #include <linux/list.h>
 #include "surffs_parser.h"
 #include "surffs.h"
+#include "surffs_trace.h"
+#include "surffs_sb.h"
+#include "surffs_stats.h"
+#include "surffs_redirect.h"
+#include "surffs_socket.h"
+#include "surffs_diskcache.h"
+#include "surffs_hosts.h"
+#include "surffs_lazybody.h"
 
-char* supported_protocols[] = {"http", 0};
-
-int is_valid_protocol(char *protocol)
+/*appends path of "/"-started path..end to out, "." and ".." segments are dropped*/
+static int remove_dot_segments(const char *path, const char *end, sfs_string *out)
 {
-    char **i;
+    int ret = 0;
+    const char *seg;
+    const char *seg_end;
+    char *slash;
 
-    if (!protocol[0])
-        return 1;
+    for (seg = path + 1; seg <= end; seg = seg_end + 1)
+    {
+        seg_end = memchr(seg, '/', end - seg);
+        if (!seg_end) seg_end = end;
 
-    for (i = supported_protocols; *i; i++)
-        if (strcmp(protocol, *i) == 0)
-            return 1;
+        if (seg_end - seg == 2 && seg[0] == '.' && seg[1] == '.')
+        {
+            slash = strrchr(out->data, '/');
+            if (slash)
+            {
+                *slash = 0;
+                out->textlen = slash - out->data;
+            }
+        }
+        else if (seg_end - seg != 1 || seg[0] != '.')
+        {
+            ret = sfs_string_ncat(out, seg - 1, seg_end - seg + 1);
+            if (ret) goto out;
+            continue;
+        }
+
+        /*"a/.." and "a/." stand for directory*/
+        if (seg_end == end) ret = sfs_string_cat(out, "/");
+        if (ret) goto out;
+    }
 
-    return 0;
+    if (!out->textlen) ret = sfs_string_cat(out, "/");
+
+out:
+    return ret;
 }
 
-int check_html_link(struct SURFFS_HTML_LINK *link,
-                    struct SURFFS_WEB_ADDRESS parent_addr,
-                    sfs_string *log,
-                    int *ok)
+/*
+ * path of relative Location ("b", "../b", "?q=1") of response to request
+ * of request_path: it is taken from directory of request_path
+ */
+static int resolve_location(const char *request_path, const char *location,
+                            sfs_string *path)
 {
     int ret = 0;
+    sfs_string joined = {0};
+    const char *end;
 
-    sfs_enter();
-    sfs_debug("check_html_link\n");
+    ret = sfs_string_clear(path);
+    if (!ret) ret = sfs_string_createz(&joined, strlen(request_path) + strlen(location) + 2);
+    if (ret) goto out;
 
-    *ok = 0;
+    end = request_path + strcspn(request_path, "?#");
+    if (location[0] != '?')
+        while (end > request_path && end[-1] != '/') end--;
 
-    if (!link->title.textlen)
-    {
-        sfs_debug("error check link '%s': empty title\n",
-                  link->full_url.data);
+    if (request_path[0] != '/') ret = sfs_string_cat(&joined, "/");
+    if (!ret) ret = sfs_string_ncat(&joined, request_path, end - request_path);
+    if (!ret) ret = sfs_string_cat(&joined, location);
+    if (ret) goto out;
 
-        ret = sfs_string_cat_param(log, "error check link '%s': empty title\n",
-                  link->full_url.data);
-        goto out;
-    }
+    /*query is kept as is*/
+    end = joined.data + strcspn(joined.data, "?");
+    ret = remove_dot_segments(joined.data, end, path);
+    if (!ret) ret = sfs_string_cat(path, end);
 
-    if (!link->full_url.textlen)
-    {
-        sfs_debug("error check link '%s': empty url\n",
-                  link->full_url.data);
+out:
+    sfs_string_free(&joined);
+
+    return ret;
+}
 
-        ret = sfs_string_cat_param(log, "error check link '%s': empty url\n",
-                  link->full_url.data);
+/*
+ * if page got a same-host redirect, its path is changed to the target and
+ * redirect is remembered by mount; *followed is set then
+ */
+static int follow_redirect(struct surffs_sb_info *fsi, struct SURFFS_WEB_PAGE *page,
+                           int hops, int *followed)
+{
+    int ret = 0;
+    int status;
+    sfs_string location = {0};
+    sfs_string protocol = {0};
+    sfs_string host = {0};
+    sfs_string path = {0};
+    sfs_string from_buf = {0};
+    sfs_string to_buf = {0};
+    const char *from;
+    const char *to;
+    char *fragment;
+
+    *followed = 0;
+
+    ret = sfs_string_createz(&location, 128); if (ret) goto out;
+    ret = sfs_string_createz(&protocol, 16); if (ret) goto out;
+    ret = sfs_string_createz(&host, 64); if (ret) goto out;
+    ret = sfs_string_createz(&path, 128); if (ret) goto out;
+
+    status = surffs_http_redirect(&page->http_resp, &location);
+    if (status < 0) {ret = status; goto out;}
+    if (!status)
+    {
+        if (surffs_http_status(&page->http_resp) / 100 == 3)
+            ret = sfs_event_log_add(&page->events, EV_REDIRECT_REFUSED,
+                                    REDIRECT_NO_LOCATION, 0, 0);
         goto out;
     }
 
-    if (!is_valid_protocol(link->protocol.data))
+    if (hops == SURFFS_MAX_REDIRECTS)
     {
-        sfs_debug("error check link '%s': protocol '%s' not supported\n",
-                  link->full_url.data, link->protocol.data);
-
-        ret = sfs_string_cat_param(log, "error check link '%s': ",
-                  link->full_url.data);
-        if (ret) goto out;
-
-
-        ret = sfs_string_cat_param(log, "protocol '%s' not supported\n",
-                  link->protocol.data);
+        ret = sfs_event_log_add(&page->events, EV_REDIRECT_REFUSED, REDIRECT_TOO_MANY, 0, 0);
         goto out;
     }
 
+    /*"b" of a relative Location would be taken for a host*/
+    if (!strstr(location.data, "://") && location.data[0] != '/')
+        ret = resolve_location(page->address.path.data, location.data, &path);
+    else
+        ret = extract_url_params(location.data, &protocol, &host, &path, PREFER_PATH);
+    if (ret) goto out;
 
-    if (link->host.textlen && (strcmp(link->host.data, parent_addr.host.data) != 0))
+    if (!is_valid_protocol(protocol.data) ||
+        (host.textlen && strcmp(host.data, page->address.host.data) != 0))
     {
-        sfs_debug("error check link '%s': links to another host not supported (parent host = '%s')\n",
-                  link->full_url.data, parent_addr.host.data);
-
-        ret = sfs_string_cat_param(log,
-           "error check link '%s': links to another host not supported ", link->full_url.data);
-        if (ret) goto out;
-
-        ret = sfs_string_cat_param(log,
-            " (parent host = '%s')\n", parent_addr.host.data);
+        ret = sfs_event_log_add(&page->events, EV_REDIRECT_REFUSED, REDIRECT_OTHER_HOST, 0, 0);
         goto out;
     }
 
-    if (strcmp(link->path.data, parent_addr.path.data) == 0)
+    fragment = strchr(path.data, '#');
+    if (fragment)
     {
-        sfs_debug("error check link '%s': link to same path (parent path = '%s')\n",
-                  link->full_url.data, parent_addr.path.data);
+        *fragment = 0;
+        path.textlen = fragment - path.data;
+    }
+    if (!path.textlen) {ret = sfs_string_cat(&path, "/"); if (ret) goto out;}
 
-        ret = sfs_string_cat_param(log,
-           "error check link '%s': link to same path ", link->full_url.data);
-        if (ret) goto out;
+    /*redirects are kept by webpaths, they differ from paths for other hosts*/
+    ret = surffs_webpath(fsi, page->address.host.data, page->address.path.data, &from_buf, &from);
+    if (!ret) ret = surffs_webpath(fsi, page->address.host.data, path.data, &to_buf, &to);
+    if (!ret) ret = surffs_redirect_add(&fsi->redirects, from, to);
+    if (ret) goto out;
 
-        ret = sfs_string_cat_param(log,
-            " (parent path = '%s')\n", parent_addr.path.data);
-        goto out;
-    }
+    ret = sfs_string_set(&page->address.path, path.data);
+    if (ret) goto out;
 
-    *ok = 1;
+    sfs_stat_inc(&fsi->stats, SFS_STAT_REDIRECTS);
+    *followed = 1;
 
 out:
-    sfs_leave();
+    sfs_string_free(&location);
+    sfs_string_free(&protocol);
+    sfs_string_free(&host);
+    sfs_string_free(&path);
+    sfs_string_free(&from_buf);
+    sfs_string_free(&to_buf);
+
     return ret;
 }
 
-int add_number_to_title(sfs_string *title, int num)
+/*sitemap tells copy is up to date, so it is taken without revalidation*/
+static int disk_copy_fresh(struct surffs_sb_info *fsi, struct SURFFS_WEB_ADDRESS *address,
+                           struct surffs_disk_page *dp)
 {
-    int ret = 0;
-    char tmpbuf[256];
+    struct surffs_sitemap_entry *entry;
 
-    sfs_enter();
-    sfs_debug("add_number_to_title: %d\n", num)
+    /*sitemap lists pages of the mounted host only*/
+    if (strcmp(address->host.data, fsi->root_web_address->host.data) != 0) return 0;
 
-    snprintf(tmpbuf, sizeof(tmpbuf), "_link%d", num);
+    entry = surffs_sitemap_find(&fsi->sitemap, address->path.data);
 
-    ret = sfs_string_cat(title, tmpbuf);
-    if (ret) goto out;
+    return entry && entry->lastmod && dp->stored && entry->lastmod <= dp->stored;
+}
 
+static int disk_copy_reason(int ret, struct SURFFS_WEB_PAGE *page)
+{
+    if (!ret && surffs_http_status(&page->http_resp) == 304) return DISK_NOT_MODIFIED;
 
-out:
-    sfs_leave();
-    return ret;
+    /*server is unreachable: no response at all or breaker is open*/
+    if ((!ret && !surffs_http_status(&page->http_resp)) || ret == -EHOSTDOWN)
+        return DISK_STALE;
+
+    return -1;
 }
 
-int make_html_links(char *html,
-                    struct list_head *links_list,
-                    struct SURFFS_WEB_ADDRESS parent_addr,
-                    sfs_string *log)
+/*
+ * fetches page following redirects. Page having a copy in disk cache is
+ * revalidated, copy is taken if page is not modified or server is unreachable.
+ * Copy stored after lastmod of page in sitemap is taken without revalidation.
+ * Page is fetched by its own address, which redirects change
+ */
+static int fetch_webpage(struct surffs_sb_info *fsi, struct SURFFS_WEB_PAGE *page,
+                         int *from_disk)
 {
     int ret = 0;
-    int ok;
-    int n = 1;
-    const char *textpos = html;
-    sfs_string a_block = {0};
-    struct SURFFS_HTML_LINK *link;
+    struct SURFFS_WEB_ADDRESS *address = &page->address;
+    int followed = 0;
+    int have_copy = 0;
+    int reason;
+    int hops;
+    struct surffs_diskcache *dc = fsi ? &fsi->diskcache : 0;
+    struct surffs_disk_page dp;
 
-    sfs_enter();
-    sfs_debug("make_html_links\n");
+    *from_disk = 0;
 
-    ret = sfs_string_createz(&a_block, 256); if (ret) goto out;
-
-    while (1)
+    for (hops = 0; ; hops++)
     {
-        ret = extract_html_block(&textpos, "a", &a_block);
-        if (ret) goto out;
-        if (!a_block.textlen) break;
+        if (have_copy) surffs_disk_page_free(&dp);
+        have_copy = 0;
 
-        ret = SURFFS_HTML_LINK_alloc(&link);
-        if (ret) goto out;
-
-        ret = extract_html_link_params(a_block.data, link);
-        if (ret) goto out;
+        if (surffs_diskcache_enabled(dc))
+        {
+            ret = surffs_disk_page_read(dc, address, &dp);
+            have_copy = !ret;
+            /*unreadable copy is a miss*/
+            if (ret && ret != -ENOMEM) ret = 0;
+            if (ret) break;
+        }
 
-        ret = check_html_link(link, parent_addr, log, &ok);
-        if (ret) goto out;
+        if (have_copy && disk_copy_fresh(fsi, address, &dp))
+        {
+            reason = DISK_SITEMAP;
+            sfs_stat_inc(&fsi->stats, SFS_STAT_SITEMAP_FRESH);
+        }
+        else
+        {
+            ret = surffs_fetch(fsi, address, have_copy ? &dp.validators : 0,
+                               &page->http_resp, &page->http_payload, &page->events);
+            reason = have_copy ? disk_copy_reason(ret, page) : -1;
+        }
 
-        if (ok)
+        if (reason >= 0)
         {
-            ret = add_number_to_title(&link->title, n);
-            if (ret) goto out;
+            ret = surffs_disk_page_install(&dp, page);
+            if (!ret) ret = sfs_event_log_add(&page->events, EV_DISK_LOADED, reason, 0, 0);
+            if (ret) break;
+
+            sfs_stat_inc(&fsi->stats, reason == DISK_STALE ? SFS_STAT_DISK_STALE :
+                                                             SFS_STAT_DISK_HITS);
+            *from_disk = 1;
+            break;
+        }
 
-            sfs_debug("add html link: title = '%s' url = '%s'\n",
-                      link->title.data, link->full_url.data);
+        if (ret || page->http_payload || !fsi) break;
 
-            list_add(&link->html_links, links_list);
+        ret = follow_redirect(fsi, page, hops, &followed);
+        if (ret || !followed) break;
+    }
 
+    if (have_copy) surffs_disk_page_free(&dp);
 
-            ret = sfs_string_cat_param(log, "add html link: title = '%s' ",
-                                 link->title.data);
-            if (ret) goto out;
+    return ret;
+}
 
-            ret = sfs_string_cat_param(log, "url = '%s'\n",
-                                 link->full_url.data);
-            if (ret) goto out;
+static int set_page_address(struct SURFFS_WEB_PAGE *page, struct SURFFS_WEB_ADDRESS *address)
+{
+    int ret = 0;
 
-            n++;
-        }
+    ret = sfs_string_set(&page->address.ip, address->ip.data); if (ret) goto out;
+    page->address.port = address->port;
+    ret = sfs_string_set(&page->address.host, address->host.data); if (ret) goto out;
+    ret = sfs_string_set(&page->address.path, address->path.data); if (ret) goto out;
+
+out:
+    return ret;
+}
+
+/*fetched response becomes page: status, links, disk copy*/
+static int finish_webpage(struct surffs_sb_info *fsi, struct SURFFS_WEB_ADDRESS address,
+                          struct SURFFS_WEB_PAGE *page, int from_disk)
+{
+    int ret = 0;
+    struct surffs_stats *stats = fsi ? &fsi->stats : 0;
+    ktime_t parse_start;
+
+    ret = sfs_string_clear(&page->full_url); if (ret) goto out;
+    ret = sfs_string_catf(&page->full_url, "%s%s",
+                          page->address.host.data, page->address.path.data);
+    if (ret) goto out;
+
+    if (!page->http_payload)
+    {
+        sfs_stat_inc(stats, SFS_STAT_ERR_HTTP);
+        page->status = STATUS_HTTP_ERROR;
+        ret = sfs_string_set(&page->status_str, STATUS_HTTP_ERROR_STR);
+        goto out;
+    }
+
+    /*links of disk copy are loaded with it*/
+    if (from_disk) goto ok;
+
+    parse_start = ktime_get();
+    ret = make_html_links(page->http_payload, &page->html_links, address,
+                          fsi ? surffs_hosts_names(&fsi->hosts) : 0,
+                          &page->arena, &page->events, &page->links_count);
+    sfs_stat_latency(stats, SFS_PHASE_PARSE, parse_start);
+    sfs_stat_add(stats, SFS_STAT_PARSE_TIME_US, ktime_us_delta(ktime_get(), parse_start));
+    if (ret) goto out;
+
+    sfs_stat_inc(stats, SFS_STAT_PAGES_FETCHED);
+    sfs_stat_add(stats, SFS_STAT_LINKS_EXTRACTED, page->links_count);
+
+    if (surffs_diskcache_enabled(fsi ? &fsi->diskcache : 0))
+    {
+        /*disk cache is an optimization, page is good without it*/
+        if (surffs_disk_page_write(&fsi->diskcache, page))
+            sfs_stat_inc(stats, SFS_STAT_ERR_DISK);
         else
-        {
-            sfs_debug("skip html link: title = '%s' url = '%s'\n",
-                      link->title.data, link->full_url.data);
-            SURFFS_HTML_LINK_free(link);
-        }
+            sfs_stat_inc(stats, SFS_STAT_DISK_WRITES);
     }
 
-    sfs_debug("make_html_links OK\n");
+ok:
+    page->status = STATUS_OK;
+    ret = sfs_string_set(&page->status_str, STATUS_OK_STR);
+    if (ret) goto out;
+
+    /*links are parsed and disk copy is written, the rest of body is read by ranges*/
+    if (fsi && fsi->lazy_body)
+    {
+        ret = surffs_lazy_body_trim(page, fsi->lazy_keep);
+        if (ret) goto out;
+    }
 
 out:
-    sfs_string_free(&a_block);
-    sfs_leave();
     return ret;
 }
 
-int obtain_webpage(struct SURFFS_WEB_ADDRESS address, struct SURFFS_WEB_PAGE *page)
+int obtain_webpage(struct surffs_sb_info *fsi, struct SURFFS_WEB_ADDRESS address,
+                   struct SURFFS_WEB_PAGE *page)
 {
     int ret = 0;
-
-    sfs_enter();
-    sfs_debug("obtain_webpage\n");
+    struct surffs_stats *stats = fsi ? &fsi->stats : 0;
+    int from_disk = 0;
 
     if (page->status != STATUS_NEED_GET)
     {
@@ -210,38 +360,62 @@ int obtain_webpage(struct SURFFS_WEB_ADDRESS address, struct SURFFS_WEB_PAGE *pa
         goto out;
     }
 
-    ret = sfs_string_set(&page->address.ip, address.ip.data); if (ret) goto out;
-    ret = sfs_string_set(&page->address.host, address.host.data); if (ret) goto out;
-    ret = sfs_string_set(&page->address.path, address.path.data); if (ret) goto out;
-    ret = sfs_string_clear(&page->full_url); if (ret) goto out;
-    ret = sfs_string_cat(&page->full_url, page->address.host.data); if (ret) goto out;
-    ret = sfs_string_cat(&page->full_url, page->address.path.data); if (ret) goto out;
-
-    ret = surffs_get_http(  address.ip.data,
-                            address.host.data,
-                            address.path.data,
-                            &page->http_resp,
-                            &page->http_payload,
-                            &page->log);
+    ret = set_page_address(page, &address);
     if (ret) goto out;
 
-    if (!page->http_payload)
-    {
-        page->status = STATUS_HTTP_ERROR;
-        ret = sfs_string_set(&page->status_str, STATUS_HTTP_ERROR_STR);
-        goto out;
-    }
+    trace_surffs_fetch_start(address.ip.data, address.host.data, address.path.data);
 
-    ret = make_html_links(page->http_payload, &page->html_links, address, &page->log);
+    ret = fetch_webpage(fsi, page, &from_disk);
     if (ret) goto out;
 
+    /*links of redirected page are relative to the target path*/
+    ret = finish_webpage(fsi, page->address, page, from_disk);
 
-    page->status = STATUS_OK;
-    ret = sfs_string_set(&page->status_str, STATUS_OK_STR);
+out:
+    if (ret == -ENOMEM) sfs_stat_inc(stats, SFS_STAT_ERR_NOMEM);
+    trace_surffs_fetch_end(address.host.data, address.path.data, ret,
+                           page->status, page->http_resp.textlen, page->links_count);
+    return ret;
+}
+
+/*
+ * fetches cached page again with its validators. *fresh is the new page
+ * if server gave one, NULL if page is not modified, redirected or could
+ * not be fetched: cached page stays then
+ */
+int refresh_webpage(struct surffs_sb_info *fsi, struct SURFFS_WEB_PAGE *page,
+                    struct SURFFS_WEB_PAGE **fresh)
+{
+    int ret = 0;
+    struct SURFFS_WEB_PAGE *p = 0;
+    struct surffs_validators cond = {{0}, {0}};
+
+    *fresh = 0;
+
+    ret = surffs_http_header(&page->http_resp, "ETag", &cond.etag);
+    if (!ret) ret = surffs_http_header(&page->http_resp, "Last-Modified", &cond.last_modified);
+    if (!ret) ret = SURFFS_WEB_PAGE_alloc(&p);
+    if (!ret) ret = set_page_address(p, &page->address);
+    if (ret) goto out;
+
+    trace_surffs_fetch_start(p->address.ip.data, p->address.host.data, p->address.path.data);
+
+    ret = surffs_fetch(fsi, &p->address, page->http_payload ? &cond : 0,
+                       &p->http_resp, &p->http_payload, &p->events);
+    if (ret || !p->http_payload) goto out;
+
+    ret = finish_webpage(fsi, p->address, p, 0);
     if (ret) goto out;
 
+    *fresh = p;
+    p = 0;
+
 out:
-    sfs_leave();
+    if (ret == -ENOMEM) sfs_stat_inc(&fsi->stats, SFS_STAT_ERR_NOMEM);
+    if (p) SURFFS_WEB_PAGE_put(p);
+    sfs_string_free(&cond.etag);
+    sfs_string_free(&cond.last_modified);
+
     return ret;
 }
 
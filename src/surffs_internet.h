@@ -3,8 +3,12 @@
 
 #include <linux/kernel.h>
 #include "surffs_webpages.h"
+#include "surffs_links.h"
 
+int obtain_webpage(struct surffs_sb_info *fsi, struct SURFFS_WEB_ADDRESS address,
+                   struct SURFFS_WEB_PAGE *page);
 
-int is_valid_protocol(char *protocol);
-int obtain_webpage(struct SURFFS_WEB_ADDRESS address, struct SURFFS_WEB_PAGE *page);
+/*new page if cached one changed on server, see surffs_refresh.h*/
+int refresh_webpage(struct surffs_sb_info *fsi, struct SURFFS_WEB_PAGE *page,
+                    struct SURFFS_WEB_PAGE **fresh);
 #endif
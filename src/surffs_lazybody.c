@@ -0,0 +1,344 @@
+#include "surffs_lazybody.h"
+#include "surffs_sb.h"
+#include "surffs_socket.h"
+#include "surffs_fetch.h"
+#include "surffs_stats.h"
+#include "surffs_debug.h"
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+#include <asm/uaccess.h>
+
+u64 surffs_page_body_len(struct SURFFS_WEB_PAGE *page)
+{
+    if (page->lazy) return page->lazy->len;
+    if (!page->http_payload) return 0;
+
+    return page->http_resp.textlen - (page->http_payload - page->http_resp.data);
+}
+
+void surffs_lazy_body_free(struct surffs_lazy_body *body)
+{
+    u32 i;
+
+    if (!body) return;
+
+    if (body->blocks)
+    {
+        for (i = 0; i < body->nblocks; i++)
+            kfree(body->blocks[i]);
+        vfree(body->blocks);
+    }
+    sfs_string_free(&body->cond.etag);
+    sfs_string_free(&body->cond.last_modified);
+
+    kfree(body);
+}
+
+int surffs_lazy_body_trim(struct SURFFS_WEB_PAGE *page, size_t keep)
+{
+    int ret = 0;
+    struct surffs_lazy_body *body = 0;
+    sfs_string resp = {0};
+    size_t headers_len;
+    u64 len = surffs_page_body_len(page);
+
+    if (!page->http_payload || page->lazy) goto out;
+
+    keep = round_up(keep, SURFFS_LAZY_BLOCK);
+    if (len <= keep) goto out;
+
+    body = kzalloc(sizeof(struct surffs_lazy_body), GFP_KERNEL);
+    if (!body) {ret = -ENOMEM; goto out;}
+
+    mutex_init(&body->lock);
+    body->len = len;
+    body->kept = keep;
+    body->nblocks = DIV_ROUND_UP(len, SURFFS_LAZY_BLOCK);
+    body->blocks = vzalloc(body->nblocks * sizeof(char *));
+    if (!body->blocks) {ret = -ENOMEM; goto out;}
+
+    ret = surffs_http_header(&page->http_resp, "ETag", &body->cond.etag);
+    if (!ret) ret = surffs_http_header(&page->http_resp, "Last-Modified", &body->cond.last_modified);
+    if (ret) goto out;
+
+    /*response is copied, so memory of dropped part goes away*/
+    headers_len = page->http_payload - page->http_resp.data;
+    ret = sfs_string_createz(&resp, headers_len + keep + 1);
+    if (ret) goto out;
+    memcpy(resp.data, page->http_resp.data, headers_len + keep);
+    resp.textlen = headers_len + keep;
+    resp.data[resp.textlen] = 0;
+
+    sfs_string_free(&page->http_resp);
+    page->http_resp = resp;
+    page->http_payload = resp.data + headers_len;
+    page->lazy = body;
+    body = 0;
+
+out:
+    surffs_lazy_body_free(body);
+
+    return ret;
+}
+
+static int block_ready(struct surffs_lazy_body *body, u32 block)
+{
+    return ((size_t)block << SURFFS_LAZY_BLOCK_SHIFT) < body->kept || body->blocks[block];
+}
+
+static char *block_data(struct SURFFS_WEB_PAGE *page, u32 block)
+{
+    size_t offset = (size_t)block << SURFFS_LAZY_BLOCK_SHIFT;
+
+    if (offset < page->lazy->kept) return page->http_payload + offset;
+
+    return page->lazy->blocks[block];
+}
+
+/*copies blocks first..last from data, which starts at block first*/
+static int fill_blocks(struct surffs_lazy_body *body, char *data, size_t avail,
+                       u32 first, u32 last)
+{
+    int ret = 0;
+    size_t offset;
+    size_t len;
+    u32 i;
+
+    for (i = first; i <= last; i++)
+    {
+        offset = (size_t)(i - first) << SURFFS_LAZY_BLOCK_SHIFT;
+        len = min_t(u64, SURFFS_LAZY_BLOCK, body->len - ((u64)i << SURFFS_LAZY_BLOCK_SHIFT));
+        if (offset + len > avail) {ret = -EIO; goto out;}
+        if (block_ready(body, i)) continue;
+
+        body->blocks[i] = kmalloc(SURFFS_LAZY_BLOCK, GFP_KERNEL);
+        if (!body->blocks[i]) {ret = -ENOMEM; goto out;}
+        memcpy(body->blocks[i], data + offset, len);
+    }
+
+out:
+    return ret;
+}
+
+/*
+ * 1 if resp has validators of cached version of body, 0 if they differ,
+ * -ENODATA if cached version has none; called under body->lock
+ */
+static int same_validators(struct surffs_lazy_body *body, sfs_string *resp)
+{
+    int ret = 0;
+    sfs_string etag = {0};
+    sfs_string last_modified = {0};
+
+    ret = surffs_http_header(resp, "ETag", &etag);
+    if (!ret) ret = surffs_http_header(resp, "Last-Modified", &last_modified);
+    if (ret) goto out;
+
+    if (body->cond.etag.textlen)
+        ret = etag.textlen && !strcmp(etag.data, body->cond.etag.data);
+    else if (body->cond.last_modified.textlen)
+        ret = last_modified.textlen &&
+              !strcmp(last_modified.data, body->cond.last_modified.data);
+    else
+        ret = -ENODATA;
+
+out:
+    sfs_string_free(&etag);
+    sfs_string_free(&last_modified);
+
+    return ret;
+}
+
+int surffs_lazy_body_current(struct surffs_lazy_body *body, sfs_string *resp)
+{
+    int ret;
+
+    mutex_lock(&body->lock);
+    ret = same_validators(body, resp);
+    mutex_unlock(&body->lock);
+
+    return ret;
+}
+
+/*
+ * whole body of response of len bytes is of another version than cached
+ * blocks: its validators differ, or its length if page has no validators
+ */
+static int body_changed(struct surffs_lazy_body *body, sfs_string *resp, u64 len,
+                        int *changed)
+{
+    int ret = same_validators(body, resp);
+
+    if (ret == -ENODATA)
+    {
+        *changed = len != body->len;
+        return 0;
+    }
+    if (ret < 0) return ret;
+
+    *changed = !ret;
+
+    return 0;
+}
+
+/*
+ * drops all cached blocks, kept ones included, and sizes body for new
+ * version of len bytes with validators of resp
+ */
+static int reset_body(struct surffs_lazy_body *body, sfs_string *resp, u64 len)
+{
+    int ret = 0;
+    char **blocks;
+    u32 nblocks = DIV_ROUND_UP(len, SURFFS_LAZY_BLOCK);
+    u32 i;
+
+    blocks = vzalloc(max_t(u32, nblocks, 1) * sizeof(char *));
+    if (!blocks) {ret = -ENOMEM; goto out;}
+
+    for (i = 0; i < body->nblocks; i++)
+        kfree(body->blocks[i]);
+    vfree(body->blocks);
+
+    body->blocks = blocks;
+    body->nblocks = nblocks;
+    body->len = len;
+    body->kept = 0;
+
+    ret = surffs_http_header(resp, "ETag", &body->cond.etag);
+    if (!ret) ret = surffs_http_header(resp, "Last-Modified", &body->cond.last_modified);
+
+out:
+    return ret;
+}
+
+/*
+ * blocks first..last by one Range request, called under body->lock.
+ * Server without ranges or with changed page sends whole body: all
+ * blocks are taken from it, after cached ones of old version are dropped
+ */
+static int fetch_blocks(struct surffs_sb_info *fsi, struct SURFFS_WEB_PAGE *page,
+                        u32 first, u32 last)
+{
+    int ret = 0;
+    struct surffs_lazy_body *body = page->lazy;
+    struct SURFFS_WEB_ADDRESS address = page->address;
+    struct sfs_arena arena;
+    struct sfs_event_log log;
+    sfs_string resp = {0};
+    sfs_string content_range = {0};
+    char *payload = 0;
+    size_t avail;
+    unsigned long long start;
+    int changed = 0;
+
+    sfs_arena_init(&arena);
+    sfs_event_log_init(&log, &arena);
+
+    ret = sfs_string_createz(&resp, SURFFS_LAZY_BLOCK * (last - first + 1) + 1024);
+    if (ret) goto out;
+
+    body->cond.range = 1;
+    body->cond.range_first = (u64)first << SURFFS_LAZY_BLOCK_SHIFT;
+    body->cond.range_last = min_t(u64, body->len, (u64)(last + 1) << SURFFS_LAZY_BLOCK_SHIFT) - 1;
+
+    sfs_stat_inc(&fsi->stats, SFS_STAT_RANGE_REQUESTS);
+
+    ret = surffs_fetch(fsi, &address, &body->cond, &resp, &payload, &log);
+    if (ret) goto out;
+    if (!payload) {ret = -EIO; goto out;}
+
+    avail = resp.textlen - (payload - resp.data);
+
+    if (surffs_http_status(&resp) == 206)
+    {
+        ret = surffs_http_header(&resp, "Content-Range", &content_range);
+        if (ret) goto out;
+        if (!content_range.textlen ||
+            sscanf(content_range.data, "bytes %llu-", &start) != 1 ||
+            start != body->cond.range_first)
+        {
+            ret = -EIO;
+            goto out;
+        }
+        ret = fill_blocks(body, payload, avail, first, last);
+        goto out;
+    }
+
+    ret = body_changed(body, &resp, avail, &changed);
+    if (ret) goto out;
+    if (changed)
+    {
+        sfs_info("%s%s changed on server, cached body is dropped\n",
+                 page->address.host.data, page->address.path.data);
+        ret = reset_body(body, &resp, avail);
+        if (ret) goto out;
+    }
+    if (body->nblocks) ret = fill_blocks(body, payload, avail, 0, body->nblocks - 1);
+
+out:
+    if (ret) sfs_info("range %llu-%llu of %s%s is not loaded, error code %d\n",
+                      body->cond.range_first, body->cond.range_last,
+                      page->address.host.data, page->address.path.data, ret);
+    body->cond.range = 0;
+    sfs_string_free(&content_range);
+    sfs_string_free(&resp);
+    sfs_arena_free(&arena);
+
+    return ret;
+}
+
+ssize_t surffs_lazy_body_read(struct surffs_sb_info *fsi, struct SURFFS_WEB_PAGE *page,
+                              char __user *buf, size_t len, loff_t pos)
+{
+    int ret = 0;
+    struct surffs_lazy_body *body = page->lazy;
+    size_t done = 0;
+    size_t offset;
+    size_t n;
+    u32 first, last, block;
+
+    if (pos < 0) return -EINVAL;
+    if (!len) return 0;
+
+    /*another reader may resize body of changed page meanwhile*/
+    mutex_lock(&body->lock);
+
+    if (pos >= body->len) goto out;
+    if (len > body->len - pos) len = body->len - pos;
+
+    first = pos >> SURFFS_LAZY_BLOCK_SHIFT;
+    last = (pos + len - 1) >> SURFFS_LAZY_BLOCK_SHIFT;
+
+    /*one request covers run from the first missing block to the last one*/
+    while (first <= last && block_ready(body, first)) first++;
+    while (last > first && block_ready(body, last)) last--;
+    if (first <= last)
+    {
+        ret = fetch_blocks(fsi, page, first, last);
+        if (ret) goto out;
+    }
+
+    /*changed page may be shorter now*/
+    if (pos >= body->len) goto out;
+    if (len > body->len - pos) len = body->len - pos;
+
+    while (done < len)
+    {
+        block = (pos + done) >> SURFFS_LAZY_BLOCK_SHIFT;
+        offset = (pos + done) & (SURFFS_LAZY_BLOCK - 1);
+        n = min_t(size_t, SURFFS_LAZY_BLOCK - offset, len - done);
+
+        if (copy_to_user(buf + done, block_data(page, block) + offset, n))
+        {
+            ret = -EFAULT;
+            goto out;
+        }
+        done += n;
+    }
+
+out:
+    mutex_unlock(&body->lock);
+
+    return done ? done : ret;
+}
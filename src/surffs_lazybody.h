@@ -0,0 +1,53 @@
+#ifndef _SURFFS_LAZYBODY_H_
+#define _SURFFS_LAZYBODY_H_
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/mutex.h>
+#include "surffs_webpages.h"
+#include "surffs_socket.h"
+
+/*
+ * Lazy body (mount option lazy_body[=<bytes>]): links of page are parsed
+ * from the whole body when page is fetched, but only its first bytes
+ * (SURFFS_LAZY_KEEP by default, rounded up to blocks) stay in memory.
+ * Reads of page.html beyond them fetch missing blocks by Range requests,
+ * one request per read for the run of missing blocks, and keep them in
+ * the page. Block is SURFFS_LAZY_BLOCK bytes. If-Range makes server send
+ * the whole page if it changed; all blocks are taken from a whole body,
+ * and blocks of the old version are dropped first if it changed.
+ */
+#define SURFFS_LAZY_BLOCK_SHIFT 12
+#define SURFFS_LAZY_BLOCK (1 << SURFFS_LAZY_BLOCK_SHIFT)
+#define SURFFS_LAZY_KEEP (4 * SURFFS_LAZY_BLOCK)
+
+struct surffs_sb_info;
+
+struct surffs_lazy_body
+{
+    struct mutex lock;          /*held while blocks are fetched*/
+    u64 len;                    /*length of whole body*/
+    size_t kept;                /*bytes of body kept in http_resp*/
+    u32 nblocks;
+    char **blocks;              /*blocks past kept ones, NULL until read*/
+    struct surffs_validators cond;  /*validators of cached version for If-Range*/
+};
+
+/*drops body of page past keep bytes, page stays as is if body is not longer*/
+int  surffs_lazy_body_trim(struct SURFFS_WEB_PAGE *page, size_t keep);
+void surffs_lazy_body_free(struct surffs_lazy_body *body);
+
+/*
+ * 1 if response has validators of cached version of body, 0 if they
+ * differ, -ENODATA if cached version has none
+ */
+int  surffs_lazy_body_current(struct surffs_lazy_body *body, sfs_string *resp);
+
+/*length of whole body of page, kept or not*/
+u64  surffs_page_body_len(struct SURFFS_WEB_PAGE *page);
+
+/*read of page.html of page with lazy body*/
+ssize_t surffs_lazy_body_read(struct surffs_sb_info *fsi, struct SURFFS_WEB_PAGE *page,
+                              char __user *buf, size_t len, loff_t pos);
+
+#endif
@@ -0,0 +1,225 @@
+#include "surffs_links.h"
+#include <linux/string.h>
+#include <linux/list.h>
+#include "surffs_debug.h"
+#include "surffs_mem.h"
+#include "surffs_parser.h"
+#include "surffs_trace.h"
+
+int SURFFS_HTML_LINK_alloc(struct SURFFS_HTML_LINK **link)
+{
+    int ret = 0;
+    struct SURFFS_HTML_LINK *newlink = 0;
+
+    newlink = surffs_cache_zalloc(SFS_CACHE_HTML_LINK);
+    if (!newlink) {ret = -ENOMEM; goto out;}
+
+    ret = sfs_string_createz(&newlink->title, 64); if (ret) goto out;
+    ret = sfs_string_createz(&newlink->protocol, 16); if (ret) goto out;
+    ret = sfs_string_createz(&newlink->host, 64); if (ret) goto out;
+    ret = sfs_string_createz(&newlink->path, 64); if (ret) goto out;
+    ret = sfs_string_createz(&newlink->full_url, 64); if (ret) goto out;
+
+    *link = newlink;
+
+out:
+    if (ret && newlink) SURFFS_HTML_LINK_free(newlink);
+
+    return ret;
+}
+
+/*makes copy of link with exact-sized strings placed in page arena*/
+int SURFFS_HTML_LINK_clone(struct SURFFS_HTML_LINK *src, struct sfs_arena *arena,
+                           struct SURFFS_HTML_LINK **link)
+{
+    int ret = 0;
+    struct SURFFS_HTML_LINK *newlink = 0;
+
+    newlink = surffs_cache_zalloc(SFS_CACHE_HTML_LINK);
+    if (!newlink) {ret = -ENOMEM; goto out;}
+
+    ret = sfs_string_create_in(&newlink->title, arena, src->title.data); if (ret) goto out;
+    ret = sfs_string_create_in(&newlink->protocol, arena, src->protocol.data); if (ret) goto out;
+    ret = sfs_string_create_in(&newlink->host, arena, src->host.data); if (ret) goto out;
+    ret = sfs_string_create_in(&newlink->path, arena, src->path.data); if (ret) goto out;
+    ret = sfs_string_create_in(&newlink->full_url, arena, src->full_url.data); if (ret) goto out;
+
+    *link = newlink;
+
+out:
+    if (ret && newlink) SURFFS_HTML_LINK_free(newlink);
+
+    return ret;
+}
+
+void SURFFS_HTML_LINK_free(struct SURFFS_HTML_LINK *link)
+{
+    if (!link) goto out;
+
+    sfs_string_free(&link->title);
+    sfs_string_free(&link->protocol);
+    sfs_string_free(&link->host);
+    sfs_string_free(&link->path);
+    sfs_string_free(&link->full_url);
+    surffs_cache_free(SFS_CACHE_HTML_LINK, link);
+
+out:
+    return;
+}
+
+int SURFFS_HTML_LINK_print(struct SURFFS_HTML_LINK *link, sfs_string *str)
+{
+    int ret = 0;
+
+    ret = sfs_string_catf(str, "SURFFS_HTML_LINK: "
+                               "title = '%s' full_url = '%s' protocol = '%s' "
+                               "host = '%s' path = '%s' ",
+                          link->title.data, link->full_url.data,
+                          link->protocol.data, link->host.data,
+                          link->path.data);
+
+    return ret;
+}
+
+char* supported_protocols[] = {"http", 0};
+
+int is_valid_protocol(char *protocol)
+{
+    char **i;
+
+    if (!protocol[0])
+        return 1;
+
+    for (i = supported_protocols; *i; i++)
+        if (strcmp(protocol, *i) == 0)
+            return 1;
+
+    return 0;
+}
+
+static int is_listed_host(const char *host, const char **hosts)
+{
+    for (; hosts && *hosts; hosts++)
+        if (strcmp(host, *hosts) == 0)
+            return 1;
+
+    return 0;
+}
+
+enum SURFFS_LINK_CHECK check_html_link(struct SURFFS_HTML_LINK *link,
+                                      struct SURFFS_WEB_ADDRESS parent_addr,
+                                      const char **hosts)
+{
+    enum SURFFS_LINK_CHECK res = LINK_OK;
+
+    if (!link->title.textlen)
+    {
+        res = LINK_EMPTY_TITLE;
+        goto out;
+    }
+
+    if (!link->full_url.textlen)
+    {
+        res = LINK_EMPTY_URL;
+        goto out;
+    }
+
+    if (!is_valid_protocol(link->protocol.data))
+    {
+        res = LINK_BAD_PROTOCOL;
+        goto out;
+    }
+
+    if (link->host.textlen && (strcmp(link->host.data, parent_addr.host.data) != 0))
+    {
+        if (!is_listed_host(link->host.data, hosts)) res = LINK_OTHER_HOST;
+        goto out;
+    }
+
+    if (strcmp(link->path.data, parent_addr.path.data) == 0)
+    {
+        res = LINK_SAME_PATH;
+        goto out;
+    }
+
+out:
+    return res;
+}
+
+int add_number_to_title(sfs_string *title, int num)
+{
+    int ret = 0;
+
+    ret = sfs_string_catf(title, "_link%d", num);
+
+    return ret;
+}
+
+/*
+ * every <a> block is parsed into one scratch link, only accepted links
+ * are copied (with exact-sized strings) into page arena
+ */
+int make_html_links(char *html,
+                    struct list_head *links_list,
+                    struct SURFFS_WEB_ADDRESS parent_addr,
+                    const char **hosts,
+                    struct sfs_arena *arena,
+                    struct sfs_event_log *log,
+                    u32 *links_count)
+{
+    int ret = 0;
+    enum SURFFS_LINK_CHECK check;
+    u32 block_offset;
+    int n = 1;
+    const char *textpos = html;
+    sfs_string a_block = {0};
+    struct SURFFS_HTML_LINK *scratch = 0;
+    struct SURFFS_HTML_LINK *link;
+
+    ret = sfs_string_createz(&a_block, 256); if (ret) goto out;
+    ret = SURFFS_HTML_LINK_alloc(&scratch); if (ret) goto out;
+
+    while (1)
+    {
+        ret = extract_html_block(&textpos, "a", &a_block);
+        if (ret) goto out;
+        if (!a_block.textlen) break;
+
+        ret = extract_html_link_params(a_block.data, scratch);
+        if (ret) goto out;
+
+        block_offset = (textpos - html) - a_block.textlen;
+
+        check = check_html_link(scratch, parent_addr, hosts);
+        trace_surffs_link_parsed(scratch->title.data, scratch->full_url.data, check);
+
+        if (check == LINK_OK)
+        {
+            ret = add_number_to_title(&scratch->title, n);
+            if (ret) goto out;
+
+            ret = SURFFS_HTML_LINK_clone(scratch, arena, &link);
+            if (ret) goto out;
+            link->number = n;
+
+            list_add(&link->html_links, links_list);
+
+            ret = sfs_event_log_add(log, EV_LINK_ADDED, 0, n, 0);
+            if (ret) goto out;
+
+            n++;
+        }
+        else
+        {
+            ret = sfs_event_log_add(log, EV_LINK_SKIPPED, check, block_offset, 0);
+            if (ret) goto out;
+        }
+    }
+
+out:
+    *links_count = n - 1;
+    SURFFS_HTML_LINK_free(scratch);
+    sfs_string_free(&a_block);
+
+    return ret;
+}
@@ -0,0 +1,33 @@
+#ifndef _SURFFS_LINKS_H_
+#define _SURFFS_LINKS_H_
+
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include "surffs_helpers.h"
+#include "surffs_arena.h"
+#include "surffs_eventlog.h"
+#include "surffs_webpages.h"
+
+/*
+ * Extraction of html links from page text. This is pure text processing,
+ * it is also built in userspace for benchmarks (see bench/)
+ */
+
+int is_valid_protocol(char *protocol);
+
+/*links to hosts (NULL-terminated, may be NULL) are accepted besides parent's one*/
+enum SURFFS_LINK_CHECK check_html_link(struct SURFFS_HTML_LINK *link,
+                                       struct SURFFS_WEB_ADDRESS parent_addr,
+                                       const char **hosts);
+
+int add_number_to_title(sfs_string *title, int num);
+
+int make_html_links(char *html,
+                    struct list_head *links_list,
+                    struct SURFFS_WEB_ADDRESS parent_addr,
+                    const char **hosts,
+                    struct sfs_arena *arena,
+                    struct sfs_event_log *log,
+                    u32 *links_count);
+
+#endif
@@ -0,0 +1,93 @@
+#include "surffs_localfile.h"
+#include "surffs_debug.h"
+#include <linux/namei.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/err.h>
+
+#define SURFFS_LOCAL_READ_CHUNK 65536
+
+int surffs_local_dir_init(struct surffs_local_dir *dir, const char *path, const char *option)
+{
+    int ret = 0;
+    struct path p;
+
+    if (path[0] != '/')
+    {
+        sfs_error("error mount surffs: %s must be an absolute path\n", option);
+        ret = -EINVAL;
+        goto out;
+    }
+
+    ret = kern_path(path, LOOKUP_FOLLOW | LOOKUP_DIRECTORY, &p);
+    if (ret)
+    {
+        sfs_error("error mount surffs: %s '%s' not found, error code %d\n", option, path, ret);
+        goto out;
+    }
+    path_put(&p);
+
+    dir->path = kstrdup(path, GFP_KERNEL);
+    if (!dir->path) {ret = -ENOMEM; goto out;}
+
+    dir->cred = get_current_cred();
+
+out:
+    return ret;
+}
+
+void surffs_local_dir_free(struct surffs_local_dir *dir)
+{
+    kfree(dir->path);
+    dir->path = 0;
+    if (dir->cred) put_cred(dir->cred);
+    dir->cred = 0;
+}
+
+struct file *surffs_local_open(struct surffs_local_dir *dir, const char *name,
+                               int flags, umode_t mode)
+{
+    struct file *file;
+    const struct cred *old_cred;
+    sfs_string full = {0};
+    int ret = 0;
+
+    ret = sfs_string_createz(&full, 256);
+    if (!ret) ret = sfs_string_catf(&full, "%s/%s", dir->path, name);
+    if (ret)
+    {
+        sfs_string_free(&full);
+        return ERR_PTR(ret);
+    }
+
+    old_cred = override_creds(dir->cred);
+    file = filp_open(full.data, flags | O_LARGEFILE, mode);
+    revert_creds(old_cred);
+
+    sfs_string_free(&full);
+
+    return file;
+}
+
+int surffs_local_read_all(struct file *file, sfs_string *str)
+{
+    int ret = 0;
+    loff_t pos = 0;
+    int n;
+
+    while (1)
+    {
+        ret = sfs_string_reserve(str, SURFFS_LOCAL_READ_CHUNK);
+        if (ret) return ret;
+
+        n = kernel_read(file, pos, str->data + str->textlen, SURFFS_LOCAL_READ_CHUNK);
+        if (n < 0) return n;
+        if (!n) break;
+
+        pos += n;
+        str->textlen += n;
+        str->data[str->textlen] = 0;
+    }
+
+    return pos;
+}
@@ -0,0 +1,32 @@
+#ifndef _SURFFS_LOCALFILE_H_
+#define _SURFFS_LOCALFILE_H_
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/fs.h>
+#include <linux/cred.h>
+#include "surffs_helpers.h"
+
+/*
+ * Directory on local disk given by mount option (cache_dir=, mirror=).
+ * Its files are accessed with credentials of the mounting process, not of
+ * the process which happens to trigger loading of a page.
+ */
+struct surffs_local_dir
+{
+    char *path;                 /*NULL - not set*/
+    const struct cred *cred;
+};
+
+/*option is name of mount option for error messages*/
+int  surffs_local_dir_init(struct surffs_local_dir *dir, const char *path, const char *option);
+void surffs_local_dir_free(struct surffs_local_dir *dir);
+
+/*name is relative to dir, ERR_PTR() on error*/
+struct file *surffs_local_open(struct surffs_local_dir *dir, const char *name,
+                               int flags, umode_t mode);
+
+/*appends whole file to str, returns number of bytes read*/
+int surffs_local_read_all(struct file *file, sfs_string *str);
+
+#endif
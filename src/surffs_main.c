@@ -3,6 +3,13 @@
 #include <linux/init.h>
 #include "surffs_sb.h"
 #include "surffs_debug.h"
+#include "surffs_mem.h"
+#include "surffs_stats.h"
+#include "surffs_debugfs.h"
+#include "surffs_selftest.h"
+#include "surffs_hedge.h"
+#include "surffs_offload.h"
+#include "surffs_async.h"
 
 static struct file_system_type surf_fs_type = {
     .owner		= THIS_MODULE,
@@ -18,26 +25,81 @@ static int __init surffs_init(void)
 
     printk(KERN_INFO"surffs version %s\n", SURFFS_VERSION);
 
-    sfs_enter();
     sfs_info("surffs_init=======================\n");
 
+    ret = surffs_init_caches();
+    if (ret) goto out;
+
+    ret = surffs_stats_register();
+    if (ret)
+    {
+        surffs_destroy_caches();
+        goto out;
+    }
+
+    ret = surffs_hedge_init();
+    if (ret)
+    {
+        surffs_stats_unregister();
+        surffs_destroy_caches();
+        goto out;
+    }
+
+    ret = surffs_offload_init();
+    if (ret)
+    {
+        surffs_hedge_exit();
+        surffs_stats_unregister();
+        surffs_destroy_caches();
+        goto out;
+    }
+
+    ret = surffs_async_init();
+    if (ret)
+    {
+        surffs_offload_exit();
+        surffs_hedge_exit();
+        surffs_stats_unregister();
+        surffs_destroy_caches();
+        goto out;
+    }
+
+    surffs_debugfs_init();
+
     ret = register_filesystem(&surf_fs_type);
     if (ret)
     {
         sfs_error("error register surffs filesystem, error code %d\n", ret);
+        surffs_debugfs_exit();
+        surffs_async_exit();
+        surffs_offload_exit();
+        surffs_hedge_exit();
+        surffs_stats_unregister();
+        surffs_destroy_caches();
+        goto out;
+    }
+
+    ret = surffs_selftest(&surf_fs_type);
+    if (ret)
+    {
+        unregister_filesystem(&surf_fs_type);
+        surffs_debugfs_exit();
+        surffs_async_exit();
+        surffs_offload_exit();
+        surffs_hedge_exit();
+        surffs_stats_unregister();
+        surffs_destroy_caches();
         goto out;
     }
 
 out:
-    sfs_leave();
-    return 0;
+    return ret;
 }
 
 static void __exit surffs_exit(void)
 {
     int ret = 0;
 
-    sfs_enter();
     sfs_info("surffs_exit\n");
 
     free_webpages();
@@ -49,8 +111,15 @@ static void __exit surffs_exit(void)
         goto out;
     }
 
+    surffs_debugfs_exit();
+    surffs_async_exit();
+    surffs_offload_exit();
+    surffs_hedge_exit();
+    surffs_stats_unregister();
+    surffs_destroy_caches();
+
 out:
-    sfs_leave();
+    return;
 }
 
 module_init(surffs_init);
@@ -0,0 +1,89 @@
+#include "surffs_mem.h"
+#include "surffs_debug.h"
+#include "surffs_webpages.h"
+#include "surffs_inode.h"
+#include "surffs_sb.h"
+
+struct surffs_cache_desc
+{
+    const char *name;
+    size_t size;
+    struct kmem_cache *cachep;
+    atomic_long_t objects;
+};
+
+static struct surffs_cache_desc surffs_caches[SFS_CACHES_NUM] = {
+    [SFS_CACHE_WEB_PAGE]    = {"surffs_web_page",   sizeof(struct SURFFS_WEB_PAGE)},
+    [SFS_CACHE_HTML_LINK]   = {"surffs_html_link",  sizeof(struct SURFFS_HTML_LINK)},
+    [SFS_CACHE_INODE_FILE]  = {"surffs_inode_file", sizeof(struct SURFFS_INODE_PRIVATE)},
+    [SFS_CACHE_INODE_DIR]   = {"surffs_inode_dir",  sizeof(struct SURFFS_DIR_INODE_PRIVATE)},
+    [SFS_CACHE_INODE_LINK]  = {"surffs_inode_link", sizeof(struct SURFFS_LINK_INODE_PRIVATE)},
+    [SFS_CACHE_HASH_NODE]   = {"surffs_hash_node",  sizeof(struct string_hash_node)},
+};
+
+int surffs_init_caches(void)
+{
+    int ret = 0;
+    int i;
+
+    for (i = 0; i < SFS_CACHES_NUM; i++)
+    {
+        atomic_long_set(&surffs_caches[i].objects, 0);
+        surffs_caches[i].cachep = kmem_cache_create(surffs_caches[i].name,
+                                                    surffs_caches[i].size, 0, 0, NULL);
+        if (!surffs_caches[i].cachep) {ret = -ENOMEM; goto out;}
+    }
+
+out:
+    if (ret)
+    {
+        sfs_error("cannot create slab caches\n");
+        surffs_destroy_caches();
+    }
+
+    return ret;
+}
+
+void surffs_destroy_caches(void)
+{
+    int i;
+
+    for (i = 0; i < SFS_CACHES_NUM; i++)
+    {
+        if (surffs_caches[i].cachep) kmem_cache_destroy(surffs_caches[i].cachep);
+        surffs_caches[i].cachep = 0;
+    }
+}
+
+void *surffs_cache_zalloc(enum SURFFS_CACHE cache)
+{
+    void *obj;
+
+    obj = kmem_cache_zalloc(surffs_caches[cache].cachep, GFP_KERNEL);
+    if (obj) atomic_long_inc(&surffs_caches[cache].objects);
+
+    return obj;
+}
+
+void surffs_cache_free(enum SURFFS_CACHE cache, void *obj)
+{
+    if (!obj) return;
+
+    kmem_cache_free(surffs_caches[cache].cachep, obj);
+    atomic_long_dec(&surffs_caches[cache].objects);
+}
+
+const char *surffs_cache_name(enum SURFFS_CACHE cache)
+{
+    return surffs_caches[cache].name;
+}
+
+size_t surffs_cache_objsize(enum SURFFS_CACHE cache)
+{
+    return surffs_caches[cache].size;
+}
+
+long surffs_cache_objects(enum SURFFS_CACHE cache)
+{
+    return atomic_long_read(&surffs_caches[cache].objects);
+}
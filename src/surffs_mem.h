@@ -0,0 +1,32 @@
+#ifndef _SURFFS_MEM_H_
+#define _SURFFS_MEM_H_
+
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/slab.h>
+#include "surffs_arena.h"
+
+/*slab caches for fixed-size objects (see /proc/slabinfo)*/
+enum SURFFS_CACHE
+{
+    SFS_CACHE_WEB_PAGE = 0,
+    SFS_CACHE_HTML_LINK,
+    SFS_CACHE_INODE_FILE,
+    SFS_CACHE_INODE_DIR,
+    SFS_CACHE_INODE_LINK,
+    SFS_CACHE_HASH_NODE,
+    SFS_CACHES_NUM
+};
+
+int surffs_init_caches(void);
+void surffs_destroy_caches(void);
+
+void *surffs_cache_zalloc(enum SURFFS_CACHE cache);
+void surffs_cache_free(enum SURFFS_CACHE cache, void *obj);
+
+/*for memory statistics*/
+const char *surffs_cache_name(enum SURFFS_CACHE cache);
+size_t surffs_cache_objsize(enum SURFFS_CACHE cache);
+long surffs_cache_objects(enum SURFFS_CACHE cache);
+
+#endif
@@ -0,0 +1,118 @@
+#include "surffs_mirror.h"
+#include "surffs_localfile.h"
+#include "surffs_socket.h"
+#include "surffs_sb.h"
+#include "surffs_debug.h"
+#include <linux/fs.h>
+#include <linux/err.h>
+#include <linux/string.h>
+
+#define SURFFS_MIRROR_INDEX "index.html"
+
+/*path of web page relative to mirror, -ENOENT for paths leaving mirror*/
+static int mirror_file_name(const char *path, sfs_string *name)
+{
+    int ret = 0;
+    const char *seg;
+    size_t len;
+
+    ret = sfs_string_clear(name);
+    if (ret) return ret;
+
+    while (*path == '/') path++;
+
+    len = strcspn(path, "#");
+    ret = sfs_string_ncat(name, path, len);
+    if (ret) return ret;
+
+    for (seg = name->data; *seg; seg += len)
+    {
+        while (*seg == '/') seg++;
+        len = strcspn(seg, "/");
+        if (len == 2 && seg[0] == '.' && seg[1] == '.') return -ENOENT;
+    }
+
+    if (!name->textlen || name->data[name->textlen - 1] == '/')
+        ret = sfs_string_cat(name, SURFFS_MIRROR_INDEX);
+
+    return ret;
+}
+
+static struct file *mirror_open(struct surffs_local_dir *mirror, sfs_string *name)
+{
+    struct file *file;
+    int ret = 0;
+
+    file = surffs_local_open(mirror, name->data, O_RDONLY, 0);
+    if (IS_ERR(file) || !S_ISDIR(file_inode(file)->i_mode)) return file;
+
+    /*page of directory is its index*/
+    filp_close(file, 0);
+
+    ret = sfs_string_cat(name, "/" SURFFS_MIRROR_INDEX);
+    if (ret) return ERR_PTR(ret);
+
+    return surffs_local_open(mirror, name->data, O_RDONLY, 0);
+}
+
+static int file_fetch(struct surffs_sb_info *fsi,
+                      struct SURFFS_WEB_ADDRESS *address,
+                      struct surffs_validators *cond,
+                      sfs_string *http_response,
+                      char **http_payload_start,
+                      struct sfs_event_log *log)
+{
+    int ret = 0;
+    sfs_string name = {0};
+    struct file *file = 0;
+    int n;
+
+    ret = sfs_string_createz(&name, 256);
+    if (!ret) ret = sfs_string_clear(http_response);
+    if (ret) goto out;
+
+    ret = mirror_file_name(address->path.data, &name);
+    if (!ret)
+    {
+        file = mirror_open(&fsi->mirror, &name);
+        if (IS_ERR(file)) {ret = PTR_ERR(file); file = 0;}
+    }
+
+    if (ret == -ENOENT || ret == -ENOTDIR)
+    {
+        /*missing page is reported as by web server*/
+        ret = sfs_event_log_add(log, EV_FILE_ERROR, 0, 0, -ENOENT);
+        if (!ret) ret = sfs_string_cat(http_response, "HTTP/1.1 404 Not Found\r\n\r\n");
+        goto parse;
+    }
+    if (ret) goto error;
+
+    ret = sfs_string_cat(http_response, "HTTP/1.1 200 OK\r\n\r\n");
+    if (ret) goto out;
+
+    n = surffs_local_read_all(file, http_response);
+    if (n < 0) {ret = n; goto error;}
+
+    sfs_stat_add(&fsi->stats, SFS_STAT_BYTES_RECEIVED, n);
+    ret = sfs_event_log_add(log, EV_RECEIVED, 0, 0, n);
+
+parse:
+    if (ret) goto out;
+    ret = surffs_extract_http_payload(http_response, http_payload_start, log);
+    goto out;
+
+error:
+    sfs_event_log_add(log, EV_FILE_ERROR, 0, 0, ret);
+    sfs_stat_inc(&fsi->stats, SFS_STAT_ERR_DISK);
+
+out:
+    if (file) filp_close(file, 0);
+    sfs_string_free(&name);
+    return ret;
+}
+
+struct surffs_fetch_backend surffs_file_backend = {
+    .name   = "file",
+    .local  = 1,
+    .fetch  = file_fetch,
+};
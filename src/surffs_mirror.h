@@ -0,0 +1,14 @@
+#ifndef _SURFFS_MIRROR_H_
+#define _SURFFS_MIRROR_H_
+
+#include "surffs_fetch.h"
+
+/*
+ * "file" backend: pages are read from local mirror of site (as made by
+ * "wget -m"), directory of mirror is given by "-o mirror=..."
+ *     /a/b.html -> <mirror>/a/b.html
+ *     /a/       -> <mirror>/a/index.html, as well as /a if a is directory
+ */
+extern struct surffs_fetch_backend surffs_file_backend;
+
+#endif
@@ -0,0 +1,569 @@
+#include "surffs_offload.h"
+#include "surffs_socket.h"
+#include "surffs_sb.h"
+#include "surffs_debug.h"
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/jiffies.h>
+#include <linux/uaccess.h>
+#include <linux/capability.h>
+#include <linux/string.h>
+
+/*fetcher rechecks cancellation at least this often*/
+#define SURFFS_OFFLOAD_POLL_MS 100
+
+enum SURFFS_OFFLOAD_SLOT_STATE
+{
+    SLOT_FREE = 0,
+    SLOT_FILLING,           /*fetcher writes request*/
+    SLOT_QUEUED,            /*request waits for daemon to read it*/
+    SLOT_SENT,              /*daemon fetches page*/
+    SLOT_DONE,              /*reply is in, fetcher takes response*/
+    SLOT_ABANDONED          /*fetcher gave up, slot is free after reply*/
+};
+
+struct surffs_offload_slot
+{
+    enum SURFFS_OFFLOAD_SLOT_STATE state;
+    struct list_head queue;
+    wait_queue_head_t done;
+    struct surffs_fetchd_request req;
+    s32 error;
+    u32 len;
+};
+
+/*the only channel: one daemon serves all mounts*/
+static struct
+{
+    spinlock_t lock;
+    int connected;
+    u32 seq;
+    void *area;             /*allocated at the first open, kept until unload*/
+    struct list_head queue;
+    wait_queue_head_t readq;
+    wait_queue_head_t slotq;
+    unsigned long released; /*fetchers waiting for a free slot watch it*/
+    struct surffs_offload_slot slot[SURFFS_FETCHD_SLOTS];
+} channel;
+
+/*called with lock held*/
+static void slot_free(struct surffs_offload_slot *slot)
+{
+    slot->state = SLOT_FREE;
+    channel.released++;
+    wake_up_all(&channel.slotq);
+}
+
+/*called with lock held*/
+static void slot_complete(struct surffs_offload_slot *slot, s32 error, u32 len)
+{
+    if (slot->state == SLOT_ABANDONED)
+    {
+        slot_free(slot);
+        return;
+    }
+
+    slot->error = error;
+    slot->len = len;
+    slot->state = SLOT_DONE;
+    wake_up(&slot->done);
+}
+
+static int fetchd_open(struct inode *inode, struct file *file)
+{
+    int ret = 0;
+    void *area = 0;
+
+    if (!capable(CAP_SYS_ADMIN)) return -EPERM;
+
+    if (!ACCESS_ONCE(channel.area))
+    {
+        area = vmalloc_user(SURFFS_FETCHD_AREA_SIZE);
+        if (!area) return -ENOMEM;
+    }
+
+    spin_lock(&channel.lock);
+    if (channel.connected)
+    {
+        ret = -EBUSY;
+        goto out;
+    }
+    if (!channel.area)
+    {
+        channel.area = area;
+        area = 0;
+    }
+    channel.connected = 1;
+
+out:
+    spin_unlock(&channel.lock);
+    if (area) vfree(area);
+
+    if (!ret) sfs_info("fetch daemon %d connected\n", current->pid);
+
+    return ret;
+}
+
+/*daemon is gone: requests in flight are fetched from kernel*/
+static int fetchd_release(struct inode *inode, struct file *file)
+{
+    struct surffs_offload_slot *slot;
+    int i;
+
+    spin_lock(&channel.lock);
+    channel.connected = 0;
+    for (i = 0; i < SURFFS_FETCHD_SLOTS; i++)
+    {
+        slot = &channel.slot[i];
+        if (slot->state == SLOT_QUEUED) list_del_init(&slot->queue);
+        if (slot->state == SLOT_QUEUED || slot->state == SLOT_SENT ||
+            slot->state == SLOT_ABANDONED)
+            slot_complete(slot, -ENODEV, 0);
+    }
+    /*fetchers waiting for a slot fall back too*/
+    channel.released++;
+    wake_up_all(&channel.slotq);
+    spin_unlock(&channel.lock);
+
+    sfs_info("fetch daemon disconnected\n");
+
+    return 0;
+}
+
+static ssize_t fetchd_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+    ssize_t ret = 0;
+    size_t done = 0;
+    struct surffs_offload_slot *slot;
+
+    if (count < sizeof(struct surffs_fetchd_request)) return -EINVAL;
+
+    while (done + sizeof(struct surffs_fetchd_request) <= count)
+    {
+        spin_lock(&channel.lock);
+        slot = list_first_entry_or_null(&channel.queue, struct surffs_offload_slot, queue);
+        if (slot)
+        {
+            list_del_init(&slot->queue);
+            slot->state = SLOT_SENT;
+        }
+        spin_unlock(&channel.lock);
+
+        if (!slot)
+        {
+            if (done) break;
+            if (file->f_flags & O_NONBLOCK) return -EAGAIN;
+
+            ret = wait_event_interruptible(channel.readq, !list_empty(&channel.queue));
+            if (ret) return ret;
+            continue;
+        }
+
+        /*request of sent slot does not change until reply*/
+        if (copy_to_user(buf + done, &slot->req, sizeof(slot->req)))
+        {
+            spin_lock(&channel.lock);
+            slot_complete(slot, -ENODEV, 0);
+            spin_unlock(&channel.lock);
+            return done ? done : -EFAULT;
+        }
+        done += sizeof(struct surffs_fetchd_request);
+    }
+
+    return done;
+}
+
+static ssize_t fetchd_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+    int ret = 0;
+    size_t done = 0;
+    struct surffs_fetchd_reply reply;
+    struct surffs_offload_slot *slot;
+
+    if (count < sizeof(reply)) return -EINVAL;
+
+    for (; done + sizeof(reply) <= count; done += sizeof(reply))
+    {
+        if (copy_from_user(&reply, buf + done, sizeof(reply)))
+        {
+            ret = -EFAULT;
+            break;
+        }
+
+        if (reply.slot >= SURFFS_FETCHD_SLOTS || reply.len > SURFFS_FETCHD_SLOT_SIZE ||
+            reply.error > 0)
+        {
+            ret = -EINVAL;
+            break;
+        }
+
+        slot = &channel.slot[reply.slot];
+
+        spin_lock(&channel.lock);
+        /*late reply to a reused slot has old seq*/
+        if (slot->req.seq != reply.seq ||
+            (slot->state != SLOT_SENT && slot->state != SLOT_ABANDONED))
+            ret = -EINVAL;
+        else
+            slot_complete(slot, reply.error, reply.len);
+        spin_unlock(&channel.lock);
+
+        if (ret) break;
+    }
+
+    return done ? done : ret;
+}
+
+static unsigned int fetchd_poll(struct file *file, poll_table *wait)
+{
+    unsigned int mask = POLLOUT | POLLWRNORM;
+
+    poll_wait(file, &channel.readq, wait);
+
+    if (!list_empty(&channel.queue)) mask |= POLLIN | POLLRDNORM;
+
+    return mask;
+}
+
+static int fetchd_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    if (vma->vm_pgoff || vma->vm_end - vma->vm_start > SURFFS_FETCHD_AREA_SIZE)
+        return -EINVAL;
+
+    return remap_vmalloc_range(vma, channel.area, 0);
+}
+
+static const struct file_operations fetchd_fops = {
+    .owner      = THIS_MODULE,
+    .open       = fetchd_open,
+    .release    = fetchd_release,
+    .read       = fetchd_read,
+    .write      = fetchd_write,
+    .poll       = fetchd_poll,
+    .mmap       = fetchd_mmap,
+    .llseek     = noop_llseek,
+};
+
+static struct miscdevice fetchd_device = {
+    .minor      = MISC_DYNAMIC_MINOR,
+    .name       = "surffs-fetch",
+    .fops       = &fetchd_fops,
+    .mode       = S_IRUSR | S_IWUSR,
+};
+
+int surffs_offload_init(void)
+{
+    int ret = 0;
+    int i;
+
+    spin_lock_init(&channel.lock);
+    INIT_LIST_HEAD(&channel.queue);
+    init_waitqueue_head(&channel.readq);
+    init_waitqueue_head(&channel.slotq);
+
+    for (i = 0; i < SURFFS_FETCHD_SLOTS; i++)
+    {
+        channel.slot[i].state = SLOT_FREE;
+        INIT_LIST_HEAD(&channel.slot[i].queue);
+        init_waitqueue_head(&channel.slot[i].done);
+    }
+
+    ret = misc_register(&fetchd_device);
+    if (ret) sfs_error("error register device %s, error code %d\n", fetchd_device.name, ret);
+
+    return ret;
+}
+
+void surffs_offload_exit(void)
+{
+    misc_deregister(&fetchd_device);
+
+    vfree(channel.area);
+    channel.area = 0;
+}
+
+static int offload_interrupted(struct surffs_http_ctl *ctl)
+{
+    if (ctl && ACCESS_ONCE(ctl->cancelled)) return -ECANCELED;
+    if (fatal_signal_pending(current)) return -EINTR;
+    if (signal_pending(current)) return -ERESTARTSYS;
+    return 0;
+}
+
+/*jiffies to sleep before the next check, 0 if deadline (0 - none) has passed*/
+static long offload_wait_jiffies(unsigned long deadline)
+{
+    long timeout = msecs_to_jiffies(SURFFS_OFFLOAD_POLL_MS);
+
+    if (!deadline) return timeout;
+    if (time_after_eq(jiffies, deadline)) return 0;
+
+    return min(timeout, (long)(deadline - jiffies));
+}
+
+/*daemon is given connect, ttfb and transfer timeouts of mount together*/
+static unsigned int offload_timeout_ms(struct surffs_sb_info *fsi)
+{
+    unsigned int transfer = surffs_timeout_ms(&fsi->timeouts, SFS_TOUT_TRANSFER);
+
+    if (!transfer) return 0;
+
+    return surffs_timeout_ms(&fsi->timeouts, SFS_TOUT_CONNECT) +
+           surffs_timeout_ms(&fsi->timeouts, SFS_TOUT_TTFB) + transfer;
+}
+
+/*-ENODEV if value does not fit daemon request*/
+static int copy_field(char *field, size_t size, sfs_string *value)
+{
+    if (value->textlen >= size) return -ENODEV;
+
+    if (value->textlen) memcpy(field, value->data, value->textlen);
+    field[value->textlen] = 0;
+
+    return 0;
+}
+
+static int copy_text(char *field, size_t size, const char *text)
+{
+    size_t len = strlen(text);
+
+    if (len >= size) return -ENODEV;
+
+    memcpy(field, text, len + 1);
+
+    return 0;
+}
+
+static int fill_request(struct surffs_fetchd_request *req, struct surffs_sb_info *fsi,
+                        char *ip, u16 port, char *host, char *path,
+                        struct surffs_validators *cond)
+{
+    int ret = 0;
+
+    /*protocol of daemon has no ranges and HEAD requests, kernel sends them*/
+    if (cond && (cond->range || cond->head)) return -ENODEV;
+
+    req->port = port;
+    req->reserved = 0;
+    req->timeout_ms = offload_timeout_ms(fsi);
+
+    ret = copy_text(req->ip, sizeof(req->ip), ip);
+    if (!ret) ret = copy_text(req->host, sizeof(req->host), host);
+    if (!ret) ret = copy_text(req->path, sizeof(req->path), path);
+    if (ret) return ret;
+
+    req->etag[0] = 0;
+    req->last_modified[0] = 0;
+    if (cond)
+    {
+        ret = copy_field(req->etag, sizeof(req->etag), &cond->etag);
+        if (!ret) ret = copy_field(req->last_modified, sizeof(req->last_modified),
+                                   &cond->last_modified);
+    }
+
+    return ret;
+}
+
+/*takes free slot, waits while all of them are busy*/
+static int offload_slot_get(struct surffs_http_ctl *ctl, unsigned long deadline,
+                            struct surffs_offload_slot **slot)
+{
+    int ret = 0;
+    int i;
+    unsigned long released;
+    long timeout;
+
+    *slot = 0;
+
+    while (1)
+    {
+        spin_lock(&channel.lock);
+        released = channel.released;
+        if (!channel.connected) ret = -ENODEV;
+        for (i = 0; !ret && i < SURFFS_FETCHD_SLOTS; i++)
+        {
+            if (channel.slot[i].state == SLOT_FREE)
+            {
+                *slot = &channel.slot[i];
+                (*slot)->state = SLOT_FILLING;
+                break;
+            }
+        }
+        spin_unlock(&channel.lock);
+
+        if (ret || *slot) break;
+
+        ret = offload_interrupted(ctl);
+        if (ret) break;
+
+        timeout = offload_wait_jiffies(deadline);
+        if (!timeout)
+        {
+            ret = -ETIMEDOUT;
+            break;
+        }
+
+        wait_event_interruptible_timeout(channel.slotq,
+                                         ACCESS_ONCE(channel.released) != released,
+                                         timeout);
+    }
+
+    return ret;
+}
+
+/*queues filled slot to daemon, -ENODEV if daemon is gone meanwhile*/
+static int offload_slot_queue(struct surffs_offload_slot *slot)
+{
+    int ret = 0;
+
+    spin_lock(&channel.lock);
+    if (!channel.connected)
+    {
+        slot_free(slot);
+        ret = -ENODEV;
+        goto out;
+    }
+
+    slot->req.slot = slot - channel.slot;
+    slot->req.seq = ++channel.seq;
+    slot->state = SLOT_QUEUED;
+    list_add_tail(&slot->queue, &channel.queue);
+    wake_up(&channel.readq);
+
+out:
+    spin_unlock(&channel.lock);
+    return ret;
+}
+
+static int offload_slot_wait(struct surffs_offload_slot *slot, struct surffs_http_ctl *ctl,
+                             unsigned long deadline)
+{
+    int ret = 0;
+    long timeout;
+
+    while (ACCESS_ONCE(slot->state) != SLOT_DONE)
+    {
+        ret = offload_interrupted(ctl);
+        if (ret) break;
+
+        timeout = offload_wait_jiffies(deadline);
+        if (!timeout)
+        {
+            ret = -ETIMEDOUT;
+            break;
+        }
+
+        wait_event_interruptible_timeout(slot->done, ACCESS_ONCE(slot->state) == SLOT_DONE,
+                                         timeout);
+    }
+
+    /*reply is read after state*/
+    smp_rmb();
+
+    return ret;
+}
+
+/*fetcher leaves slot: with request in daemon slot is freed by reply*/
+static void offload_slot_put(struct surffs_offload_slot *slot)
+{
+    spin_lock(&channel.lock);
+    if (slot->state == SLOT_QUEUED) list_del_init(&slot->queue);
+    if (slot->state == SLOT_SENT)
+        slot->state = SLOT_ABANDONED;
+    else
+        slot_free(slot);
+    spin_unlock(&channel.lock);
+}
+
+int surffs_offload_get_http(struct surffs_sb_info *fsi,
+                            char *ip, u16 port, char *host, char *path,
+                            struct surffs_validators *cond,
+                            sfs_string *http_response,
+                            char **http_payload_start,
+                            struct sfs_event_log *log,
+                            int *origin_failed,
+                            struct surffs_http_ctl *ctl)
+{
+    int ret = 0;
+    struct surffs_offload_slot *slot = 0;
+    unsigned int timeout_ms = offload_timeout_ms(fsi);
+    unsigned long deadline = 0;
+
+    *http_payload_start = 0;
+    *origin_failed = 1;
+
+    if (!ACCESS_ONCE(channel.connected)) return -ENODEV;
+
+    ret = sfs_string_clear(http_response);
+    if (ret) goto out;
+
+    if (timeout_ms) deadline = (jiffies + msecs_to_jiffies(timeout_ms)) | 1;
+
+    ret = offload_slot_get(ctl, deadline, &slot);
+    if (ret) goto out;
+
+    ret = fill_request(&slot->req, fsi, ip, port, host, path, cond);
+    if (ret)
+    {
+        offload_slot_put(slot);
+        slot = 0;
+        goto out;
+    }
+
+    ret = offload_slot_queue(slot);
+    if (ret)
+    {
+        slot = 0;
+        goto out;
+    }
+
+    ret = sfs_event_log_add(log, EV_OFFLOADED, 0, 0, slot->req.slot);
+    if (!ret) ret = offload_slot_wait(slot, ctl, deadline);
+    if (ret) goto out;
+
+    /*-EFBIG: response does not fit slot*/
+    if (slot->error == -ENODEV || slot->error == -EFBIG)
+    {
+        ret = -ENODEV;
+        goto out;
+    }
+
+    if (slot->error)
+    {
+        sfs_stat_inc(&fsi->stats, SFS_STAT_ERR_RECV);
+        ret = sfs_event_log_add(log, EV_OFFLOAD_ERROR, 0, 0, slot->error);
+        goto out;
+    }
+
+    surffs_http_ctl_first_byte(ctl);
+
+    ret = sfs_string_ncat(http_response,
+                          channel.area + (slot - channel.slot) * SURFFS_FETCHD_SLOT_SIZE,
+                          slot->len);
+    if (ret) goto out;
+
+    sfs_stat_inc(&fsi->stats, SFS_STAT_OFFLOADED);
+    sfs_stat_add(&fsi->stats, SFS_STAT_BYTES_RECEIVED, slot->len);
+    ret = sfs_event_log_add(log, EV_RECEIVED, 0, 0, slot->len);
+    if (ret) goto out;
+
+    *origin_failed = 0;
+
+    ret = surffs_extract_http_payload(http_response, http_payload_start, log);
+
+out:
+    if (ret == -ETIMEDOUT)
+    {
+        /*like timeout of kernel fetch: origin failed, no response*/
+        sfs_stat_inc(&fsi->stats, SFS_STAT_ERR_TIMEOUT);
+        ret = sfs_event_log_add(log, EV_TIMEOUT, SFS_TOUT_TRANSFER, 0, timeout_ms);
+    }
+    if (slot) offload_slot_put(slot);
+
+    return ret;
+}
@@ -0,0 +1,40 @@
+#ifndef _SURFFS_OFFLOAD_H_
+#define _SURFFS_OFFLOAD_H_
+
+#include <linux/kernel.h>
+#include "surffs_helpers.h"
+#include "surffs_eventlog.h"
+#include "surffs_fetchd.h"
+
+/*
+ * Fetch offload (mount option offload): http requests of mount are queued
+ * to a userspace daemon through misc device /dev/surffs-fetch instead of
+ * being sent from kernel. Daemon writes responses into slots of a buffer
+ * it maps, so they are not copied through write(). Up to
+ * SURFFS_FETCHD_SLOTS requests are in flight, more wait for a free slot.
+ * Without daemon, when daemon exits with requests in flight, or when
+ * response does not fit slot, page is fetched from kernel as usual.
+ * Origins, breaker and rate limiter of mount apply either way.
+ */
+
+struct surffs_sb_info;
+struct surffs_validators;
+struct surffs_http_ctl;
+
+int  surffs_offload_init(void);
+void surffs_offload_exit(void);
+
+/*
+ * like surffs_get_http(), but fetched by daemon; -ENODEV if page is to be
+ * fetched from kernel
+ */
+int surffs_offload_get_http(struct surffs_sb_info *fsi,
+                            char *ip, u16 port, char *host, char *path,
+                            struct surffs_validators *cond,
+                            sfs_string *http_response,
+                            char **http_payload_start,
+                            struct sfs_event_log *log,
+                            int *origin_failed,
+                            struct surffs_http_ctl *ctl);
+
+#endif
@@ -2,14 +2,16 @@
 #include "surffs_debug.h"
 #include "surffs_inode.h"
 #include "surffs_dentry.h"
+#include "surffs_sb.h"
 
 const struct super_operations surffs_sb_ops = {
-    .statfs         = simple_statfs,
+    .statfs         = surffs_statfs,
     .drop_inode     = surffs_delete_inode,
     .show_options	= generic_show_options
 };
 
 const struct file_operations surffs_file_dir_ops = {
+    .open		= surffs_dir_open,
     .llseek		= generic_file_llseek,
     .read		= generic_read_dir,
     .iterate	= surffs_readdir,
@@ -17,10 +19,13 @@ const struct file_operations surffs_file_dir_ops = {
 };
 
 const struct file_operations surffs_file_reg_ops = {
+    .open		= surffs_file_open,
+    .release	= surffs_file_release,
     .llseek		= generic_file_llseek,
     .read		= do_sync_read,
     .write		= do_sync_write,
     .aio_read	= surffs_aio_read,
+    .poll		= surffs_file_poll,
     .mmap		= generic_file_mmap,
     .fsync		= noop_fsync,
     .splice_read	= generic_file_splice_read,
@@ -50,6 +55,3 @@ const struct inode_operations surffs_symlink_inode_operations = {
     .getattr     = simple_getattr,
 };
 
-
-
-
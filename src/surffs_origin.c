@@ -0,0 +1,133 @@
+#include "surffs_origin.h"
+#include "surffs_debug.h"
+#include <linux/string.h>
+#include <linux/inet.h>
+#include <linux/jiffies.h>
+
+void surffs_origins_init(struct surffs_origins *origins)
+{
+    memset(origins, 0, sizeof(*origins));
+    spin_lock_init(&origins->lock);
+}
+
+int surffs_origins_parse(struct surffs_origins *origins, const char *list)
+{
+    int ret = 0;
+    const char *start = list;
+    const char *end;
+    size_t len;
+    u8 addr[4];
+
+    origins->count = 0;
+
+    while (1)
+    {
+        end = strchrnul(start, ':');
+        len = end - start;
+
+        if (origins->count == SURFFS_MAX_ORIGINS)
+        {
+            sfs_error("too many ip addresses, max %d\n", SURFFS_MAX_ORIGINS);
+            ret = -EINVAL;
+            goto out;
+        }
+
+        if (!len || len >= sizeof(origins->origin[0].ip) ||
+            !in4_pton(start, len, addr, -1, NULL))
+        {
+            sfs_error("invalid ip address '%.*s'\n", (int)len, start);
+            ret = -EINVAL;
+            goto out;
+        }
+
+        memcpy(origins->origin[origins->count].ip, start, len);
+        origins->origin[origins->count].ip[len] = 0;
+        atomic_set(&origins->origin[origins->count].inflight, 0);
+        origins->count++;
+
+        if (!*end) break;
+        start = end + 1;
+    }
+
+out:
+    return ret;
+}
+
+/*called with lock held*/
+static int origin_available(struct surffs_origin *origin)
+{
+    return !origin->down_until || time_after_eq(jiffies, origin->down_until);
+}
+
+int surffs_origin_is_down(struct surffs_origin *origin)
+{
+    return !origin_available(origin);
+}
+
+struct surffs_origin *surffs_origin_get(struct surffs_origins *origins,
+                                        unsigned long tried)
+{
+    struct surffs_origin *best = 0;
+    struct surffs_origin *fallback = 0;
+    struct surffs_origin *o;
+    int i;
+    int n;
+
+    spin_lock(&origins->lock);
+
+    for (n = 0; n < origins->count; n++)
+    {
+        i = (origins->next + n) % origins->count;
+        o = &origins->origin[i];
+        if (tried & (1UL << i)) continue;
+
+        if (!origin_available(o))
+        {
+            if (!fallback) fallback = o;
+            continue;
+        }
+
+        if (!best) best = o;
+        if (origins->policy == SFS_LB_RR) break;
+        if (atomic_read(&o->inflight) < atomic_read(&best->inflight)) best = o;
+    }
+
+    if (!best) best = fallback;
+    if (best)
+    {
+        origins->next = surffs_origin_index(origins, best) + 1;
+        atomic_inc(&best->inflight);
+        best->fetches++;
+    }
+
+    spin_unlock(&origins->lock);
+
+    return best;
+}
+
+void surffs_origin_put(struct surffs_origins *origins,
+                       struct surffs_origin *origin, int failed)
+{
+    spin_lock(&origins->lock);
+
+    atomic_dec(&origin->inflight);
+
+    if (failed)
+    {
+        origin->failures++;
+        origin->fails++;
+        if (origin->fails >= SURFFS_ORIGIN_FAILS_DOWN)
+        {
+            if (!surffs_origin_is_down(origin))
+                sfs_warning("origin %s is down after %u failures\n", origin->ip, origin->fails);
+            origin->down_until = jiffies + msecs_to_jiffies(SURFFS_ORIGIN_RETRY_MS);
+        }
+    }
+    else
+    {
+        origin->fails = 0;
+        origin->down_until = 0;
+    }
+
+    spin_unlock(&origins->lock);
+}
@@ -0,0 +1,69 @@
+#ifndef _SURFFS_ORIGIN_H_
+#define _SURFFS_ORIGIN_H_
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/spinlock.h>
+#include <linux/atomic.h>
+
+/*
+ * Replicas of mounted site ("ip=a.b.c.d:e.f.g.h:..."). Every fetch takes one
+ * origin by policy of mount (lb=rr - round-robin, lb=lo - least outstanding
+ * fetches) and fails over to the next one if origin cannot be reached.
+ * After SURFFS_ORIGIN_FAILS_DOWN consecutive failures origin is down and is
+ * not taken for SURFFS_ORIGIN_RETRY_MS, then it is tried again. When all
+ * origins are down they are still tried rather than failing fetch at once.
+ */
+#define SURFFS_MAX_ORIGINS          16
+#define SURFFS_ORIGIN_FAILS_DOWN    3
+#define SURFFS_ORIGIN_RETRY_MS      10000
+
+enum SURFFS_LB_POLICY
+{
+    SFS_LB_RR = 0,
+    SFS_LB_LO
+};
+
+struct surffs_origin
+{
+    char ip[16];
+    atomic_t inflight;
+
+    /*protected by lock of surffs_origins*/
+    u32 fails;
+    unsigned long down_until;
+    u64 fetches;
+    u64 failures;
+};
+
+struct surffs_origins
+{
+    struct surffs_origin origin[SURFFS_MAX_ORIGINS];
+    int count;
+    enum SURFFS_LB_POLICY policy;
+
+    spinlock_t lock;
+    unsigned int next;
+};
+
+void surffs_origins_init(struct surffs_origins *origins);
+int  surffs_origins_parse(struct surffs_origins *origins, const char *list);
+
+/*
+ * takes origin not in tried mask (bit per origin index), NULL if all were
+ * tried. Origin must be returned by surffs_origin_put()
+ */
+struct surffs_origin *surffs_origin_get(struct surffs_origins *origins,
+                                        unsigned long tried);
+void surffs_origin_put(struct surffs_origins *origins,
+                       struct surffs_origin *origin, int failed);
+
+static inline int surffs_origin_index(struct surffs_origins *origins,
+                                      struct surffs_origin *origin)
+{
+    return origin - origins->origin;
+}
+
+int surffs_origin_is_down(struct surffs_origin *origin);
+
+#endif
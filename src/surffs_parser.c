@@ -45,7 +45,6 @@ static void find_spaced_patterns(const char *str,
     *found_start = 0;
     *found_end = 0;
 
-    sfs_enter();
     if (patterns_cnt < 2) goto out;
 
     while (!start || !end)
@@ -69,11 +68,9 @@ static void find_spaced_patterns(const char *str,
     *found_end = (char*)end;
 
 out:
-    sfs_leave();
+    return;
 }
 
-
-
 static void trim(sfs_string *str, const char *chars)
 {
     char *c;
@@ -86,7 +83,6 @@ static void trim(sfs_string *str, const char *chars)
     for (; (*start) && is_anyof(*start, chars); start++);
     for (; (end > start) && (*end-1) && is_anyof(*(end-1), chars); end--);
 
-
     if (end < start) return;
 
     if (end == start)
@@ -103,8 +99,6 @@ static void trim(sfs_string *str, const char *chars)
     str->textlen = end - start;
 }
 
-
-
 int extract_url_params(const char *url,
                        sfs_string *protocol, sfs_string *host, sfs_string *path,
                        enum EXTRACT_PARAMS_POLICY extract_policy)
@@ -113,9 +107,6 @@ int extract_url_params(const char *url,
     char *found;
     const char *pos = url;
 
-    sfs_enter();
-    sfs_trace("extract_url_params, url = '%s'\n", url);
-
     ret = sfs_string_clear(protocol); if (ret) goto out;
     ret = sfs_string_clear(host); if (ret) goto out;
     ret = sfs_string_clear(path); if (ret) goto out;
@@ -153,11 +144,7 @@ int extract_url_params(const char *url,
         if (ret) goto out;
     }
 
-    sfs_trace("extract_url_params result: protocol = '%s' host = '%s' path = '%s'\n",
-              protocol->data, host->data, path->data);
-
 out:
-    sfs_leave();
     return ret;
 }
 
@@ -170,9 +157,6 @@ static int extract_link_href(const char *text, sfs_string *href)
     char *start = 0;
     char *end = 0;
 
-    sfs_enter();
-    sfs_trace("extract_link_href from text = '%s'\n", text);
-
     ret = sfs_string_clear(href);
     if (ret) goto out;
 
@@ -199,10 +183,7 @@ static int extract_link_href(const char *text, sfs_string *href)
 
     trim(href, " \"\'");
 
-    sfs_trace("extract_link_href result: '%s'\n", href->data);
-
 out:
-    sfs_leave();
     return ret;
 }
 
@@ -218,46 +199,27 @@ static int normalize_title(sfs_string *title)
     int ret = 0;
     char do_delete = 0;
     size_t i,k;
-    char *tmpbuf = 0;
-
-    sfs_enter();
-    sfs_trace("normalize_title: '%s'\n", title->data);
+    char c;
 
     if (!title->textlen) goto out;
 
-    tmpbuf = kmalloc(title->textlen + 1, GFP_KERNEL);
-    if (!tmpbuf) {ret = -ENOMEM; goto out;}
-
-    for (i = 0; i < title->textlen; i++)
+    /*output never outruns input, so the string is rewritten in place*/
+    for (i = 0, k = 0; i < title->textlen; i++)
     {
-        if (title->data[i] == '<') do_delete = 1;
+        c = title->data[i];
+        if (c == '<') do_delete = 1;
 
-        if (do_delete)
-            tmpbuf[i] = '\b';
-        else if (is_illegal_title_char(title->data[i]))
-            tmpbuf[i] = ' ';
-        else
-            tmpbuf[i] = title->data[i];
-
-        if (title->data[i] == '>') do_delete = 0;
-    }
-    tmpbuf[i] = 0;
+        if (!do_delete)
+            title->data[k++] = is_illegal_title_char(c) ? ' ' : c;
 
-    for (i = 0, k = 0; i < title->textlen; i++)
-    {
-        if (tmpbuf[i] != '\b')
-            title->data[k++] = tmpbuf[i];
+        if (c == '>') do_delete = 0;
     }
     title->data[k] = 0;
     title->textlen = k;
 
     trim(title, " ");
 
-    sfs_trace("normalize_title result: '%s'\n", title->data);
-
 out:
-    if (tmpbuf) kfree(tmpbuf);
-    sfs_leave();
     return ret;
 }
 
@@ -270,9 +232,6 @@ static int extract_link_title(const char *text, sfs_string *title)
     char *title_end;
     const char *end_atag_patterns[] = {"<","/a",">"};
 
-    sfs_enter();
-    sfs_trace("extract_link_title from text '%s'\n", text);
-
     ret = sfs_string_clear(title); if (ret) goto out;
 
     start = strchr(text, '>');
@@ -284,10 +243,8 @@ static int extract_link_title(const char *text, sfs_string *title)
     title_end = start;
 
     sfs_string_ncat(title, title_start, title_end - title_start);
-    sfs_trace("extract_link_title result: '%s'\n", title->data);
 
 out:
-    sfs_leave();
     return ret;
 }
 
@@ -299,12 +256,14 @@ int extract_html_link_params(const char *text, struct SURFFS_HTML_LINK *link)
     int ret = 0;
     sfs_string tmp = {0};
 
-    sfs_enter();
-    sfs_trace("extract_html_link_params from text '%s'\n", text);
-
     ret = sfs_string_createz(&tmp, 128);
     if (ret) goto out;
 
+    ret = sfs_string_clear(&link->full_url); if (ret) goto out;
+    ret = sfs_string_clear(&link->protocol); if (ret) goto out;
+    ret = sfs_string_clear(&link->host); if (ret) goto out;
+    ret = sfs_string_clear(&link->path); if (ret) goto out;
+
     ret = extract_link_title(text, &link->title);
     if (ret) goto out;
 
@@ -313,17 +272,13 @@ int extract_html_link_params(const char *text, struct SURFFS_HTML_LINK *link)
 
     if (!link->title.textlen)
     {
-        sfs_trace("cannot get link title from link '%s'\n", text);
         goto out;
     }
 
-
-
     ret = extract_link_href(text, &link->full_url);
     if (ret) {goto out;}
     if (!link->full_url.textlen)
     {
-        sfs_trace("cannot get link url from link '%s'\n", text);
         goto out;
     }
 
@@ -335,17 +290,14 @@ int extract_html_link_params(const char *text, struct SURFFS_HTML_LINK *link)
     if (ret) {goto out;}
     if (!link->path.textlen)
     {
-        sfs_trace("cannot get link path from link '%s'\n", text);
         goto out;
     }
 
-
     ret = SURFFS_HTML_LINK_print(link, &tmp); if (ret) goto out;
-    sfs_trace("extract_html_link_params result: %s\n", tmp.data);
 
 out:
     sfs_string_free(&tmp);
-    sfs_leave();
+
     return ret;
 }
 
@@ -363,9 +315,6 @@ int extract_html_block(const char **textpos, const char *html_tag, sfs_string *b
     const char *start_patterns[] = {"<", html_tag};
     const char *end_patterns[] = {"<", "/", html_tag, ">"};
 
-    sfs_enter();
-    sfs_trace("extract_html_block: %s\n", html_tag);
-
     ret = sfs_string_clear(block); if (ret) goto out;
 
     find_spaced_patterns(p, start_patterns, 2, &start, &end);
@@ -373,24 +322,16 @@ int extract_html_block(const char **textpos, const char *html_tag, sfs_string *b
     block_start = start;
     p = end;
 
-
     find_spaced_patterns(p, end_patterns, 4, &start, &end);
     if (!start) goto out;
     block_end = end;
     p = end;
 
-
     ret = sfs_string_ncat(block, block_start, block_end - block_start);
     if (ret) goto out;
     *textpos = p;
 
-    sfs_trace("extract_html_block result: '%s'\n", block->data);
-
 out:
-    sfs_leave();
     return ret;
 }
 
-
-
-
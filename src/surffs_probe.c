@@ -0,0 +1,111 @@
+#include "surffs_probe.h"
+#include "surffs_inode.h"
+#include "surffs_sb.h"
+#include "surffs_socket.h"
+#include "surffs_fetch.h"
+#include "surffs_redirect.h"
+#include "surffs_stats.h"
+#include "surffs_debug.h"
+#include <linux/slab.h>
+#include <linux/string.h>
+
+void surffs_probe_free(struct surffs_head_probe *probe)
+{
+    kfree(probe);
+}
+
+static int head_request(struct surffs_sb_info *fsi, sfs_string *webpath,
+                        struct surffs_head_probe **probe)
+{
+    int ret = 0;
+    struct surffs_head_probe *p = 0;
+    struct SURFFS_WEB_ADDRESS address;
+    struct surffs_validators cond = {{0}, {0}};
+    struct sfs_arena arena;
+    struct sfs_event_log log;
+    sfs_string path_buf = {0};
+    sfs_string resp = {0};
+    sfs_string length = {0};
+    sfs_string *target;
+    char *payload = 0;
+    long long len;
+
+    sfs_arena_init(&arena);
+    sfs_event_log_init(&log, &arena);
+
+    /*known redirect: page is at its target*/
+    target = surffs_redirect_find(&fsi->redirects, webpath->data);
+    if (target) webpath = target;
+
+    ret = surffs_webpath_address(fsi, webpath, &address, &path_buf);
+    if (ret) goto out;
+
+    p = kzalloc(sizeof(struct surffs_head_probe), GFP_KERNEL);
+    if (!p) {ret = -ENOMEM; goto out;}
+
+    ret = sfs_string_createz(&resp, 512);
+    if (ret) goto out;
+
+    cond.head = 1;
+    sfs_stat_inc(&fsi->stats, SFS_STAT_HEAD_PROBES);
+
+    ret = surffs_fetch(fsi, &address, &cond, &resp, &payload, &log);
+    if (ret) goto out;
+
+    p->status = surffs_http_status(&resp);
+    p->len = -1;
+
+    ret = surffs_http_header(&resp, "Content-Length", &length);
+    if (ret) goto out;
+    if (length.textlen && !kstrtoll(length.data, 10, &len) && len >= 0) p->len = len;
+
+    /*backend without HEAD (local mirror) gives body, only its length is taken*/
+    if (payload && p->len < 0) p->len = resp.textlen - (payload - resp.data);
+
+    *probe = p;
+    p = 0;
+
+out:
+    surffs_probe_free(p);
+    sfs_string_free(&path_buf);
+    sfs_string_free(&resp);
+    sfs_string_free(&length);
+    sfs_arena_free(&arena);
+
+    return ret;
+}
+
+/*page would be this response: no redirect to follow, size is known*/
+static int probe_usable(struct surffs_head_probe *probe)
+{
+    return (probe->status == 200 && probe->len >= 0) || probe->status >= 400;
+}
+
+int surffs_probe_dir(struct inode *dir, struct surffs_head_probe **probe)
+{
+    int ret = 0;
+    struct SURFFS_DIR_INODE_PRIVATE *prvt = SURFFS_DIR_INODE(dir);
+
+    if (!prvt->probe)
+    {
+        ret = head_request(SURFFS_SB(dir->i_sb), &prvt->webPath, &prvt->probe);
+        if (ret) goto out;
+    }
+
+    if (!probe_usable(prvt->probe)) {ret = -EAGAIN; goto out;}
+
+    *probe = prvt->probe;
+
+out:
+    return ret;
+}
+
+const char *surffs_probe_status(struct surffs_head_probe *probe)
+{
+    return (probe->status == 200 && probe->len > 0) ? STATUS_OK_STR : STATUS_HTTP_ERROR_STR;
+}
+
+loff_t surffs_probe_page_size(struct surffs_head_probe *probe)
+{
+    return probe->status == 200 ? probe->len : 0;
+}
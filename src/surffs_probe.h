@@ -0,0 +1,35 @@
+#ifndef _SURFFS_PROBE_H_
+#define _SURFFS_PROBE_H_
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include "surffs_helpers.h"
+
+/*
+ * HEAD probing (mount option head_probe): lookup of page.html or status of
+ * a directory which page is not fetched yet sends HEAD instead of GET.
+ * Status code and Content-Length of response are kept with directory,
+ * so stat of page.html and reads of status are answered from them.
+ * Page is fetched when page.html is read, loading.log is looked up or
+ * directory is listed. Probe which does not tell what the page would
+ * be (redirect, no Content-Length) makes the page be fetched at once.
+ */
+
+struct surffs_head_probe
+{
+    int status;                 /*http status, 0 if there is no response*/
+    loff_t len;                 /*Content-Length, -1 if it is not given*/
+};
+
+/*
+ * probe of directory, HEAD is sent for the first one; called under
+ * i_mutex of directory. -EAGAIN if probe does not stand for page
+ */
+int  surffs_probe_dir(struct inode *dir, struct surffs_head_probe **probe);
+void surffs_probe_free(struct surffs_head_probe *probe);
+
+/*text of status file and size of page.html as fetched page would give them*/
+const char *surffs_probe_status(struct surffs_head_probe *probe);
+loff_t surffs_probe_page_size(struct surffs_head_probe *probe);
+
+#endif
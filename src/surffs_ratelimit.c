@@ -0,0 +1,240 @@
+#include "surffs_ratelimit.h"
+#include "surffs_debug.h"
+#include "surffs_sb.h"
+#include "surffs_fetch.h"
+#include "surffs_socket.h"
+#include "surffs_arena.h"
+#include <linux/sched.h>
+#include <linux/jiffies.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+#include <linux/ctype.h>
+
+/*larger Crawl-delay is taken as this one*/
+#define SURFFS_ROBOTS_MAX_DELAY_MS  60000
+
+void surffs_ratelimit_init(struct surffs_ratelimit *rl)
+{
+    rl->rate = 0;
+    rl->byte_rate = 0;
+    rl->max_inflight = 0;
+    rl->crawl_delay_ms = 0;
+    rl->robots = 0;
+
+    spin_lock_init(&rl->lock);
+    init_waitqueue_head(&rl->wait);
+    /*bucket is full at the first request*/
+    rl->req_credit_us = 0;
+    rl->byte_credit = 0;
+    rl->refilled = ktime_set(0, 0);
+    rl->inflight = 0;
+    rl->released = 0;
+}
+
+static u64 request_cost_us(struct surffs_ratelimit *rl)
+{
+    u64 cost = rl->rate ? div_u64(USEC_PER_SEC, rl->rate) : 0;
+
+    return max(cost, (u64)rl->crawl_delay_ms * USEC_PER_MSEC);
+}
+
+/*called with lock held: microseconds to wait, 0 - request is let through*/
+static u64 ratelimit_try(struct surffs_ratelimit *rl)
+{
+    ktime_t now = ktime_get();
+    s64 elapsed = ktime_us_delta(now, rl->refilled);
+    u64 cost = request_cost_us(rl);
+    /*Crawl-delay allows no bursts*/
+    u64 burst = rl->crawl_delay_ms ? cost : max(cost, (u64)USEC_PER_SEC);
+    u64 wait = 0;
+
+    rl->refilled = now;
+    if (elapsed > 0)
+    {
+        elapsed = min(elapsed, (s64)max(burst, (u64)USEC_PER_SEC));
+        rl->req_credit_us = min(rl->req_credit_us + elapsed, burst);
+        if (rl->byte_rate)
+            rl->byte_credit = min(rl->byte_credit + div_s64(elapsed * rl->byte_rate, USEC_PER_SEC),
+                                  (s64)rl->byte_rate);
+    }
+
+    /*free slot wakes waiters, poll is only for cancellation*/
+    if (rl->max_inflight && rl->inflight >= rl->max_inflight)
+        return SURFFS_RATELIMIT_POLL_MS * USEC_PER_MSEC;
+
+    if (rl->req_credit_us < cost) wait = cost - rl->req_credit_us;
+    if (rl->byte_rate && rl->byte_credit < 0)
+        wait = max(wait, div_u64(-rl->byte_credit * USEC_PER_SEC, rl->byte_rate));
+    if (wait) return wait;
+
+    rl->req_credit_us -= cost;
+    rl->inflight++;
+
+    return 0;
+}
+
+int surffs_ratelimit_get(struct surffs_ratelimit *rl, struct surffs_stats *stats,
+                         const int *cancelled)
+{
+    int ret = 0;
+    int queued = 0;
+    unsigned long released;
+    u64 wait_us;
+    long timeout;
+
+    if (!surffs_ratelimit_enabled(rl)) return 0;
+
+    while (1)
+    {
+        spin_lock(&rl->lock);
+        released = rl->released;
+        wait_us = ratelimit_try(rl);
+        spin_unlock(&rl->lock);
+
+        if (!wait_us) break;
+
+        if (!queued)
+        {
+            queued = 1;
+            sfs_stat_inc(stats, SFS_STAT_RATELIMIT_WAITS);
+            sfs_stat_inc(stats, SFS_STAT_RATELIMIT_QUEUED);
+        }
+
+        if (cancelled && ACCESS_ONCE(*cancelled)) {ret = -ECANCELED; break;}
+
+        wait_us = min(wait_us, (u64)SURFFS_RATELIMIT_POLL_MS * USEC_PER_MSEC);
+        timeout = max(usecs_to_jiffies(wait_us), 1UL);
+
+        timeout = wait_event_interruptible_timeout(rl->wait,
+                                                   ACCESS_ONCE(rl->released) != released,
+                                                   timeout);
+        if (timeout < 0)
+        {
+            ret = fatal_signal_pending(current) ? -EINTR : -ERESTARTSYS;
+            break;
+        }
+    }
+
+    if (queued) sfs_stat_dec(stats, SFS_STAT_RATELIMIT_QUEUED);
+
+    return ret;
+}
+
+void surffs_ratelimit_put(struct surffs_ratelimit *rl, size_t bytes)
+{
+    if (!surffs_ratelimit_enabled(rl)) return;
+
+    spin_lock(&rl->lock);
+    rl->inflight--;
+    if (rl->byte_rate) rl->byte_credit -= bytes;
+    rl->released++;
+    spin_unlock(&rl->lock);
+
+    wake_up_all(&rl->wait);
+}
+
+/*"10", "0.5" seconds*/
+static unsigned int robots_delay_ms(const char *value)
+{
+    unsigned int ms = 0;
+    unsigned int scale;
+
+    for (; isdigit(*value) && ms <= SURFFS_ROBOTS_MAX_DELAY_MS; value++)
+        ms = ms * 10 + (*value - '0') * 1000;
+
+    if (*value == '.')
+        for (value++, scale = 100; isdigit(*value) && scale; value++, scale /= 10)
+            ms += (*value - '0') * scale;
+
+    return min(ms, (unsigned int)SURFFS_ROBOTS_MAX_DELAY_MS);
+}
+
+/*
+ * the largest Crawl-delay of groups for "*" or surffs; a group is a run of
+ * User-agent lines and the rules after them
+ */
+static unsigned int robots_crawl_delay(char *text)
+{
+    char *line;
+    char *key;
+    char *value;
+    char *p;
+    int in_agents = 0;
+    int applies = 0;
+    unsigned int delay_ms = 0;
+
+    while ((line = strsep(&text, "\n")) != NULL)
+    {
+        p = strchr(line, '#');
+        if (p) *p = 0;
+
+        p = strchr(line, ':');
+        if (!p) continue;
+        *p = 0;
+        key = strim(line);
+        value = strim(p + 1);
+
+        if (strcasecmp(key, "user-agent") == 0)
+        {
+            if (!in_agents) applies = 0;
+            in_agents = 1;
+            if (strcmp(value, "*") == 0 ||
+                strncasecmp(value, SURFFS_ROBOTS_AGENT, strlen(SURFFS_ROBOTS_AGENT)) == 0)
+                applies = 1;
+            continue;
+        }
+
+        in_agents = 0;
+        if (applies && strcasecmp(key, "crawl-delay") == 0)
+            delay_ms = max(delay_ms, robots_delay_ms(value));
+    }
+
+    return delay_ms;
+}
+
+int surffs_ratelimit_load_robots(struct surffs_sb_info *fsi)
+{
+    int ret = 0;
+    struct SURFFS_WEB_ADDRESS address = *fsi->root_web_address;
+    struct sfs_arena arena;
+    struct sfs_event_log log;
+    sfs_string webpath = {0};
+    sfs_string resp = {0};
+    char *payload = 0;
+    int status;
+
+    if (!fsi->ratelimit.robots) return 0;
+
+    sfs_arena_init(&arena);
+    sfs_event_log_init(&log, &arena);
+
+    ret = sfs_string_create(&webpath, SURFFS_ROBOTS_PATH);
+    if (!ret) ret = sfs_string_createz(&resp, 1024);
+    if (ret) goto out;
+
+    address.path = webpath;
+
+    ret = surffs_fetch(fsi, &address, 0, &resp, &payload, &log);
+    status = surffs_http_status(&resp);
+    if (ret || status != 200 || !payload)
+    {
+        if (ret == -ENOMEM) goto out;
+        /*no robots.txt - no Crawl-delay*/
+        sfs_info("robots.txt of %s is not loaded: http status %d, error code %d\n",
+                 address.host.data, status, ret);
+        ret = 0;
+        goto out;
+    }
+
+    fsi->ratelimit.crawl_delay_ms = robots_crawl_delay(payload);
+    if (fsi->ratelimit.crawl_delay_ms)
+        sfs_info("robots.txt of %s: crawl delay %ums\n", address.host.data,
+                 fsi->ratelimit.crawl_delay_ms);
+
+out:
+    sfs_string_free(&webpath);
+    sfs_string_free(&resp);
+    sfs_arena_free(&arena);
+
+    return ret;
+}
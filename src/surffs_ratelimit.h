@@ -0,0 +1,64 @@
+#ifndef _SURFFS_RATELIMIT_H_
+#define _SURFFS_RATELIMIT_H_
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/ktime.h>
+#include "surffs_stats.h"
+
+/*
+ * Rate limiter of mount, every http request passes it before connecting:
+ *     rate=         requests per second, bursts of up to one second
+ *     byte_rate=    bytes per second; size of response is known only when
+ *                   it is received, so it is charged afterwards and later
+ *                   requests wait until the debt is paid off
+ *     max_inflight= requests in progress at once
+ *     robots        Crawl-delay of robots.txt, requests go one by one then
+ * Requests over the limits wait in a queue (ratelimit_queued counter)
+ * instead of failing; the wait is interruptible.
+ */
+#define SURFFS_ROBOTS_PATH          "/robots.txt"
+#define SURFFS_ROBOTS_AGENT         "surffs"
+/*waiter rechecks cancellation at least this often*/
+#define SURFFS_RATELIMIT_POLL_MS    100
+
+struct surffs_ratelimit
+{
+    unsigned int rate;          /*0 - no limit*/
+    unsigned int byte_rate;     /*0 - no limit*/
+    unsigned int max_inflight;  /*0 - no limit*/
+    unsigned int crawl_delay_ms;
+    int robots;
+
+    spinlock_t lock;
+    wait_queue_head_t wait;
+    u64 req_credit_us;          /*time to spend on requests*/
+    s64 byte_credit;
+    ktime_t refilled;
+    unsigned int inflight;
+    unsigned long released;     /*waiters for a free slot watch it*/
+};
+
+struct surffs_sb_info;
+
+void surffs_ratelimit_init(struct surffs_ratelimit *rl);
+
+static inline int surffs_ratelimit_enabled(struct surffs_ratelimit *rl)
+{
+    return rl->rate || rl->byte_rate || rl->max_inflight || rl->crawl_delay_ms;
+}
+
+/*
+ * waits until request may start, then surffs_ratelimit_put() must follow;
+ * -EINTR if killed, -ERESTARTSYS on other signal, -ECANCELED if *cancelled
+ */
+int  surffs_ratelimit_get(struct surffs_ratelimit *rl, struct surffs_stats *stats,
+                          const int *cancelled);
+void surffs_ratelimit_put(struct surffs_ratelimit *rl, size_t bytes);
+
+/*reads Crawl-delay of robots.txt for mount with option robots*/
+int  surffs_ratelimit_load_robots(struct surffs_sb_info *fsi);
+
+#endif
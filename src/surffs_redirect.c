@@ -0,0 +1,121 @@
+#include "surffs_redirect.h"
+#include "surffs_debug.h"
+#include "surffs_sb.h"
+#include "surffs_mem.h"
+#include "surffs_socket.h"
+#include <linux/string.h>
+#include <linux/dcache.h>
+
+void surffs_redirects_init(struct surffs_redirects *redirects)
+{
+    hash_init(redirects->table);
+    mutex_init(&redirects->lock);
+    redirects->count = 0;
+}
+
+void surffs_redirects_free(struct surffs_redirects *redirects)
+{
+    int bkt;
+    struct string_hash_node *node;
+    struct hlist_node *tmp;
+
+    hash_for_each_safe(redirects->table, bkt, tmp, node, hashlist)
+    {
+        sfs_string_free(&node->key);
+        sfs_string_free(&node->value);
+        hash_del(&node->hashlist);
+        surffs_cache_free(SFS_CACHE_HASH_NODE, node);
+    }
+    redirects->count = 0;
+}
+
+/*called with lock held*/
+static struct string_hash_node *redirect_lookup(struct surffs_redirects *redirects,
+                                                const char *webpath)
+{
+    struct string_hash_node *node;
+    unsigned int hash;
+
+    hash = full_name_hash(webpath, strlen(webpath));
+    hash_for_each_possible(redirects->table, node, hashlist, hash)
+        if (strcmp(node->key.data, webpath) == 0) return node;
+
+    return 0;
+}
+
+sfs_string *surffs_redirect_find(struct surffs_redirects *redirects, const char *webpath)
+{
+    struct string_hash_node *node;
+    sfs_string *target = 0;
+    int hops;
+
+    mutex_lock(&redirects->lock);
+
+    /*chain of redirects is followed, limit also breaks loops*/
+    for (hops = 0; hops < SURFFS_MAX_REDIRECTS; hops++)
+    {
+        node = redirect_lookup(redirects, target ? target->data : webpath);
+        if (!node) break;
+        target = &node->value;
+    }
+
+    mutex_unlock(&redirects->lock);
+
+    return target;
+}
+
+int surffs_redirect_add(struct surffs_redirects *redirects, const char *webpath,
+                        const char *target)
+{
+    int ret = 0;
+    struct string_hash_node *node = 0;
+
+    mutex_lock(&redirects->lock);
+
+    /*strings of existing mapping may be in use, so the first one stays*/
+    if (redirect_lookup(redirects, webpath)) goto out;
+
+    node = surffs_cache_zalloc(SFS_CACHE_HASH_NODE);
+    if (!node) {ret = -ENOMEM; goto out;}
+
+    ret = sfs_string_create(&node->key, webpath);
+    if (ret) goto out;
+
+    ret = sfs_string_create(&node->value, target);
+    if (ret) goto out;
+
+    hash_add(redirects->table, &node->hashlist, full_name_hash(webpath, strlen(webpath)));
+    redirects->count++;
+    node = 0;
+
+out:
+    mutex_unlock(&redirects->lock);
+
+    if (node)
+    {
+        sfs_string_free(&node->key);
+        sfs_string_free(&node->value);
+        surffs_cache_free(SFS_CACHE_HASH_NODE, node);
+    }
+
+    return ret;
+}
+
+static int is_redirect_status(int status)
+{
+    return status == 301 || status == 302 || status == 303 ||
+           status == 307 || status == 308;
+}
+
+int surffs_http_redirect(sfs_string *http_response, sfs_string *location)
+{
+    int ret = 0;
+    int status = surffs_http_status(http_response);
+
+    if (!is_redirect_status(status)) return 0;
+
+    ret = surffs_http_header(http_response, "Location", location);
+    if (ret) return ret;
+
+    return location->textlen ? status : 0;
+}
@@ -0,0 +1,44 @@
+#ifndef _SURFFS_REDIRECT_H_
+#define _SURFFS_REDIRECT_H_
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/mutex.h>
+#include <linux/hashtable.h>
+#include "surffs_helpers.h"
+
+/*
+ * Same-host redirects (301, 302, 303, 307, 308) are followed up to
+ * SURFFS_MAX_REDIRECTS hops. Every hop is remembered by mount as
+ * "webpath -> location path", so later links to the old path are fetched
+ * from the target at once and share its page and its directory.
+ * Mappings live until unmount.
+ */
+#define SURFFS_MAX_REDIRECTS 5
+
+struct surffs_redirects
+{
+    DECLARE_HASHTABLE(table, 8);
+    struct mutex lock;
+    u32 count;
+};
+
+void surffs_redirects_init(struct surffs_redirects *redirects);
+void surffs_redirects_free(struct surffs_redirects *redirects);
+
+/*
+ * final target of webpath or NULL if webpath is not redirected.
+ * Returned string lives until surffs_redirects_free()
+ */
+sfs_string *surffs_redirect_find(struct surffs_redirects *redirects, const char *webpath);
+int surffs_redirect_add(struct surffs_redirects *redirects, const char *webpath,
+                        const char *target);
+
+/*
+ * code of redirect status (3xx) of http response with Location header,
+ * which is copied to location; 0 if response is not a redirect
+ * or -ENOMEM
+ */
+int surffs_http_redirect(sfs_string *http_response, sfs_string *location);
+
+#endif
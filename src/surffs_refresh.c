@@ -0,0 +1,218 @@
+#include "surffs_refresh.h"
+#include "surffs_sb.h"
+#include "surffs_inode.h"
+#include "surffs_internet.h"
+#include "surffs_webpages.h"
+#include "surffs_debug.h"
+#include "surffs_lazybody.h"
+#include <linux/string.h>
+#include <linux/jiffies.h>
+#include <linux/dcache.h>
+
+/*pages taken from cache at once, round goes on while there are more*/
+#define SURFFS_REFRESH_BATCH 64
+
+static void refresh_work(struct work_struct *work);
+
+void surffs_refresh_init(struct surffs_refresh *refresh, struct super_block *sb)
+{
+    refresh->ttl = 0;
+    refresh->sb = sb;
+    refresh->stopping = 0;
+    INIT_DELAYED_WORK(&refresh->work, refresh_work);
+}
+
+void surffs_refresh_start(struct surffs_refresh *refresh)
+{
+    if (refresh->ttl)
+        queue_delayed_work(system_long_wq, &refresh->work, refresh->ttl * HZ);
+}
+
+void surffs_refresh_stop(struct surffs_refresh *refresh)
+{
+    refresh->stopping = 1;
+    cancel_delayed_work_sync(&refresh->work);
+}
+
+/*page of mounted host or of a listed one, as fetched by this mount*/
+static int page_of_mount(struct surffs_sb_info *fsi, struct SURFFS_WEB_PAGE *page)
+{
+    struct SURFFS_WEB_ADDRESS *root = fsi->root_web_address;
+    struct surffs_host *host;
+
+    if (page->address.port != root->port) return 0;
+
+    if (strcmp(page->address.host.data, root->host.data) == 0)
+        return strcmp(page->address.ip.data, root->ip.data) == 0;
+
+    host = surffs_host_find(&fsi->hosts, page->address.host.data);
+    return host && strcmp(page->address.ip.data, host->ip.data) == 0;
+}
+
+/*referenced pages of mount fetched more than ttl ago*/
+static int stale_pages(struct surffs_sb_info *fsi, struct SURFFS_WEB_PAGE **pages, int max)
+{
+    struct SURFFS_WEB_PAGE *page;
+    unsigned long ttl = fsi->refresh.ttl * HZ;
+    int n = 0;
+
+    mutex_lock(&webpages_lock);
+    list_for_each_entry(page, &webpages_list, webpages)
+    {
+        if (n == max) break;
+        if (time_before(jiffies, page->fetched + ttl)) continue;
+        if (!page_of_mount(fsi, page)) continue;
+
+        SURFFS_WEB_PAGE_get(page);
+        pages[n++] = page;
+    }
+    mutex_unlock(&webpages_lock);
+
+    return n;
+}
+
+/*
+ * lazy bodies (see surffs_lazybody.h) are compared by validators, length
+ * and kept part: blocks past it may be cached from the old version.
+ * Lazy page without validators is taken as changed
+ */
+static int page_changed(struct SURFFS_WEB_PAGE *page, struct SURFFS_WEB_PAGE *fresh)
+{
+    size_t kept;
+
+    if (!page->http_payload) return 1;
+    if (page->lazy && surffs_lazy_body_current(page->lazy, &fresh->http_resp) != 1) return 1;
+    if (surffs_page_body_len(page) != surffs_page_body_len(fresh)) return 1;
+
+    kept = page->http_resp.textlen - (page->http_payload - page->http_resp.data);
+    if (kept != fresh->http_resp.textlen - (fresh->http_payload - fresh->http_resp.data))
+        return 1;
+
+    return memcmp(page->http_payload, fresh->http_payload, kept) != 0;
+}
+
+/*cached dentry of linux path "a/b/" ("/" for root), NULL if it is not in dcache*/
+static struct dentry *cached_dentry(struct super_block *sb, const char *path)
+{
+    struct dentry *dentry = dget(sb->s_root);
+    struct dentry *child;
+    struct qstr name;
+    const char *end;
+
+    while (*path)
+    {
+        if (*path == '/')
+        {
+            path++;
+            continue;
+        }
+
+        end = strchrnul(path, '/');
+        name.name = path;
+        name.len = end - path;
+
+        child = d_hash_and_lookup(dentry, &name);
+        dput(dentry);
+        if (IS_ERR_OR_NULL(child)) return 0;
+
+        dentry = child;
+        path = end;
+    }
+
+    return dentry;
+}
+
+/*directory showing page gets the fresh one*/
+static int update_dir(struct super_block *sb, struct SURFFS_WEB_PAGE *page,
+                      struct SURFFS_WEB_PAGE *fresh)
+{
+    int ret = 0;
+    struct surffs_sb_info *fsi = SURFFS_SB(sb);
+    sfs_string webpath_buf = {0};
+    sfs_string path = {0};
+    const char *webpath;
+    char *linux_path;
+    struct dentry *dentry = 0;
+    struct inode *dir;
+
+    ret = surffs_webpath(fsi, page->address.host.data, page->address.path.data,
+                         &webpath_buf, &webpath);
+    if (ret) goto out;
+
+    /*path of directory is copied, table may grow meanwhile*/
+    linux_path = find_discovered_path(sb, webpath);
+    if (!linux_path) goto out;
+    ret = sfs_string_create(&path, linux_path);
+    if (ret) goto out;
+
+    dentry = cached_dentry(sb, path.data);
+    if (!dentry) goto out;
+
+    dir = dentry->d_inode;
+    if (!dir || SURFFS_INODE(dir)->type != INODE_DIR) goto out;
+
+    mutex_lock(&dir->i_mutex);
+    if (SURFFS_INODE(dir)->webpage == page)
+        surffs_dir_replace_webpage(dentry, fresh);
+    mutex_unlock(&dir->i_mutex);
+
+out:
+    if (dentry) dput(dentry);
+    sfs_string_free(&webpath_buf);
+    sfs_string_free(&path);
+
+    return ret;
+}
+
+static int refresh_page(struct super_block *sb, struct SURFFS_WEB_PAGE *page)
+{
+    int ret = 0;
+    struct surffs_sb_info *fsi = SURFFS_SB(sb);
+    struct SURFFS_WEB_PAGE *fresh = 0;
+
+    sfs_stat_inc(&fsi->stats, SFS_STAT_REFRESHES);
+
+    ret = refresh_webpage(fsi, page, &fresh);
+    /*failed page waits for the next round too*/
+    page->fetched = jiffies;
+    if (ret || !fresh) goto out;
+
+    if (!page_changed(page, fresh)) goto out;
+
+    sfs_stat_inc(&fsi->stats, SFS_STAT_REFRESH_CHANGES);
+    replace_webpage(page, fresh);
+    ret = update_dir(sb, page, fresh);
+
+out:
+    if (fresh) SURFFS_WEB_PAGE_put(fresh);
+
+    return ret;
+}
+
+static void refresh_work(struct work_struct *work)
+{
+    struct surffs_refresh *refresh = container_of(to_delayed_work(work),
+                                                  struct surffs_refresh, work);
+    struct surffs_sb_info *fsi = SURFFS_SB(refresh->sb);
+    struct SURFFS_WEB_PAGE *pages[SURFFS_REFRESH_BATCH];
+    int n, i;
+    int ret;
+
+    do
+    {
+        n = stale_pages(fsi, pages, SURFFS_REFRESH_BATCH);
+        for (i = 0; i < n; i++)
+        {
+            if (!refresh->stopping)
+            {
+                ret = refresh_page(refresh->sb, pages[i]);
+                if (ret) sfs_info("refresh of %s%s failed, error code %d\n",
+                                  pages[i]->address.host.data, pages[i]->address.path.data, ret);
+            }
+            SURFFS_WEB_PAGE_put(pages[i]);
+        }
+    } while (n == SURFFS_REFRESH_BATCH && !refresh->stopping);
+
+    if (!refresh->stopping)
+        queue_delayed_work(system_long_wq, &refresh->work, refresh->ttl * HZ);
+}
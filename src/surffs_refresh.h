@@ -0,0 +1,31 @@
+#ifndef _SURFFS_REFRESH_H_
+#define _SURFFS_REFRESH_H_
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/workqueue.h>
+
+/*
+ * Refresh of cached pages (mount option ttl=<seconds>): every ttl seconds
+ * pages of mount fetched more than ttl ago are fetched again with their
+ * validators. Not modified page (304 or the same body) stays. Changed page
+ * replaces cached one, directories of mount showing it and their special
+ * files get it, and fsnotify tells watchers: IN_MODIFY for page.html,
+ * IN_DELETE and IN_CREATE for links gone from page and new ones. Failed
+ * fetches keep cached page until the next round.
+ */
+
+struct surffs_refresh
+{
+    unsigned int ttl;               /*seconds, 0 - pages are not refreshed*/
+    struct super_block *sb;
+    struct delayed_work work;
+    int stopping;
+};
+
+void surffs_refresh_init(struct surffs_refresh *refresh, struct super_block *sb);
+void surffs_refresh_start(struct surffs_refresh *refresh);
+/*waits for running round, called before mount goes away*/
+void surffs_refresh_stop(struct surffs_refresh *refresh);
+
+#endif
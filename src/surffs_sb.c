@@ -6,28 +6,74 @@
 #include "surffs_parser.h"
 #include "surffs_internet.h"
 #include "surffs_dentry.h"
-
-struct string_hash_node
-{
-    struct hlist_node hashlist;
-    sfs_string key;
-    sfs_string value;
-};
-
+#include "surffs_mem.h"
+#include "surffs_debugfs.h"
+#include "surffs_mirror.h"
+#include "surffs_async.h"
+#include "surffs_lazybody.h"
 
 inline struct surffs_sb_info *SURFFS_SB(struct super_block *sb)
 {
     return sb->s_fs_info;
 }
 
-
 enum {
     Opt_ip,
+    Opt_port,
+    Opt_connect_timeout,
+    Opt_ttfb_timeout,
+    Opt_transfer_timeout,
+    Opt_adaptive_timeouts,
+    Opt_lb_rr,
+    Opt_lb_lo,
+    Opt_hedge,
+    Opt_breaker,
+    Opt_breaker_probe,
+    Opt_cache_dir,
+    Opt_mirror,
+    Opt_sitemap,
+    Opt_sitemap_path,
+    Opt_rate,
+    Opt_byte_rate,
+    Opt_max_inflight,
+    Opt_robots,
+    Opt_hosts,
+    Opt_offload,
+    Opt_nonblock,
+    Opt_ttl,
+    Opt_lazy_body,
+    Opt_lazy_body_keep,
+    Opt_head_probe,
     Opt_err
 };
 
 static const match_table_t tokens = {
     {Opt_ip, "ip=%s"},
+    {Opt_port, "port=%u"},
+    {Opt_connect_timeout, "connect_timeout=%u"},
+    {Opt_ttfb_timeout, "ttfb_timeout=%u"},
+    {Opt_transfer_timeout, "transfer_timeout=%u"},
+    {Opt_adaptive_timeouts, "adaptive_timeouts"},
+    {Opt_lb_rr, "lb=rr"},
+    {Opt_lb_lo, "lb=lo"},
+    {Opt_hedge, "hedge=%u"},
+    {Opt_breaker, "breaker=%u"},
+    {Opt_breaker_probe, "breaker_probe=%u"},
+    {Opt_cache_dir, "cache_dir=%s"},
+    {Opt_mirror, "mirror=%s"},
+    {Opt_sitemap, "sitemap"},
+    {Opt_sitemap_path, "sitemap=%s"},
+    {Opt_rate, "rate=%u"},
+    {Opt_byte_rate, "byte_rate=%u"},
+    {Opt_max_inflight, "max_inflight=%u"},
+    {Opt_robots, "robots"},
+    {Opt_hosts, "hosts=%s"},
+    {Opt_offload, "offload"},
+    {Opt_nonblock, "nonblock"},
+    {Opt_ttl, "ttl=%u"},
+    {Opt_lazy_body, "lazy_body"},
+    {Opt_lazy_body_keep, "lazy_body=%u"},
+    {Opt_head_probe, "head_probe"},
     {Opt_err, NULL}
 };
 
@@ -38,39 +84,190 @@ static int surffs_parse_mount_options(char *data, struct surffs_sb_info *fsi)
     int token;
     char *p;
     char *tmp = 0;
-
-    sfs_enter();
-    sfs_debug("surffs_parse_mount_options, data = %s\n", data);
+    int port;
+    int ms;
+    int pct;
+    int n;
+    enum SURFFS_TIMEOUT_PHASE phase;
 
     while ((p = strsep(&data, ",")) != NULL) {
         if (!*p)
             continue;
 
-        sfs_trace("parsing...\n");
-
         token = match_token(p, tokens, args);
 
-        sfs_trace("token = %d\n", token);
-
         switch (token) {
         case Opt_ip:
             tmp = match_strdup(&args[0]);
             if (!tmp)
             {
-                sfs_debug("error match_strdup\n");
                 ret = -EINVAL;
                 goto out;
             }
             sfs_string_cat(&fsi->root_web_address->ip, tmp);
             kfree(tmp);
             break;
+        case Opt_port:
+            if (match_int(&args[0], &port) || port <= 0 || port > 65535)
+            {
+                sfs_error("error mount surffs: invalid port\n");
+                ret = -EINVAL;
+                goto out;
+            }
+            fsi->root_web_address->port = port;
+            break;
+        case Opt_connect_timeout:
+        case Opt_ttfb_timeout:
+        case Opt_transfer_timeout:
+            phase = token == Opt_connect_timeout ? SFS_TOUT_CONNECT :
+                    token == Opt_ttfb_timeout ? SFS_TOUT_TTFB : SFS_TOUT_TRANSFER;
+            if (match_int(&args[0], &ms) || ms < 0)
+            {
+                sfs_error("error mount surffs: invalid %s timeout\n",
+                          surffs_timeout_phase_name(phase));
+                ret = -EINVAL;
+                goto out;
+            }
+            fsi->timeouts.ms[phase] = ms;
+            break;
+        case Opt_adaptive_timeouts:
+            fsi->timeouts.adaptive = 1;
+            break;
+        case Opt_lb_rr:
+            fsi->origins.policy = SFS_LB_RR;
+            break;
+        case Opt_lb_lo:
+            fsi->origins.policy = SFS_LB_LO;
+            break;
+        case Opt_hedge:
+            if (match_int(&args[0], &pct) || pct < 1 || pct > 99)
+            {
+                sfs_error("error mount surffs: hedge percentile must be 1..99\n");
+                ret = -EINVAL;
+                goto out;
+            }
+            fsi->hedge_percentile = pct;
+            break;
+        case Opt_breaker:
+            if (match_int(&args[0], &n) || n < 0)
+            {
+                sfs_error("error mount surffs: invalid breaker threshold\n");
+                ret = -EINVAL;
+                goto out;
+            }
+            fsi->breaker.threshold = n;
+            break;
+        case Opt_breaker_probe:
+            if (match_int(&args[0], &ms) || ms <= 0)
+            {
+                sfs_error("error mount surffs: invalid breaker probe interval\n");
+                ret = -EINVAL;
+                goto out;
+            }
+            fsi->breaker.probe_ms = ms;
+            break;
+        case Opt_cache_dir:
+            tmp = match_strdup(&args[0]);
+            if (!tmp)
+            {
+                ret = -ENOMEM;
+                goto out;
+            }
+            surffs_diskcache_free(&fsi->diskcache);
+            ret = surffs_diskcache_init(&fsi->diskcache, tmp);
+            kfree(tmp);
+            if (ret) goto out;
+            break;
+        case Opt_mirror:
+            tmp = match_strdup(&args[0]);
+            if (!tmp)
+            {
+                ret = -ENOMEM;
+                goto out;
+            }
+            surffs_local_dir_free(&fsi->mirror);
+            ret = surffs_local_dir_init(&fsi->mirror, tmp, "mirror");
+            kfree(tmp);
+            if (ret) goto out;
+            break;
+        case Opt_sitemap:
+            ret = surffs_sitemap_set_path(&fsi->sitemap, SURFFS_SITEMAP_PATH);
+            if (ret) goto out;
+            break;
+        case Opt_sitemap_path:
+            tmp = match_strdup(&args[0]);
+            if (!tmp)
+            {
+                ret = -ENOMEM;
+                goto out;
+            }
+            ret = surffs_sitemap_set_path(&fsi->sitemap, tmp);
+            kfree(tmp);
+            if (ret) goto out;
+            break;
+        case Opt_rate:
+        case Opt_byte_rate:
+        case Opt_max_inflight:
+            if (match_int(&args[0], &n) || n < 0)
+            {
+                sfs_error("error mount surffs: invalid rate limit '%s'\n", p);
+                ret = -EINVAL;
+                goto out;
+            }
+            if (token == Opt_rate) fsi->ratelimit.rate = n;
+            else if (token == Opt_byte_rate) fsi->ratelimit.byte_rate = n;
+            else fsi->ratelimit.max_inflight = n;
+            break;
+        case Opt_robots:
+            fsi->ratelimit.robots = 1;
+            break;
+        case Opt_hosts:
+            tmp = match_strdup(&args[0]);
+            if (!tmp)
+            {
+                ret = -ENOMEM;
+                goto out;
+            }
+            ret = surffs_hosts_add(&fsi->hosts, tmp, fsi->root_web_address->host.data);
+            kfree(tmp);
+            if (ret) goto out;
+            break;
+        case Opt_offload:
+            fsi->offload = 1;
+            break;
+        case Opt_nonblock:
+            fsi->nonblock = 1;
+            break;
+        case Opt_ttl:
+            if (match_int(&args[0], &n) || n < 0)
+            {
+                sfs_error("error mount surffs: invalid ttl '%s'\n", p);
+                ret = -EINVAL;
+                goto out;
+            }
+            fsi->refresh.ttl = n;
+            break;
+        case Opt_lazy_body:
+            fsi->lazy_body = 1;
+            fsi->lazy_keep = SURFFS_LAZY_KEEP;
+            break;
+        case Opt_lazy_body_keep:
+            if (match_int(&args[0], &n) || n < 0)
+            {
+                sfs_error("error mount surffs: invalid lazy_body '%s'\n", p);
+                ret = -EINVAL;
+                goto out;
+            }
+            fsi->lazy_body = 1;
+            fsi->lazy_keep = n;
+            break;
+        case Opt_head_probe:
+            fsi->head_probe = 1;
+            break;
         }
     }
 
-    sfs_debug("ok. ip = %s\n", fsi->root_web_address->ip.data);
-
 out:
-    sfs_leave();
     return ret;
 }
 
@@ -80,31 +277,31 @@ static void free_discovred_paths(struct surffs_sb_info *fsi)
     struct string_hash_node *node;
     struct hlist_node *tmp;
 
-    sfs_debug("free_discovred_paths\n");
-
     hash_for_each_safe(fsi->discovred_paths, bkt, tmp, node, hashlist)
     {
         sfs_string_free(&node->key);
         sfs_string_free(&node->value);
         hash_del(&node->hashlist);
-        kfree(node);
+        surffs_cache_free(SFS_CACHE_HASH_NODE, node);
     }
 }
 
 static void surffs_free_super_private(struct surffs_sb_info *fsi)
 {
-    sfs_enter();
-    sfs_debug("surffs_free_super_private\n");
-
     if (fsi->raw_mount_data)
         kfree(fsi->raw_mount_data);
 
     if (fsi->root_web_address)
         SURFFS_WEB_ADDRESS_free(fsi->root_web_address);
 
+    surffs_debugfs_remove_sb(fsi);
     free_discovred_paths(fsi);
-
-    sfs_leave();
+    surffs_redirects_free(&fsi->redirects);
+    surffs_diskcache_free(&fsi->diskcache);
+    surffs_local_dir_free(&fsi->mirror);
+    surffs_sitemap_free(&fsi->sitemap);
+    surffs_hosts_free(&fsi->hosts);
+    surffs_stats_free(&fsi->stats);
 }
 
 static int surffs_fill_super(struct super_block *sb, void *data, const char *mountdata, int silent)
@@ -114,9 +311,6 @@ static int surffs_fill_super(struct super_block *sb, void *data, const char *mou
     struct inode *root_inode = 0;
     sfs_string protocol = {0}; // dont forget free!
 
-    sfs_enter();
-    sfs_debug("surffs_fill_super\n");
-
     save_mount_options(sb, data);
 
     sb->s_d_op = &surffs_dentry_operations;
@@ -132,6 +326,20 @@ static int surffs_fill_super(struct super_block *sb, void *data, const char *mou
     if (ret) goto out;
 
     hash_init(fsi->discovred_paths);
+    spin_lock_init(&fsi->discovred_lock);
+    surffs_timeouts_init(&fsi->timeouts);
+    surffs_origins_init(&fsi->origins);
+    surffs_breaker_init(&fsi->breaker);
+    surffs_redirects_init(&fsi->redirects);
+    surffs_sitemap_init(&fsi->sitemap);
+    surffs_ratelimit_init(&fsi->ratelimit);
+    surffs_hosts_init(&fsi->hosts);
+    surffs_refresh_init(&fsi->refresh, sb);
+
+    ret = surffs_stats_init(&fsi->stats, sb->s_dev);
+    if (ret) goto out;
+
+    surffs_debugfs_add_sb(sb);
 
     ret = sfs_string_createz(&protocol, 16);
     if (ret) goto out;
@@ -142,7 +350,8 @@ static int surffs_fill_super(struct super_block *sb, void *data, const char *mou
                                      &fsi->root_web_address->path,
                                      PREFER_HOST);
     if (ret) goto out;
-    if (!is_valid_protocol(protocol.data))
+    fsi->backend = surffs_find_backend(protocol.data);
+    if (!fsi->backend)
     {
         sfs_error("error mount surffs for '%s': protocol '%s' not supported\n",
                   mountdata, protocol.data);
@@ -153,12 +362,40 @@ static int surffs_fill_super(struct super_block *sb, void *data, const char *mou
     ret = surffs_parse_mount_options(data, fsi);
     if (ret) goto out;
 
-    if (!fsi->root_web_address->ip.textlen)
+    if (fsi->backend == &surffs_file_backend && !fsi->mirror.path)
+    {
+        sfs_error("error mount surffs: no mirror specified. To mount file:// \"-o mirror=...\" is required\n");
+        ret = -EINVAL;
+        goto out;
+    }
+
+    if (!fsi->backend->local)
+    {
+        if (!fsi->root_web_address->ip.textlen)
+        {
+            sfs_error("error mount surffs: no ip specified. To mount surffs \"-o ip=...\" is required\n");
+            ret = -EINVAL;
+            goto out;
+        }
+
+        ret = surffs_origins_parse(&fsi->origins, fsi->root_web_address->ip.data);
+        if (ret) goto out;
+    }
+
+    if (fsi->hosts.count && fsi->backend->local)
     {
-        sfs_error("error mount surffs: no ip specified. To mount surffs \"-o ip=...\" is required\n");
+        sfs_error("error mount surffs: hosts= is not supported for a local mirror\n");
         ret = -EINVAL;
         goto out;
     }
+    surffs_hosts_set_policy(&fsi->hosts, fsi->origins.policy);
+
+    /*site without robots.txt or sitemap is still mounted*/
+    ret = surffs_ratelimit_load_robots(fsi);
+    if (ret) goto out;
+
+    ret = surffs_sitemap_load(fsi);
+    if (ret) goto out;
 
     //sb->s_maxbytes		= MAX_LFS_FILESIZE;
     //sb->s_blocksize		= PAGE_CACHE_SIZE;
@@ -178,13 +415,15 @@ static int surffs_fill_super(struct super_block *sb, void *data, const char *mou
     sb->s_root = d_make_root(root_inode);
     if (!sb->s_root) {ret = -ENOMEM; goto out;}
 
-    ret = sfs_string_set(&SURFFS_INODE(root_inode)->webPath,
-                         fsi->root_web_address->path.data);
+    ret = sfs_string_create(&SURFFS_DIR_INODE(root_inode)->webPath,
+                            fsi->root_web_address->path.data);
     if (ret) goto out;
 
-    ret = add_discovered_path(sb, SURFFS_INODE(root_inode)->webPath.data, "/");
+    ret = add_discovered_path(sb, SURFFS_DIR_INODE(root_inode)->webPath.data, "/");
     if (ret) goto out;
 
+    surffs_refresh_start(&fsi->refresh);
+
 out:
     sfs_string_free(&protocol);
     if (ret)
@@ -194,14 +433,14 @@ out:
         {
             surffs_free_super_private(fsi);
             kfree(fsi);
+            /*kill_sb of failed mount must not free it again*/
+            sb->s_fs_info = 0;
         }
     }
-    sfs_leave();
+
     return ret;
 }
 
-
-
 static int surffs_test_super(struct super_block *sb, void *data)
 {
     struct surffs_sb_info *fsi = SURFFS_SB(sb);
@@ -220,7 +459,6 @@ struct dentry *surffs_mount(struct file_system_type *fs_type,
     int ret = 0;
     struct super_block *s = 0;
 
-    sfs_enter();
     sfs_info("surffs_mount\n");
 
     s = sget(fs_type, surffs_test_super, set_anon_super, flags, (void*)url);
@@ -245,7 +483,7 @@ out:
     {
         if (s && (!IS_ERR(s))) deactivate_locked_super(s);
     }
-    sfs_leave();
+
     return ret ? ERR_PTR(ret) : dget(s->s_root);
 }
 
@@ -253,63 +491,91 @@ void surffs_unmount(struct super_block *sb)
 {
     struct surffs_sb_info *fsi;
 
-    sfs_enter();
     sfs_info("surffs_unmount\n");
 
+    /*refresh walks dentries of mount*/
     fsi = SURFFS_SB(sb);
+    if (fsi) surffs_refresh_stop(&fsi->refresh);
+
+    /*async fetches keep inodes of mount*/
+    surffs_async_flush();
+
     if (fsi)
     {
         surffs_free_super_private(fsi);
         kfree(fsi);
     }
 
-    sfs_debug("kill_anon_super...\n");
     kill_anon_super(sb);
-
-    sfs_debug("surffs_unmount OK\n");
-    sfs_leave();
 }
 
+/*
+ * Filesystem is read-only, so there is no free space: blocks are memory of
+ * cached pages (in PAGE_SIZE units), files are cached pages
+ */
+int surffs_statfs(struct dentry *dentry, struct kstatfs *buf)
+{
+    struct surffs_sb_info *fsi = SURFFS_SB(dentry->d_sb);
+    u64 bytes;
+    u64 pages;
+
+    webpages_usage(fsi->root_web_address, &bytes, &pages);
+
+    buf->f_type = SURFFS_MAGIC_NUMBER;
+    buf->f_bsize = PAGE_SIZE;
+    buf->f_blocks = DIV_ROUND_UP(bytes, PAGE_SIZE);
+    buf->f_bfree = 0;
+    buf->f_bavail = 0;
+    buf->f_files = pages;
+    buf->f_ffree = 0;
+    buf->f_namelen = NAME_MAX;
+
+    return 0;
+}
 
-
-char *find_discovered_path(struct super_block *sb, char *webpath)
+/*called under discovred_lock*/
+static char *find_discovered_path_locked(struct surffs_sb_info *fsi, const char *webpath,
+                                         unsigned int hash)
 {
     struct string_hash_node *node = 0;
-    unsigned int hash;
     char *result = 0;
 
-    sfs_enter();
-    sfs_debug("find_discovered_path for webpath '%s'\n", webpath);
-
-    hash = full_name_hash(webpath, strlen(webpath));
-    hash_for_each_possible(SURFFS_SB(sb)->discovred_paths, node, hashlist, hash)
+    hash_for_each_possible(fsi->discovred_paths, node, hashlist, hash)
     {
         if (strcmp(node->key.data, webpath) == 0)
         {
-            sfs_debug("found: '%s'\n", node->value.data);
             result = node->value.data;
             goto out;
         }
     }
 
-    sfs_debug("no entry found\n");
-
 out:
-    sfs_leave();
     return result;
 }
 
-int add_discovered_path(struct super_block *sb, char *webpath, char *linux_path)
+char *find_discovered_path(struct super_block *sb, const char *webpath)
+{
+    struct surffs_sb_info *fsi = SURFFS_SB(sb);
+    unsigned int hash;
+    char *result;
+
+    hash = full_name_hash(webpath, strlen(webpath));
+
+    spin_lock(&fsi->discovred_lock);
+    result = find_discovered_path_locked(fsi, webpath, hash);
+    spin_unlock(&fsi->discovred_lock);
+
+    return result;
+}
+
+int add_discovered_path(struct super_block *sb, const char *webpath, char *linux_path)
 {
     int ret = 0;
+    struct surffs_sb_info *fsi = SURFFS_SB(sb);
     unsigned int hash;
     struct string_hash_node *node = 0;
 
-    sfs_enter();
-    sfs_debug("add_discovered_path: webpath = '%s' linux_path = '%s'\n",
-              webpath, linux_path);
-
-    node = kzalloc(sizeof(struct string_hash_node), GFP_KERNEL);
+    node = surffs_cache_zalloc(SFS_CACHE_HASH_NODE);
     if (!node) {ret = -ENOMEM; goto out;}
 
     ret = sfs_string_create(&node->key, webpath);
@@ -320,10 +586,23 @@ int add_discovered_path(struct super_block *sb, char *webpath, char *linux_path)
 
     hash = full_name_hash(webpath, strlen(webpath));
 
-    hash_add(SURFFS_SB(sb)->discovred_paths, &node->hashlist, hash);
+    /*another lookup may have added the same webpath meanwhile*/
+    spin_lock(&fsi->discovred_lock);
+    if (!find_discovered_path_locked(fsi, webpath, hash))
+    {
+        hash_add(fsi->discovred_paths, &node->hashlist, hash);
+        node = 0;
+    }
+    spin_unlock(&fsi->discovred_lock);
 
 out:
-    sfs_leave();
+    if (node)
+    {
+        sfs_string_free(&node->key);
+        sfs_string_free(&node->value);
+        surffs_cache_free(SFS_CACHE_HASH_NODE, node);
+    }
+
     return ret;
 }
 
@@ -11,26 +11,64 @@
 #include "surffs.h"
 #include "surffs_helpers.h"
 #include "surffs_webpages.h"
-#include "surffs_helpers.h"
-
-
+#include "surffs_stats.h"
+#include "surffs_fetch.h"
+#include "surffs_timeout.h"
+#include "surffs_origin.h"
+#include "surffs_breaker.h"
+#include "surffs_redirect.h"
+#include "surffs_diskcache.h"
+#include "surffs_localfile.h"
+#include "surffs_sitemap.h"
+#include "surffs_ratelimit.h"
+#include "surffs_hosts.h"
+#include "surffs_refresh.h"
 
+struct string_hash_node
+{
+    struct hlist_node hashlist;
+    sfs_string key;
+    sfs_string value;
+};
 
 struct surffs_sb_info
 {
     struct SURFFS_WEB_ADDRESS *root_web_address;
+    struct surffs_fetch_backend *backend;
     char *raw_mount_data;
 
     /*
      * hash of discovred resources: key is webpath, value is linux path
      * (relative from mount root).
-     * It used for creating symlinks for already discovered pages
+     * It used for creating symlinks for already discovered pages.
+     * Entries stay till umount, so found linux path can be used unlocked
      */
     DECLARE_HASHTABLE(discovred_paths, 12);
+    spinlock_t discovred_lock;
+
+    struct surffs_stats stats;
+    struct surffs_timeouts timeouts;
+    struct surffs_origins origins;
+    struct surffs_breaker breaker;
+    struct surffs_redirects redirects;
+    struct surffs_diskcache diskcache;
+    struct surffs_local_dir mirror;   /*pages of file:// mounts*/
+    struct surffs_sitemap sitemap;
+    struct surffs_ratelimit ratelimit;
+    struct surffs_hosts hosts;        /*other hosts of multi-host mode*/
+    struct surffs_refresh refresh;
+    unsigned int hedge_percentile;    /*0 - no hedged requests*/
+    int offload;                      /*fetch by daemon of /dev/surffs-fetch*/
+    int nonblock;                     /*O_NONBLOCK directories load asynchronously*/
+    int lazy_body;                    /*body past lazy_keep bytes is read by ranges*/
+    unsigned int lazy_keep;
+    int head_probe;                   /*stat of page.html and status sends HEAD*/
+    struct dentry *debugfs_dir;
 };
 
-char *find_discovered_path(struct super_block *sb, char *webpath);
-int add_discovered_path(struct super_block *sb, char *webpath, char *linux_path);
+char *find_discovered_path(struct super_block *sb, const char *webpath);
+/*adds webpath unless it is known already*/
+int add_discovered_path(struct super_block *sb, const char *webpath, char *linux_path);
 
 inline struct dentry *surffs_mount(struct file_system_type *type, int flags,
                                      char const *url, void *data);
@@ -38,6 +76,8 @@ inline void surffs_unmount(struct super_block *sb);
 
 inline struct surffs_sb_info *SURFFS_SB(struct super_block *sb);
 
+int surffs_statfs(struct dentry *dentry, struct kstatfs *buf);
+
 #endif
 
 
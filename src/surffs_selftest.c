@@ -0,0 +1,394 @@
+#include "surffs_selftest.h"
+#include "surffs_debug.h"
+#include "surffs_fetch.h"
+#include "surffs_socket.h"
+#include "surffs_inode.h"
+#include "surffs_sb.h"
+#include "surffs_sitemap.h"
+#include <linux/mount.h>
+#include <linux/namei.h>
+#include <linux/file.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/cred.h>
+#include <linux/math64.h>
+
+/*
+ * Site of "sfstest" backend is generated from path:
+ *     "/"   - root page with mock_links links to "/0" ... "/<mock_links - 1>"
+ *     "/<n>" - page with links "Home" to "/" and "Next" to "/<n + 1>"
+ * Symlinks are created for "Home" links, as root is always discovered.
+ */
+static int mock_links;
+
+static const int selftest_sizes[] = {1000, 10000, 100000};
+
+/*lookups of every size are done for this number of evenly spread links*/
+#define SELFTEST_SAMPLE 1000
+
+#define SELFTEST_CHECK(cond, fmt, ...) \
+    do { \
+        if (!(cond)) \
+        { \
+            sfs_error("selftest failed: " fmt "\n", ##__VA_ARGS__); \
+            ret = -EINVAL; \
+            goto out; \
+        } \
+    } while (0)
+
+static int mock_fetch(struct surffs_sb_info *fsi,
+                      struct SURFFS_WEB_ADDRESS *address,
+                      struct surffs_validators *cond,
+                      sfs_string *http_response,
+                      char **http_payload_start,
+                      struct sfs_event_log *log)
+{
+    int ret = 0;
+    char *path = address->path.data;
+    unsigned int n;
+    int i;
+
+    ret = sfs_string_clear(http_response);
+    if (ret) goto out;
+
+    if (strcmp(path, "/") == 0)
+    {
+        ret = sfs_string_cat(http_response, "HTTP/1.1 200 OK\r\n\r\n<html><body>\n");
+        for (i = 0; i < mock_links && !ret; i++)
+            ret = sfs_string_catf(http_response, "<a href=\"/%d\">%d</a>\n", i, i);
+    }
+    else if (sscanf(path, "/%u", &n) == 1 && n < mock_links)
+    {
+        ret = sfs_string_catf(http_response,
+                              "HTTP/1.1 200 OK\r\n\r\n<html><body>\n"
+                              "<a href=\"/\">Home</a>\n"
+                              "<a href=\"/%u\">Next</a>\n",
+                              (n + 1) % mock_links);
+    }
+    else
+    {
+        ret = sfs_string_cat(http_response, "HTTP/1.1 404 Not Found\r\n\r\n");
+    }
+
+    if (!ret) ret = sfs_string_cat(http_response, "</body></html>\n");
+    if (ret) goto out;
+
+    ret = surffs_extract_http_payload(http_response, http_payload_start, log);
+
+out:
+    return ret;
+}
+
+static struct surffs_fetch_backend mock_backend = {
+    .name   = "sfstest",
+    .fetch  = mock_fetch,
+};
+
+struct selftest_readdir
+{
+    struct dir_context ctx;
+    int entries;
+    int dirs;
+};
+
+static int selftest_filldir(void *buf, const char *name, int namelen,
+                            loff_t offset, u64 ino, unsigned int d_type)
+{
+    struct selftest_readdir *rd = buf;
+
+    rd->entries++;
+    if (d_type == DT_DIR) rd->dirs++;
+
+    return 0;
+}
+
+static int selftest_readdir(struct path *root, struct selftest_readdir *rd)
+{
+    int ret = 0;
+    struct file *file;
+
+    memset(rd, 0, sizeof(*rd));
+    rd->ctx.actor = selftest_filldir;
+
+    file = dentry_open(root, O_RDONLY | O_DIRECTORY, current_cred());
+    if (IS_ERR(file)) return PTR_ERR(file);
+
+    ret = iterate_dir(file, &rd->ctx);
+    fput(file);
+
+    return ret;
+}
+
+static struct dentry *selftest_lookup(struct dentry *dir, const char *name)
+{
+    struct dentry *dentry;
+
+    mutex_lock(&dir->d_inode->i_mutex);
+    dentry = lookup_one_len(name, dir, strlen(name));
+    mutex_unlock(&dir->d_inode->i_mutex);
+
+    return dentry;
+}
+
+/*links are prepended while parsing, so they are looked up by title*/
+static struct SURFFS_HTML_LINK *selftest_find_link(struct SURFFS_WEB_PAGE *webpage,
+                                                   const char *title)
+{
+    struct SURFFS_HTML_LINK *link;
+
+    list_for_each_entry(link, &webpage->html_links, html_links)
+        if (strcmp(link->title.data, title) == 0)
+            return link;
+
+    return 0;
+}
+
+static u64 elapsed_ns(ktime_t start)
+{
+    return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+struct selftest_result
+{
+    int links;
+    u64 readdir_ns;
+    u64 lookup_ns;
+    u64 symlink_ns;
+};
+
+static int selftest_site(struct file_system_type *fs_type, int links,
+                         struct selftest_result *res)
+{
+    int ret = 0;
+    char url[64];
+    char options[] = "ip=127.0.0.1";
+    struct vfsmount *mnt = 0;
+    struct path root;
+    struct selftest_readdir rd;
+    struct SURFFS_WEB_PAGE *webpage;
+    struct SURFFS_HTML_LINK *link;
+    struct SURFFS_HTML_LINK *home;
+    struct dentry **dirs = 0;
+    struct dentry *dentry;
+    struct path target;
+    int step = max(links / SELFTEST_SAMPLE, 1);
+    int ndirs = 0;
+    int at_root;
+    int i;
+    ktime_t start;
+
+    mock_links = links;
+    res->links = links;
+
+    /*host differs for every size, so pages are not taken from cache*/
+    snprintf(url, sizeof(url), "sfstest://n%d.selftest/", links);
+    mnt = vfs_kern_mount(fs_type, MS_KERNMOUNT, url, options);
+    if (IS_ERR(mnt)) {ret = PTR_ERR(mnt); mnt = 0; goto out;}
+
+    root.mnt = mnt;
+    root.dentry = mnt->mnt_root;
+
+    /*first readdir loads root page*/
+    ret = selftest_readdir(&root, &rd);
+    if (ret) goto out;
+
+    webpage = SURFFS_INODE(root.dentry->d_inode)->webpage;
+    SELFTEST_CHECK(webpage && webpage->status == STATUS_OK, "%s: root page not loaded", url);
+    SELFTEST_CHECK(webpage->links_count == (u32)links, "%s: %u links parsed, expected %d",
+                   url, webpage->links_count, links);
+
+    start = ktime_get();
+    ret = selftest_readdir(&root, &rd);
+    res->readdir_ns = elapsed_ns(start);
+    if (ret) goto out;
+
+    SELFTEST_CHECK(rd.entries == links + 6 && rd.dirs == links + 2,
+                   "%s: readdir gave %d entries (%d dirs), expected %d (%d)",
+                   url, rd.entries, rd.dirs, links + 6, links + 2);
+
+    dirs = kcalloc(SELFTEST_SAMPLE, sizeof(struct dentry *), GFP_KERNEL);
+    if (!dirs) {ret = -ENOMEM; goto out;}
+
+    /*subdirs: every lookup walks links of root page*/
+    i = 0;
+    start = ktime_get();
+    list_for_each_entry(link, &webpage->html_links, html_links)
+    {
+        if (i++ % step || ndirs == SELFTEST_SAMPLE) continue;
+
+        dentry = selftest_lookup(root.dentry, link->title.data);
+        if (IS_ERR(dentry)) {ret = PTR_ERR(dentry); goto out;}
+        dirs[ndirs++] = dentry;
+
+        SELFTEST_CHECK(dentry->d_inode && S_ISDIR(dentry->d_inode->i_mode),
+                       "%s: '%s' is not a directory", url, link->title.data);
+        SELFTEST_CHECK(strcmp(SURFFS_DIR_INODE(dentry->d_inode)->webPath.data,
+                              link->path.data) == 0,
+                       "%s: '%s' points to '%s', expected '%s'", url, link->title.data,
+                       SURFFS_DIR_INODE(dentry->d_inode)->webPath.data, link->path.data);
+    }
+    res->lookup_ns = div_u64(elapsed_ns(start), ndirs);
+
+    /*load pages of subdirs, so only symlink creation is timed below*/
+    for (i = 0; i < ndirs; i++)
+    {
+        dentry = selftest_lookup(dirs[i], "status");
+        if (IS_ERR(dentry)) {ret = PTR_ERR(dentry); goto out;}
+        dput(dentry);
+    }
+
+    res->symlink_ns = 0;
+    for (i = 0; i < ndirs; i++)
+    {
+        webpage = SURFFS_INODE(dirs[i]->d_inode)->webpage;
+        SELFTEST_CHECK(webpage && webpage->links_count == 2,
+                       "%s: page of '%s' not loaded", url, dirs[i]->d_name.name);
+        home = selftest_find_link(webpage, "Home_link1");
+        SELFTEST_CHECK(home, "%s: page of '%s' has no Home link", url, dirs[i]->d_name.name);
+
+        start = ktime_get();
+        dentry = selftest_lookup(dirs[i], home->title.data);
+        res->symlink_ns += elapsed_ns(start);
+        if (IS_ERR(dentry)) {ret = PTR_ERR(dentry); goto out;}
+
+        if (!dentry->d_inode || !S_ISLNK(dentry->d_inode->i_mode))
+        {
+            dput(dentry);
+            SELFTEST_CHECK(0, "%s: '%s/%s' is not a symlink", url,
+                           dirs[i]->d_name.name, home->title.data);
+        }
+        dput(dentry);
+
+        ret = vfs_path_lookup(dirs[i], mnt, home->title.data, LOOKUP_FOLLOW, &target);
+        if (ret) goto out;
+        at_root = target.dentry == root.dentry;
+        path_put(&target);
+        SELFTEST_CHECK(at_root, "%s: '%s/%s' does not lead to root",
+                       url, dirs[i]->d_name.name, home->title.data);
+    }
+    res->symlink_ns = div_u64(res->symlink_ns, ndirs);
+
+out:
+    if (dirs)
+    {
+        for (i = 0; i < ndirs; i++) dput(dirs[i]);
+        kfree(dirs);
+    }
+    if (mnt) kern_unmount(mnt);
+
+    return ret;
+}
+
+/*
+ * Sitemap parser is fed by chunks: text split at every offset, inside
+ * <loc> and <lastmod>, tags and entities among them, gives the same items
+ */
+static const char selftest_sitemap_xml[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<urlset xmlns=\"http://www.sitemaps.org/schemas/sitemap/0.9\">\n"
+    "<url><loc> http://www.example.com/a?x=1&amp;y=2 </loc>"
+    "<lastmod>2024-05-01T10:00:00+02:00</lastmod></url>\n"
+    "<!-- no <url> here -->\n"
+    "<sm:url><sm:loc>http://www.example.com/b</sm:loc></sm:url>\n"
+    "</urlset>\n";
+
+static const char selftest_sitemap_items[] =
+    "0 http://www.example.com/a?x=1&y=2 2024-05-01T10:00:00+02:00\n"
+    "0 http://www.example.com/b \n";
+
+static int selftest_sitemap_item(struct surffs_sitemap_parser *parser,
+                                 enum SURFFS_SITEMAP_ITEM item)
+{
+    return sfs_string_catf(parser->data, "%d %s %s\n", item,
+                           parser->loc.data, parser->lastmod.data);
+}
+
+static int selftest_sitemap(void)
+{
+    int ret = 0;
+    struct surffs_sitemap_parser parser;
+    sfs_string items = {0};
+    size_t len = strlen(selftest_sitemap_xml);
+    size_t split;
+
+    ret = sfs_string_createz(&items, 256);
+    if (ret) goto out;
+
+    for (split = 0; split <= len; split++)
+    {
+        ret = surffs_sitemap_parser_init(&parser);
+        parser.item = selftest_sitemap_item;
+        parser.data = &items;
+        if (!ret) ret = sfs_string_clear(&items);
+        if (!ret) ret = surffs_sitemap_parse(&parser, selftest_sitemap_xml, split);
+        if (!ret) ret = surffs_sitemap_parse(&parser, selftest_sitemap_xml + split, len - split);
+        surffs_sitemap_parser_free(&parser);
+        if (ret) goto out;
+
+        SELFTEST_CHECK(strcmp(items.data, selftest_sitemap_items) == 0,
+                       "sitemap split at %zu gives items\n%s", split, items.data);
+    }
+
+out:
+    sfs_string_free(&items);
+
+    return ret;
+}
+
+/*operation must not grow faster than linearly with number of links*/
+static int check_growth(const char *op, struct selftest_result *prev,
+                        struct selftest_result *cur, u64 prev_ns, u64 cur_ns)
+{
+    u64 limit = div_u64(2 * prev_ns * cur->links, prev->links);
+
+    if (prev_ns && cur_ns > limit)
+    {
+        sfs_error("selftest failed: %s takes %lluns at %d links and %lluns at %d links\n",
+                  op, prev_ns, prev->links, cur_ns, cur->links);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+int surffs_selftest(struct file_system_type *fs_type)
+{
+    int ret = 0;
+    struct selftest_result res[ARRAY_SIZE(selftest_sizes)];
+    int i;
+
+    ret = selftest_sitemap();
+    if (ret) return ret;
+
+    ret = surffs_register_backend(&mock_backend);
+    if (ret) return ret;
+
+    for (i = 0; i < ARRAY_SIZE(selftest_sizes); i++)
+    {
+        ret = selftest_site(fs_type, selftest_sizes[i], &res[i]);
+        if (ret) goto out;
+
+        printk(KERN_INFO "surffs selftest: %d links: readdir %lluus, lookup %lluns, "
+                         "symlink lookup %lluns\n",
+               res[i].links, div_u64(res[i].readdir_ns, 1000), res[i].lookup_ns, res[i].symlink_ns);
+
+        if (i == 0) continue;
+
+        ret = check_growth("readdir", &res[i - 1], &res[i],
+                           res[i - 1].readdir_ns, res[i].readdir_ns);
+        if (!ret) ret = check_growth("lookup", &res[i - 1], &res[i],
+                                     res[i - 1].lookup_ns, res[i].lookup_ns);
+        if (!ret) ret = check_growth("symlink lookup", &res[i - 1], &res[i],
+                                     res[i - 1].symlink_ns, res[i].symlink_ns);
+        if (ret) goto out;
+    }
+
+    printk(KERN_INFO "surffs selftest: passed\n");
+
+out:
+    surffs_unregister_backend(&mock_backend);
+    /*pages of test sites are not needed any more*/
+    free_webpages();
+
+    return ret;
+}
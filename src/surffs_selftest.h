@@ -0,0 +1,23 @@
+#ifndef _SURFFS_SELFTEST_H_
+#define _SURFFS_SELFTEST_H_
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+
+/*
+ * Checks lookup, readdir and symlinks of a site served from memory and
+ * times them on directories of 1k-100k links, and checks sitemap parser
+ * on text split into chunks at every offset. Built with
+ * "make SURFFS_SELFTEST=1", runs at module loading (also under UML),
+ * failure of it fails loading.
+ */
+#ifdef SURFFS_SELFTEST
+int surffs_selftest(struct file_system_type *fs_type);
+#else
+static inline int surffs_selftest(struct file_system_type *fs_type)
+{
+    return 0;
+}
+#endif
+
+#endif
@@ -0,0 +1,480 @@
+#include "surffs_sitemap.h"
+#include "surffs_debug.h"
+#include "surffs_sb.h"
+#include "surffs_fetch.h"
+#include "surffs_socket.h"
+#include "surffs_parser.h"
+#include "surffs_arena.h"
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/ctype.h>
+#include <linux/time.h>
+#include <linux/dcache.h>
+
+void surffs_sitemap_init(struct surffs_sitemap *sitemap)
+{
+    hash_init(sitemap->table);
+    sitemap->path = 0;
+    sitemap->count = 0;
+    sitemap->files = 0;
+}
+
+void surffs_sitemap_free(struct surffs_sitemap *sitemap)
+{
+    int bkt;
+    struct surffs_sitemap_entry *entry;
+    struct hlist_node *tmp;
+
+    hash_for_each_safe(sitemap->table, bkt, tmp, entry, hashlist)
+    {
+        hash_del(&entry->hashlist);
+        kfree(entry);
+    }
+    sitemap->count = 0;
+
+    kfree(sitemap->path);
+    sitemap->path = 0;
+}
+
+int surffs_sitemap_set_path(struct surffs_sitemap *sitemap, const char *path)
+{
+    if (path[0] != '/')
+    {
+        sfs_error("error mount surffs: sitemap must be a path on the site\n");
+        return -EINVAL;
+    }
+
+    kfree(sitemap->path);
+    sitemap->path = kstrdup(path, GFP_KERNEL);
+
+    return sitemap->path ? 0 : -ENOMEM;
+}
+
+struct surffs_sitemap_entry *surffs_sitemap_find(struct surffs_sitemap *sitemap,
+                                                 const char *webpath)
+{
+    struct surffs_sitemap_entry *entry;
+    unsigned int hash;
+
+    if (!sitemap->count) return 0;
+
+    hash = full_name_hash(webpath, strlen(webpath));
+    hash_for_each_possible(sitemap->table, entry, hashlist, hash)
+        if (strcmp(entry->path, webpath) == 0) return entry;
+
+    return 0;
+}
+
+/*later lastmod wins for paths listed twice*/
+static int sitemap_add(struct surffs_sitemap *sitemap, const char *webpath,
+                       unsigned long lastmod)
+{
+    struct surffs_sitemap_entry *entry;
+    size_t len = strlen(webpath);
+    unsigned int hash;
+
+    entry = surffs_sitemap_find(sitemap, webpath);
+    if (entry)
+    {
+        if (lastmod > entry->lastmod) entry->lastmod = lastmod;
+        return 0;
+    }
+
+    entry = kmalloc(sizeof(struct surffs_sitemap_entry) + len + 1, GFP_KERNEL);
+    if (!entry) return -ENOMEM;
+
+    entry->lastmod = lastmod;
+    memcpy(entry->path, webpath, len + 1);
+
+    hash = full_name_hash(webpath, len);
+    hash_add(sitemap->table, &entry->hashlist, hash);
+    sitemap->count++;
+
+    return 0;
+}
+
+unsigned long surffs_sitemap_parse_time(const char *text)
+{
+    unsigned int year = 0, mon = 1, day = 1;
+    unsigned int hour = 0, min = 0, sec = 0;
+    unsigned int tz_hour = 0, tz_min = 0;
+    long offset = 0;
+    const char *p;
+
+    if (sscanf(text, "%4u-%2u-%2u", &year, &mon, &day) < 1) return 0;
+    if (year < 1970 || mon < 1 || mon > 12 || day < 1 || day > 31) return 0;
+
+    p = strchr(text, 'T');
+    if (p)
+    {
+        if (sscanf(p + 1, "%2u:%2u:%2u", &hour, &min, &sec) < 2) return 0;
+        if (hour > 23 || min > 59 || sec > 60) return 0;
+
+        p = strpbrk(p + 1, "Z+-");
+        if (p && *p != 'Z')
+        {
+            if (sscanf(p + 1, "%2u:%2u", &tz_hour, &tz_min) != 2) return 0;
+            offset = tz_hour * 3600 + tz_min * 60;
+            if (*p == '-') offset = -offset;
+        }
+    }
+
+    return mktime(year, mon, day, hour, min, sec) - offset;
+}
+
+/*parser*/
+
+int surffs_sitemap_parser_init(struct surffs_sitemap_parser *parser)
+{
+    int ret = 0;
+
+    memset(parser, 0, sizeof(*parser));
+
+    ret = sfs_string_createz(&parser->loc, 256);
+    if (!ret) ret = sfs_string_createz(&parser->lastmod, 32);
+
+    return ret;
+}
+
+void surffs_sitemap_parser_free(struct surffs_sitemap_parser *parser)
+{
+    sfs_string_free(&parser->loc);
+    sfs_string_free(&parser->lastmod);
+}
+
+static const struct
+{
+    const char *name;
+    char value;
+} sitemap_entities[] = {
+    {"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''}
+};
+
+/*trims whitespace and decodes predefined xml entities in place*/
+static void sitemap_text(sfs_string *str)
+{
+    char *src = str->data;
+    char *dst = str->data;
+    char *end = str->data + str->textlen;
+    size_t len;
+    int i;
+
+    while (end > src && isspace(end[-1])) end--;
+    while (src < end && isspace(*src)) src++;
+
+    while (src < end)
+    {
+        for (i = 0; *src == '&' && i < ARRAY_SIZE(sitemap_entities); i++)
+        {
+            len = strlen(sitemap_entities[i].name);
+            if (end - src >= len && memcmp(src, sitemap_entities[i].name, len) == 0) break;
+        }
+
+        if (*src == '&' && i < ARRAY_SIZE(sitemap_entities))
+        {
+            *dst++ = sitemap_entities[i].value;
+            src += len;
+        }
+        else
+        {
+            *dst++ = *src++;
+        }
+    }
+
+    *dst = 0;
+    str->textlen = dst - str->data;
+}
+
+static int sitemap_collect(struct surffs_sitemap_parser *parser, const char *text, size_t len)
+{
+    sfs_string *str = parser->field == SITEMAP_FIELD_LOC ? &parser->loc : &parser->lastmod;
+
+    if (parser->too_long) return 0;
+
+    if (str->textlen + len > SURFFS_SITEMAP_MAX_TEXT)
+    {
+        parser->too_long = 1;
+        return 0;
+    }
+
+    return sfs_string_ncat(str, text, len);
+}
+
+static int sitemap_end_tag(struct surffs_sitemap_parser *parser)
+{
+    int ret = 0;
+    int closing = parser->tag[0] == '/';
+    char *name = parser->tag + closing;
+    char *colon;
+
+    parser->tag[parser->tag_len] = 0;
+
+    /*namespace prefix*/
+    colon = strrchr(name, ':');
+    if (colon) name = colon + 1;
+
+    if (strcmp(name, "url") == 0 || strcmp(name, "sitemap") == 0)
+    {
+        if (!closing)
+        {
+            ret = sfs_string_clear(&parser->loc);
+            if (!ret) ret = sfs_string_clear(&parser->lastmod);
+            parser->too_long = 0;
+        }
+        else if (!parser->too_long && parser->loc.textlen)
+        {
+            sitemap_text(&parser->loc);
+            sitemap_text(&parser->lastmod);
+            ret = parser->item(parser, name[0] == 'u' ? SITEMAP_URL : SITEMAP_CHILD);
+        }
+        parser->field = SITEMAP_FIELD_NONE;
+    }
+    else if (strcmp(name, "loc") == 0)
+    {
+        parser->field = closing ? SITEMAP_FIELD_NONE : SITEMAP_FIELD_LOC;
+        if (!closing) ret = sfs_string_clear(&parser->loc);
+    }
+    else if (strcmp(name, "lastmod") == 0)
+    {
+        parser->field = closing ? SITEMAP_FIELD_NONE : SITEMAP_FIELD_LASTMOD;
+        if (!closing) ret = sfs_string_clear(&parser->lastmod);
+    }
+
+    return ret;
+}
+
+int surffs_sitemap_parse(struct surffs_sitemap_parser *parser, const char *text, size_t len)
+{
+    int ret = 0;
+    const char *end = text + len;
+    const char *lt;
+    char c;
+
+    while (text < end && !ret)
+    {
+        if (!parser->in_tag)
+        {
+            lt = memchr(text, '<', end - text);
+            if (!lt) lt = end;
+
+            if (parser->field != SITEMAP_FIELD_NONE)
+                ret = sitemap_collect(parser, text, lt - text);
+
+            text = lt;
+            if (text < end)
+            {
+                parser->in_tag = 1;
+                parser->skip_tag = 0;
+                parser->name_done = 0;
+                parser->tag_len = 0;
+                text++;
+            }
+            continue;
+        }
+
+        c = *text++;
+
+        if (c == '>')
+        {
+            parser->in_tag = 0;
+            if (!parser->skip_tag && parser->tag_len) ret = sitemap_end_tag(parser);
+        }
+        else if (parser->skip_tag || parser->name_done)
+        {
+            continue;
+        }
+        else if (!parser->tag_len && (c == '!' || c == '?'))
+        {
+            parser->skip_tag = 1;
+        }
+        else if (isspace(c) || (c == '/' && parser->tag_len))
+        {
+            /*attributes are not needed*/
+            parser->name_done = 1;
+        }
+        else if (parser->tag_len < sizeof(parser->tag) - 1)
+        {
+            parser->tag[parser->tag_len++] = c;
+        }
+        else
+        {
+            parser->skip_tag = 1;
+        }
+    }
+
+    return ret;
+}
+
+/*loading*/
+
+struct sitemap_load
+{
+    struct surffs_sb_info *fsi;
+    char *queue[SURFFS_SITEMAP_MAX_FILES];
+    int queued;
+    int full;
+    sfs_string protocol;
+    sfs_string host;
+    sfs_string path;
+};
+
+/*path of loc on the site of mount, 0 if loc is on another site*/
+static int sitemap_path(struct sitemap_load *load, const char *loc, int *ours)
+{
+    int ret = 0;
+    char *fragment;
+
+    *ours = 0;
+
+    ret = extract_url_params(loc, &load->protocol, &load->host, &load->path, PREFER_HOST);
+    if (ret) return ret;
+
+    if (strcmp(load->protocol.data, "http") != 0 && strcmp(load->protocol.data, "https") != 0)
+        return 0;
+    if (strcasecmp(load->host.data, load->fsi->root_web_address->host.data) != 0)
+        return 0;
+
+    fragment = strchr(load->path.data, '#');
+    if (fragment)
+    {
+        *fragment = 0;
+        load->path.textlen = fragment - load->path.data;
+    }
+
+    *ours = load->path.textlen > 0;
+
+    return 0;
+}
+
+static int sitemap_item(struct surffs_sitemap_parser *parser, enum SURFFS_SITEMAP_ITEM item)
+{
+    int ret = 0;
+    struct sitemap_load *load = parser->data;
+    struct surffs_sitemap *sitemap = &load->fsi->sitemap;
+    u32 count = sitemap->count;
+    int ours;
+
+    ret = sitemap_path(load, parser->loc.data, &ours);
+    if (ret || !ours) return ret;
+
+    if (item == SITEMAP_CHILD)
+    {
+        if (load->queued == SURFFS_SITEMAP_MAX_FILES) return 0;
+
+        load->queue[load->queued] = kstrdup(load->path.data, GFP_KERNEL);
+        if (!load->queue[load->queued]) return -ENOMEM;
+        load->queued++;
+
+        return 0;
+    }
+
+    if (count == SURFFS_SITEMAP_MAX_URLS)
+    {
+        load->full = 1;
+        return 0;
+    }
+
+    ret = sitemap_add(sitemap, load->path.data, surffs_sitemap_parse_time(parser->lastmod.data));
+    if (ret) return ret;
+
+    if (sitemap->count != count) sfs_stat_inc(&load->fsi->stats, SFS_STAT_SITEMAP_URLS);
+
+    return 0;
+}
+
+static int sitemap_load_file(struct sitemap_load *load, const char *path)
+{
+    int ret = 0;
+    struct surffs_sb_info *fsi = load->fsi;
+    struct SURFFS_WEB_ADDRESS address = *fsi->root_web_address;
+    struct surffs_sitemap_parser parser;
+    sfs_string webpath = {0};
+    struct sfs_arena arena;
+    struct sfs_event_log log;
+    sfs_string resp = {0};
+    char *payload = 0;
+    int status;
+
+    sfs_arena_init(&arena);
+    sfs_event_log_init(&log, &arena);
+
+    ret = surffs_sitemap_parser_init(&parser);
+    if (!ret) ret = sfs_string_createz(&resp, 4096);
+    if (!ret) ret = sfs_string_create(&webpath, path);
+    if (ret) goto out;
+
+    address.path = webpath;
+
+    parser.item = sitemap_item;
+    parser.data = load;
+
+    ret = surffs_fetch(fsi, &address, 0, &resp, &payload, &log);
+    status = surffs_http_status(&resp);
+    if (ret || status != 200 || !payload)
+    {
+        if (ret == -ENOMEM) goto out;
+        sfs_warning("sitemap %s of %s is not loaded: http status %d, error code %d\n",
+                    path, address.host.data, status, ret);
+        ret = 0;
+        goto out;
+    }
+
+    if ((u8)payload[0] == 0x1f && (u8)payload[1] == 0x8b)
+    {
+        sfs_warning("sitemap %s of %s is compressed, skipped\n", path, address.host.data);
+        goto out;
+    }
+
+    fsi->sitemap.files++;
+    ret = surffs_sitemap_parse(&parser, payload, resp.textlen - (payload - resp.data));
+
+out:
+    sfs_string_free(&webpath);
+    sfs_string_free(&resp);
+    surffs_sitemap_parser_free(&parser);
+    sfs_arena_free(&arena);
+
+    return ret;
+}
+
+int surffs_sitemap_load(struct surffs_sb_info *fsi)
+{
+    int ret = 0;
+    struct sitemap_load *load;
+    int i;
+
+    if (!fsi->sitemap.path) return 0;
+
+    load = kzalloc(sizeof(struct sitemap_load), GFP_KERNEL);
+    if (!load) return -ENOMEM;
+
+    load->fsi = fsi;
+
+    ret = sfs_string_createz(&load->protocol, 16); if (ret) goto out;
+    ret = sfs_string_createz(&load->host, 64); if (ret) goto out;
+    ret = sfs_string_createz(&load->path, 128); if (ret) goto out;
+
+    ret = sitemap_load_file(load, fsi->sitemap.path);
+
+    /*sitemaps listed by index, sitemap of index itself is not queued again*/
+    for (i = 0; i < load->queued && !ret; i++)
+        if (strcmp(load->queue[i], fsi->sitemap.path) != 0)
+            ret = sitemap_load_file(load, load->queue[i]);
+    if (ret) goto out;
+
+    if (load->full)
+        sfs_warning("sitemap of %s lists more than %d urls, the rest is skipped\n",
+                    fsi->root_web_address->host.data, SURFFS_SITEMAP_MAX_URLS);
+
+    sfs_info("sitemap of %s: %u urls in %u files\n", fsi->root_web_address->host.data,
+             fsi->sitemap.count, fsi->sitemap.files);
+
+out:
+    for (i = 0; i < load->queued; i++) kfree(load->queue[i]);
+    sfs_string_free(&load->protocol);
+    sfs_string_free(&load->host);
+    sfs_string_free(&load->path);
+    kfree(load);
+
+    return ret;
+}
@@ -0,0 +1,91 @@
+#ifndef _SURFFS_SITEMAP_H_
+#define _SURFFS_SITEMAP_H_
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/hashtable.h>
+#include "surffs_helpers.h"
+
+/*
+ * Pages listed by sitemap.xml of site (option sitemap or sitemap=<path>).
+ * Sitemap is fetched and parsed at mounting, a sitemap index brings in
+ * the sitemaps it lists (same host only, SURFFS_SITEMAP_MAX_FILES at most).
+ * Table is filled before mount is visible and is read-only afterwards,
+ * so lookups need no lock. Entries live until unmount.
+ */
+#define SURFFS_SITEMAP_PATH         "/sitemap.xml"
+#define SURFFS_SITEMAP_MAX_FILES    64
+#define SURFFS_SITEMAP_MAX_URLS     (1 << 20)
+/*longer <loc> or <lastmod> make entry be skipped*/
+#define SURFFS_SITEMAP_MAX_TEXT     2048
+
+struct surffs_sitemap_entry
+{
+    struct hlist_node hashlist;
+    unsigned long lastmod;      /*seconds, 0 - unknown*/
+    char path[0];
+};
+
+struct surffs_sitemap
+{
+    DECLARE_HASHTABLE(table, 12);
+    char *path;                 /*NULL - sitemap is not used*/
+    u32 count;
+    u32 files;
+};
+
+struct surffs_sb_info;
+
+void surffs_sitemap_init(struct surffs_sitemap *sitemap);
+void surffs_sitemap_free(struct surffs_sitemap *sitemap);
+int  surffs_sitemap_set_path(struct surffs_sitemap *sitemap, const char *path);
+
+/*fetches and parses sitemap of mount, fails on errors of memory only*/
+int  surffs_sitemap_load(struct surffs_sb_info *fsi);
+
+/*NULL if webpath is not listed*/
+struct surffs_sitemap_entry *surffs_sitemap_find(struct surffs_sitemap *sitemap,
+                                                 const char *webpath);
+
+/*W3C datetime ("2024-05-01", "2024-05-01T10:00:00+02:00") in seconds, 0 if invalid*/
+unsigned long surffs_sitemap_parse_time(const char *text);
+
+enum SURFFS_SITEMAP_ITEM
+{
+    SITEMAP_URL = 0,            /*<url> of urlset*/
+    SITEMAP_CHILD               /*<sitemap> of sitemapindex*/
+};
+
+enum SURFFS_SITEMAP_FIELD
+{
+    SITEMAP_FIELD_NONE = 0,
+    SITEMAP_FIELD_LOC,
+    SITEMAP_FIELD_LASTMOD
+};
+
+/*
+ * Streaming parser: text is fed in chunks split at any byte, state between
+ * chunks is the current tag name and text of <loc> and <lastmod>.
+ * Callback gets every <url> and <sitemap> with its raw loc and lastmod.
+ */
+struct surffs_sitemap_parser
+{
+    int in_tag;
+    int skip_tag;               /*comment, declaration or too long name*/
+    int name_done;              /*attributes follow*/
+    char tag[16];
+    u32 tag_len;
+    enum SURFFS_SITEMAP_FIELD field;
+    sfs_string loc;
+    sfs_string lastmod;
+    int too_long;
+
+    int (*item)(struct surffs_sitemap_parser *parser, enum SURFFS_SITEMAP_ITEM item);
+    void *data;
+};
+
+int  surffs_sitemap_parser_init(struct surffs_sitemap_parser *parser);
+void surffs_sitemap_parser_free(struct surffs_sitemap_parser *parser);
+int  surffs_sitemap_parse(struct surffs_sitemap_parser *parser, const char *text, size_t len);
+
+#endif
@@ -26,125 +26,213 @@
 #include "surffs_debug.h"
 #include "surffs_helpers.h"
 #include "surffs.h"
+#include "surffs_sb.h"
+#include "surffs_stats.h"
+#include "surffs_timeout.h"
+#include <linux/sched.h>
+
+/*
+ * -EINTR if fetch is killed, -ERESTARTSYS if it is interrupted by other
+ * signal, -ECANCELED if it is cancelled by surffs_http_cancel()
+ */
+static int fetch_interrupted(struct surffs_http_ctl *ctl)
+{
+    if (ctl && ACCESS_ONCE(ctl->cancelled)) return -ECANCELED;
+    if (fatal_signal_pending(current)) return -EINTR;
+    if (signal_pending(current)) return -ERESTARTSYS;
+    return 0;
+}
 
-static int surffs_alloc_and_connect_socket(struct socket **skt, char *ip, int *connect_ok, sfs_string *log)
+static long timeout_jiffies(unsigned int ms)
+{
+    return ms ? msecs_to_jiffies(ms) : MAX_SCHEDULE_TIMEOUT;
+}
+
+static int log_timeout(struct sfs_event_log *log, struct surffs_stats *stats,
+                       struct surffs_timeouts *touts, __be32 daddr,
+                       enum SURFFS_TIMEOUT_PHASE phase, unsigned int ms)
+{
+    sfs_stat_inc(stats, SFS_STAT_ERR_TIMEOUT);
+    surffs_timeout_backoff(touts, phase);
+
+    return sfs_event_log_add(log, EV_TIMEOUT, phase, (__force u32)daddr, ms);
+}
+
+void surffs_http_ctl_init(struct surffs_http_ctl *ctl, wait_queue_head_t *wq)
+{
+    memset(ctl, 0, sizeof(*ctl));
+    mutex_init(&ctl->lock);
+    ctl->wq = wq;
+    ctl->origin = -1;
+}
+
+void surffs_http_cancel(struct surffs_http_ctl *ctl)
+{
+    mutex_lock(&ctl->lock);
+    ctl->cancelled = 1;
+    if (ctl->skt) kernel_sock_shutdown(ctl->skt, SHUT_RDWR);
+    mutex_unlock(&ctl->lock);
+}
+
+static int http_ctl_attach(struct surffs_http_ctl *ctl, struct socket *skt)
 {
-    mm_segment_t oldfs;
+    int ret = 0;
+
+    if (!ctl) return 0;
+
+    mutex_lock(&ctl->lock);
+    if (ctl->cancelled) ret = -ECANCELED;
+    else ctl->skt = skt;
+    mutex_unlock(&ctl->lock);
+
+    return ret;
+}
+
+static void http_ctl_detach(struct surffs_http_ctl *ctl)
+{
+    if (!ctl) return;
+
+    mutex_lock(&ctl->lock);
+    ctl->skt = 0;
+    mutex_unlock(&ctl->lock);
+}
+
+void surffs_http_ctl_first_byte(struct surffs_http_ctl *ctl)
+{
+    if (!ctl) return;
+
+    ctl->first_byte_at = ktime_get();
+    smp_wmb();
+    ctl->first_byte = 1;
+    wake_up(ctl->wq);
+}
+
+static int surffs_alloc_and_connect_socket(struct socket **skt, char *ip, u16 port,
+                                           int *connect_ok,
+                                           struct sfs_event_log *log,
+                                           struct surffs_stats *stats,
+                                           struct surffs_timeouts *touts,
+                                           struct surffs_http_ctl *ctl)
+{
+    ktime_t start;
     int ret = 0;
     int errcode;
+    unsigned int tout_ms = surffs_timeout_ms(touts, SFS_TOUT_CONNECT);
     struct sockaddr_in* dest = {0};
-    char tmpbuf[256];
-    struct timeval tv = {
-        .tv_sec = SURFFS_SOCKET_TOUT_SEC,
-        .tv_usec = SURFFS_SOCKET_TOUT_USEC
-    };
-
-    sfs_enter();
-    sfs_debug("surffs_alloc_and_connect_socket\n");
 
     *connect_ok = 0;
 
     ret = sock_create(PF_INET,SOCK_STREAM,IPPROTO_TCP,skt);
     if (ret) goto out;
 
+    ret = http_ctl_attach(ctl, *skt);
+    if (ret) goto out;
 
-    oldfs=get_fs();
-    set_fs(KERNEL_DS);
-
-    ret = sock_setsockopt(*skt, SOL_SOCKET, SO_RCVTIMEO,
-                         (char *)&tv, sizeof(tv));
-    if (ret)
-    {
-        set_fs(oldfs);
-        goto out;
-    }
-
-    ret = sock_setsockopt(*skt, SOL_SOCKET, SO_SNDTIMEO,
-                         (char *)&tv, sizeof(tv));
-    if (ret)
-    {
-        set_fs(oldfs);
-        goto out;
-    }
-    set_fs(oldfs);
+    /*blocking connect waits for sk_sndtimeo*/
+    (*skt)->sk->sk_sndtimeo = timeout_jiffies(tout_ms);
 
     dest = (struct sockaddr_in*)kmalloc(sizeof(struct sockaddr_in), GFP_KERNEL);
     if (!dest) {ret = -ENOMEM; goto out;}
 
     dest->sin_family = AF_INET;
     dest->sin_addr.s_addr = in_aton(ip);
-    dest->sin_port = htons(SURFFS_HTTP_PORT);
-    sfs_debug("connect to %X:%u\n", dest->sin_addr.s_addr, SURFFS_HTTP_PORT);
+    dest->sin_port = htons(port);
 
+    start = ktime_get();
     errcode = (*skt)->ops->connect(*skt, (struct sockaddr*)dest, sizeof(struct sockaddr_in), !O_NONBLOCK);
+    sfs_stat_latency(stats, SFS_PHASE_CONNECT, start);
     if (errcode < 0)
     {
-        sfs_debug("socket connect error\n");
-        snprintf(tmpbuf, sizeof(tmpbuf),
-                 "error connecting to %s:%d, errcode = %d\n",
-                 ip, SURFFS_HTTP_PORT, errcode);
+        ret = fetch_interrupted(ctl);
+        if (ret) goto out;
 
-        ret = sfs_string_cat(log, tmpbuf);
+        if (errcode == -EINPROGRESS)
+        {
+            ret = log_timeout(log, stats, touts, dest->sin_addr.s_addr,
+                              SFS_TOUT_CONNECT, tout_ms);
+            goto out;
+        }
+
+        sfs_stat_inc(stats, SFS_STAT_ERR_CONNECT);
+        ret = sfs_event_log_add(log, EV_CONNECT_ERROR, 0,
+                                (__force u32)dest->sin_addr.s_addr, errcode);
         goto out;
     }
+    surffs_timeout_sample(touts, SFS_TOUT_CONNECT, ktime_us_delta(ktime_get(), start));
 
-    sfs_debug("socket connect OK\n");
-    snprintf(tmpbuf, sizeof(tmpbuf),
-             "connected to %s:%d\n",
-             ip, SURFFS_HTTP_PORT);
-    ret = sfs_string_cat(log, tmpbuf);
+    ret = sfs_event_log_add(log, EV_CONNECTED, 0, (__force u32)dest->sin_addr.s_addr, port);
     if (ret) goto out;
 
     *connect_ok = 1;
 
 out:
-    sfs_leave();
+    if (dest) kfree(dest);
+
     return ret;
 }
 
-static int surffs_make_request(char *path, char *host, sfs_string *request, sfs_string *log)
+int surffs_make_request(char *path, char *host, struct surffs_validators *cond,
+                        sfs_string *request)
 {
     int ret = 0;
-    sfs_enter();
-    sfs_debug("surffs_make_request\n");
 
     ret = sfs_string_clear(request);
     if (ret) goto out;
 
-    ret = sfs_string_cat_param(request, "GET %s HTTP/1.1\n", path);
+    ret = sfs_string_catf(request, "%s %s HTTP/1.1\n"
+                                   "Host: %s\n"
+                                   "User-Agent: surffs_filesystem\n"
+                                   "Accept: text/html\n",
+                          cond && cond->head ? "HEAD" : "GET", path, host);
     if (ret) goto out;
 
-    ret = sfs_string_cat_param(request, "Host: %s\n", host);
-    if (ret) goto out;
-
-    ret = sfs_string_cat(request, "User-Agent: surffs_filesystem\n"
-                                  "Accept: text/html\n"
-                                  "Connection: close\n\n");
-    if (ret) goto out;
+    if (cond && cond->range)
+    {
+        ret = sfs_string_catf(request, "Range: bytes=%llu-%llu\n",
+                              cond->range_first, cond->range_last);
+        if (ret) goto out;
+
+        /*changed page comes whole instead of a range of another version*/
+        if (cond->etag.textlen)
+            ret = sfs_string_catf(request, "If-Range: %s\n", cond->etag.data);
+        else if (cond->last_modified.textlen)
+            ret = sfs_string_catf(request, "If-Range: %s\n", cond->last_modified.data);
+        if (ret) goto out;
+    }
+    else
+    {
+        if (cond && cond->etag.textlen)
+        {
+            ret = sfs_string_catf(request, "If-None-Match: %s\n", cond->etag.data);
+            if (ret) goto out;
+        }
 
-    sfs_debug("request:\n%s\n----------\n", request->data);
+        if (cond && cond->last_modified.textlen)
+        {
+            ret = sfs_string_catf(request, "If-Modified-Since: %s\n", cond->last_modified.data);
+            if (ret) goto out;
+        }
+    }
 
-    ret = sfs_string_cat_param(log, "request:\n%s\n----------\n", request->data);
+    ret = sfs_string_cat(request, "Connection: close\n\n");
     if (ret) goto out;
 
 out:
-    sfs_leave();
     return ret;
 }
 
-static int surffs_send(struct socket *skt, sfs_string *request, int *send_ok, sfs_string *log)
+static int surffs_send(struct socket *skt, sfs_string *request, int *send_ok,
+                       struct sfs_event_log *log, struct surffs_stats *stats,
+                       struct surffs_timeouts *touts, struct surffs_http_ctl *ctl)
 {
+    ktime_t start;
     struct msghdr msg;
     struct iovec iov;
     int size;
     int ret = 0;
     mm_segment_t oldfs;
-    char tmpbuf[256];
     *send_ok = 0;
 
-    sfs_enter();
-    sfs_debug("surffs_send: '%s'\n", request->data);
-
     iov.iov_base=request->data;
     iov.iov_len=request->textlen;
 
@@ -156,26 +244,28 @@ static int surffs_send(struct socket *skt, sfs_string *request, int *send_ok, sf
     msg.msg_name=0;
     msg.msg_namelen=0;
 
+    skt->sk->sk_sndtimeo = timeout_jiffies(surffs_timeout_ms(touts, SFS_TOUT_TTFB));
+
+    start = ktime_get();
     oldfs=get_fs(); //Store current virtual address bounds
     set_fs(KERNEL_DS); //Switch to kernel address bounds
     size=sock_sendmsg(skt,&msg,request->textlen);
     set_fs(oldfs); //return to prev address bounds
+    sfs_stat_latency(stats, SFS_PHASE_SEND, start);
 
     if (size != request->textlen)
     {
-        sfs_debug("surffs_send error\n");
-        snprintf(tmpbuf, sizeof(tmpbuf),
-                 "error sending data to socket: sent only %d of %d bytes\n",
-                 size, (int)request->textlen);
-        ret = sfs_string_cat(log, tmpbuf);
+        ret = fetch_interrupted(ctl);
+        if (ret) goto out;
+
+        sfs_stat_inc(stats, SFS_STAT_ERR_SEND);
+        ret = sfs_event_log_add(log, EV_SEND_ERROR, 0, request->textlen, size);
         goto out;
     }
 
-    sfs_debug("surffs_send OK\n");
     *send_ok = 1;
 
 out:
-    sfs_leave();
     return ret;
 }
 
@@ -186,9 +276,6 @@ static int surffs_rcv_chunk(struct socket *skt, void *chunkbuf, int chunklen)
     mm_segment_t oldfs;
     int ret = 0;
 
-    sfs_enter();
-    sfs_debug("surffs_rcv_chunk\n");
-
     if(skt->sk==NULL) goto out;
 
     iov.iov_base = chunkbuf;
@@ -204,55 +291,91 @@ static int surffs_rcv_chunk(struct socket *skt, void *chunkbuf, int chunklen)
 
     oldfs=get_fs();  //Store current virtual address bounds
     set_fs(KERNEL_DS);  //Switch to kernel address bounds
-    sfs_debug("sock_recvmsg...\n");
+
     ret=sock_recvmsg(skt,&msg,chunklen,msg.msg_flags);
-    sfs_debug("sock_recvmsg OK\n");
-    set_fs(oldfs);//return to prev address bounds
 
-    if (ret > 0)
-    {
-        sfs_debug("received chunk, %d bytes\n", ret);
-    }
-    else
-    {
-        sfs_debug("receive chunk ret = %d\n", ret);
-    }
+    set_fs(oldfs);//return to prev address bounds
 
 out:
-    sfs_leave();
     return ret;
 }
 
-static int surffs_rcv(struct socket *skt, sfs_string *text, int *rcv_ok, sfs_string *log)
+/*
+ * chunks are received right into the tail of text.
+ * Time to first byte is counted from the end of sending request,
+ * transfer deadline from the first byte
+ */
+static int surffs_rcv(struct socket *skt, sfs_string *text, int *rcv_ok,
+                      struct sfs_event_log *log, struct surffs_stats *stats,
+                      struct surffs_timeouts *touts, struct surffs_http_ctl *ctl)
 {
     int ret = 0;
     int readret;
-    char *chunkbuf = 0;
     int size = 0;
-    char tmpbuf[256];
-
-    sfs_enter();
-    sfs_debug("surffs_rcv\n");
+    unsigned int ttfb_ms = surffs_timeout_ms(touts, SFS_TOUT_TTFB);
+    unsigned int transfer_ms = surffs_timeout_ms(touts, SFS_TOUT_TRANSFER);
+    unsigned int tout_ms = ttfb_ms;
+    enum SURFFS_TIMEOUT_PHASE phase = SFS_TOUT_TTFB;
+    s64 elapsed_ms;
+    ktime_t start = ktime_get();
 
     *rcv_ok = 0;
 
-    chunkbuf = kmalloc(SURFFS_HTTP_CHUNK_SIZE + 1, GFP_KERNEL);
-    if (!chunkbuf) {ret = -ENOMEM; goto out;}
-
     ret = sfs_string_clear(text);
     if (ret) goto out;
 
     while (1)
     {
-        readret = surffs_rcv_chunk(skt, chunkbuf, SURFFS_HTTP_CHUNK_SIZE);
+        if (size && transfer_ms)
+        {
+            elapsed_ms = ktime_to_ms(ktime_sub(ktime_get(), start));
+            if (elapsed_ms >= transfer_ms)
+            {
+                ret = log_timeout(log, stats, touts, inet_sk(skt->sk)->inet_daddr,
+                                  SFS_TOUT_TRANSFER, transfer_ms);
+                goto out;
+            }
+            /*pause between chunks is limited by ttfb timeout too*/
+            tout_ms = transfer_ms - elapsed_ms;
+            phase = SFS_TOUT_TRANSFER;
+            if (ttfb_ms && ttfb_ms < tout_ms)
+            {
+                tout_ms = ttfb_ms;
+                phase = SFS_TOUT_TTFB;
+            }
+        }
+        skt->sk->sk_rcvtimeo = timeout_jiffies(tout_ms);
+
+        ret = sfs_string_reserve(text, SURFFS_HTTP_CHUNK_SIZE);
+        if (ret) goto out;
+
+        readret = surffs_rcv_chunk(skt, text->data + text->textlen, SURFFS_HTTP_CHUNK_SIZE);
         if ((readret > 0) && (readret <= SURFFS_HTTP_CHUNK_SIZE))
         {
-            chunkbuf[readret] = 0;
-            sfs_string_cat(text, chunkbuf);
+            if (!size)
+            {
+                sfs_stat_latency(stats, SFS_PHASE_TTFB, start);
+                surffs_http_ctl_first_byte(ctl);
+                surffs_timeout_sample(touts, SFS_TOUT_TTFB, ktime_us_delta(ktime_get(), start));
+                start = ktime_get();
+            }
+            text->textlen += readret;
+            text->data[text->textlen] = 0;
             size += readret;
         }
         else if (readret < 0)
         {
+            ret = fetch_interrupted(ctl);
+            if (ret) goto out;
+
+            if (readret == -EAGAIN)
+            {
+                ret = log_timeout(log, stats, touts, inet_sk(skt->sk)->inet_daddr, phase,
+                                  phase == SFS_TOUT_TTFB ? ttfb_ms : transfer_ms);
+                goto out;
+            }
+
+            sfs_stat_inc(stats, SFS_STAT_ERR_RECV);
             ret = readret;
             goto out;
         }
@@ -264,17 +387,18 @@ static int surffs_rcv(struct socket *skt, sfs_string *text, int *rcv_ok, sfs_str
         else break;
     }
 
-    sfs_debug("received %d bytes\n", size);
+    /*shutdown by surffs_http_cancel() looks like end of response*/
+    if (ctl && ACCESS_ONCE(ctl->cancelled)) {ret = -ECANCELED; goto out;}
+
+    if (size) sfs_stat_latency(stats, SFS_PHASE_TRANSFER, start);
+    sfs_stat_add(stats, SFS_STAT_BYTES_RECEIVED, size);
 
-    snprintf(tmpbuf, sizeof(tmpbuf), "received %d bytes\n", size);
-    ret = sfs_string_cat(log, tmpbuf);
+    ret = sfs_event_log_add(log, EV_RECEIVED, 0, 0, size);
     if (ret) goto out;
 
     *rcv_ok = 1;
 
 out:
-    if (chunkbuf) kfree(chunkbuf);
-    sfs_leave();
     return ret;
 }
 
@@ -283,30 +407,76 @@ static void surffs_free_socket(struct socket *skt)
     sock_release(skt);
 }
 
-static int surffs_extract_http_payload(sfs_string *text, char** payload, sfs_string *log)
+int surffs_http_status(sfs_string *text)
+{
+    const char *p;
+    int status = 0;
+
+    if (!text->textlen || strncmp(text->data, "HTTP/", 5)) return 0;
+
+    p = strchr(text->data, ' ');
+    if (!p || sscanf(p + 1, "%3d", &status) != 1) return 0;
+
+    return status;
+}
+
+int surffs_http_header(sfs_string *text, const char *name, sfs_string *value)
+{
+    const char *headers_end;
+    const char *p;
+    const char *end;
+    size_t len = strlen(name);
+
+    if (sfs_string_clear(value)) return -ENOMEM;
+    if (!text->textlen) return 0;
+
+    headers_end = strstr(text->data, "\r\n\r\n");
+    if (!headers_end) headers_end = text->data + text->textlen;
+
+    for (p = strstr(text->data, "\r\n"); p && p < headers_end; p = strstr(p + 2, "\r\n"))
+    {
+        if (strncasecmp(p + 2, name, len) || p[2 + len] != ':') continue;
+
+        p += 2 + len + 1;
+        while (*p == ' ' || *p == '\t') p++;
+        end = strstr(p, "\r\n");
+        if (!end) end = p + strlen(p);
+        while (end > p && isspace(end[-1])) end--;
+
+        return sfs_string_ncat(value, p, end - p);
+    }
+
+    return 0;
+}
+
+int surffs_extract_http_payload(sfs_string *text, char** payload,
+                                struct sfs_event_log *log)
 {
     int ret = 0;
     char* found;
-
-    sfs_enter();
-    sfs_debug("surffs_extract_payload\n");
+    int status;
 
     *payload = 0;
 
     if (!text->textlen)
     {
-        sfs_debug("no text\n");
-        ret = sfs_string_cat(log, "error extract http payload: empty server response\n");
+        ret = sfs_event_log_add(log, EV_EMPTY_RESPONSE, 0, 0, 0);
         goto out;
     }
 
     found = strstr(text->data, "200 OK");
+    /*answer to Range request*/
+    if (!found && surffs_http_status(text) == 206) found = text->data;
     if (!found)
     {
-        sfs_debug("\"200 OK\" not found\n");
-        ret = sfs_string_cat_param(log,
-          "error extract http payload: bad http status code (\"200 OK\" not found). "
-          "Server response:\n%s\n---------\n", text->data);
+        /*redirects are followed by obtain_webpage()*/
+        status = surffs_http_status(text);
+        if (status == 304)
+            ret = sfs_event_log_add(log, EV_NOT_MODIFIED, 0, 0, 0);
+        else if (status >= 300 && status < 400)
+            ret = sfs_event_log_add(log, EV_REDIRECT, 0, 0, status);
+        else
+            ret = sfs_event_log_add(log, EV_BAD_STATUS, 0, 0, 0);
         goto out;
     }
 
@@ -314,79 +484,77 @@ static int surffs_extract_http_payload(sfs_string *text, char** payload, sfs_str
     found = strstr(text->data, SURFFS_HTTP_HEADERS_SEPARATOR);
     if (!found)
     {
-        sfs_debug("SURFFS_HTTP_HEADERS_SEPARATOR ('%s') not found\n"
-                  ,SURFFS_HTTP_HEADERS_SEPARATOR);
-
-        ret = sfs_string_cat_param(log,
-            "error extract http payload: http headers separator not found ('%s')\n",
-            SURFFS_HTTP_HEADERS_SEPARATOR);
+        ret = sfs_event_log_add(log, EV_NO_HEADERS_END, 0, 0, 0);
 
         goto out;
     }
 
     if ((found - text->data) + strlen(SURFFS_HTTP_HEADERS_SEPARATOR) >= text->textlen)
     {
-        sfs_debug("no http data\n");
-        ret = sfs_string_cat(log, "error extract http payload: no http body\n");
+        ret = sfs_event_log_add(log, EV_NO_BODY, 0, 0, 0);
         goto out;
     }
 
     *payload = found + strlen(SURFFS_HTTP_HEADERS_SEPARATOR);
 
-    ret = sfs_string_cat(log, "http data extracted\n");
+    ret = sfs_event_log_add(log, EV_PAYLOAD_EXTRACTED, 0, 0, 0);
     if (ret) goto out;
 
 out:
-    sfs_leave();
     return ret;
 }
 
-int surffs_get_http(char *ip, char *host, char *path,
+int surffs_get_http(struct surffs_sb_info *fsi,
+                    char *ip, u16 port, char *host, char *path,
+                    struct surffs_validators *cond,
                     sfs_string *http_response,
                     char** http_payload_start,
-                    sfs_string *log)
+                    struct sfs_event_log *log,
+                    int *origin_failed,
+                    struct surffs_http_ctl *ctl)
 {
     struct socket *skt = 0;
     sfs_string request = {0};
     int ret = 0;
     int ok = 0;
-
-    sfs_enter();
-    sfs_debug("surffs_get_http, ip='%s', host='%s', path='%s'\n", ip, host, path);
+    struct surffs_stats *stats = fsi ? &fsi->stats : 0;
+    struct surffs_timeouts *touts = fsi ? &fsi->timeouts : 0;
 
     *http_payload_start = 0;
+    *origin_failed = 1;
 
     ret = sfs_string_clear(http_response);
     if (ret) goto out;
 
-    ret = surffs_alloc_and_connect_socket(&skt, ip, &ok, log);
+    ret = surffs_alloc_and_connect_socket(&skt, ip, port, &ok, log, stats, touts, ctl);
     if (ret || !ok) goto out;
 
     ret = sfs_string_createz(&request, 512);
     if (ret) goto out;
 
-    ret = surffs_make_request(path, host, &request, log);
+    ret = surffs_make_request(path, host, cond, &request);
     if (ret) goto out;
 
-    ret = surffs_send(skt, &request, &ok, log);
+    ret = sfs_event_log_add(log, EV_REQUEST, 0, 0, 0);
+    if (ret) goto out;
+
+    ret = surffs_send(skt, &request, &ok, log, stats, touts, ctl);
     if (ret) goto out;
     if (ret || !ok) goto out;
 
-    ret = surffs_rcv(skt, http_response, &ok, log);
+    ret = surffs_rcv(skt, http_response, &ok, log, stats, touts, ctl);
     if (ret || !ok) goto out;
 
+    *origin_failed = 0;
+
     ret = surffs_extract_http_payload(http_response, http_payload_start, log);
     if (ret) goto out;
 
-    if (*http_payload_start)
-        {sfs_debug("http_payload_start extacted\n");}
-    else
-        {sfs_debug("http responce doesn't contain http_payload_start\n");}
-
 out:
+    http_ctl_detach(ctl);
     if (skt) surffs_free_socket(skt);
     sfs_string_free(&request);
-    sfs_leave();
+
     return ret;
 }
 
@@ -3,11 +3,75 @@
 
 #include <linux/kernel.h>
 #include "surffs_helpers.h"
+#include "surffs_eventlog.h"
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/ktime.h>
 
-int surffs_get_http(char *ip, char *host, char *path,
+struct surffs_sb_info;
+
+/*
+ * validators of cached copy of page for conditional GET, empty if unknown.
+ * With range only bytes range_first..range_last (inclusive) of body are
+ * asked for, validators go to If-Range then. With head request is HEAD
+ */
+struct surffs_validators
+{
+    sfs_string etag;
+    sfs_string last_modified;
+    int head;
+    int range;
+    u64 range_first;
+    u64 range_last;
+};
+
+/*
+ * Lets another thread follow and cancel running surffs_get_http():
+ * first_byte is set and wq is woken when response starts,
+ * surffs_http_cancel() shuts the connection down
+ */
+struct surffs_http_ctl
+{
+    struct mutex lock;
+    struct socket *skt;
+    int cancelled;
+
+    int origin;             /*index of origin in use, -1 - none yet*/
+    int first_byte;
+    ktime_t first_byte_at;
+    wait_queue_head_t *wq;
+};
+
+void surffs_http_ctl_init(struct surffs_http_ctl *ctl, wait_queue_head_t *wq);
+void surffs_http_cancel(struct surffs_http_ctl *ctl);
+/*response has started: wakes ctl->wq, ctl may be NULL*/
+void surffs_http_ctl_first_byte(struct surffs_http_ctl *ctl);
+
+/*
+ * origin_failed is set if server did not give complete response, ctl may be
+ * NULL. With cond request is conditional, so server may answer "304"
+ */
+int surffs_get_http(struct surffs_sb_info *fsi,
+                    char *ip, u16 port, char *host, char *path,
+                    struct surffs_validators *cond,
                     sfs_string *http_response,
                     char** http_payload_start,
-                    sfs_string *log);
+                    struct sfs_event_log *log,
+                    int *origin_failed,
+                    struct surffs_http_ctl *ctl);
+
+int surffs_make_request(char *path, char *host, struct surffs_validators *cond,
+                        sfs_string *request);
+
+/*status code from "HTTP/1.x <code> ..." line of response, 0 if there is none*/
+int surffs_http_status(sfs_string *text);
+
+/*copies value of header "name" of response to value, empty if there is none*/
+int surffs_http_header(sfs_string *text, const char *name, sfs_string *value);
+
+/*checks status of response ("200" or "206") and finds its body, 0 if there is no body*/
+int surffs_extract_http_payload(sfs_string *text, char** payload,
+                                struct sfs_event_log *log);
 
 
 #endif
@@ -0,0 +1,265 @@
+#include "surffs_stats.h"
+#include "surffs_debug.h"
+#include <linux/fs.h>
+#include <linux/kdev_t.h>
+#include <linux/sysfs.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+
+/*/sys/fs/surffs*/
+static struct kset *surffs_kset;
+
+struct surffs_stat_attr
+{
+    struct attribute attr;
+    int counter;
+    int phase;
+};
+
+#define SFS_COUNTER_ATTR(_name, _counter) \
+    static struct surffs_stat_attr sfs_attr_##_name = { \
+        .attr = {.name = #_name, .mode = S_IRUGO}, \
+        .counter = _counter, \
+        .phase = -1 \
+    }
+
+#define SFS_HIST_ATTR(_name, _phase) \
+    static struct surffs_stat_attr sfs_attr_##_name = { \
+        .attr = {.name = #_name, .mode = S_IRUGO}, \
+        .counter = -1, \
+        .phase = _phase \
+    }
+
+SFS_COUNTER_ATTR(pages_fetched,     SFS_STAT_PAGES_FETCHED);
+SFS_COUNTER_ATTR(cache_hits,        SFS_STAT_CACHE_HITS);
+SFS_COUNTER_ATTR(cache_misses,      SFS_STAT_CACHE_MISSES);
+SFS_COUNTER_ATTR(bytes_received,    SFS_STAT_BYTES_RECEIVED);
+SFS_COUNTER_ATTR(parse_time_us,     SFS_STAT_PARSE_TIME_US);
+SFS_COUNTER_ATTR(links_extracted,   SFS_STAT_LINKS_EXTRACTED);
+SFS_COUNTER_ATTR(errors_connect,    SFS_STAT_ERR_CONNECT);
+SFS_COUNTER_ATTR(errors_send,       SFS_STAT_ERR_SEND);
+SFS_COUNTER_ATTR(errors_recv,       SFS_STAT_ERR_RECV);
+SFS_COUNTER_ATTR(errors_http,       SFS_STAT_ERR_HTTP);
+SFS_COUNTER_ATTR(errors_nomem,      SFS_STAT_ERR_NOMEM);
+SFS_COUNTER_ATTR(errors_timeout,    SFS_STAT_ERR_TIMEOUT);
+SFS_COUNTER_ATTR(errors_disk,       SFS_STAT_ERR_DISK);
+SFS_COUNTER_ATTR(failovers,         SFS_STAT_FAILOVERS);
+SFS_COUNTER_ATTR(hedges,            SFS_STAT_HEDGES);
+SFS_COUNTER_ATTR(hedge_wins,        SFS_STAT_HEDGE_WINS);
+SFS_COUNTER_ATTR(breaker_rejects,   SFS_STAT_BREAKER_REJECTS);
+SFS_COUNTER_ATTR(redirects,         SFS_STAT_REDIRECTS);
+SFS_COUNTER_ATTR(redirect_hits,     SFS_STAT_REDIRECT_HITS);
+SFS_COUNTER_ATTR(disk_hits,         SFS_STAT_DISK_HITS);
+SFS_COUNTER_ATTR(disk_stale,        SFS_STAT_DISK_STALE);
+SFS_COUNTER_ATTR(disk_writes,       SFS_STAT_DISK_WRITES);
+SFS_COUNTER_ATTR(sitemap_urls,      SFS_STAT_SITEMAP_URLS);
+SFS_COUNTER_ATTR(sitemap_fresh,     SFS_STAT_SITEMAP_FRESH);
+SFS_COUNTER_ATTR(ratelimit_waits,   SFS_STAT_RATELIMIT_WAITS);
+SFS_COUNTER_ATTR(ratelimit_queued,  SFS_STAT_RATELIMIT_QUEUED);
+SFS_COUNTER_ATTR(offloaded,         SFS_STAT_OFFLOADED);
+SFS_COUNTER_ATTR(offload_fallbacks, SFS_STAT_OFFLOAD_FALLBACKS);
+SFS_COUNTER_ATTR(refreshes,         SFS_STAT_REFRESHES);
+SFS_COUNTER_ATTR(refresh_changes,   SFS_STAT_REFRESH_CHANGES);
+SFS_COUNTER_ATTR(range_requests,    SFS_STAT_RANGE_REQUESTS);
+SFS_COUNTER_ATTR(head_probes,       SFS_STAT_HEAD_PROBES);
+
+SFS_HIST_ATTR(latency_connect,      SFS_PHASE_CONNECT);
+SFS_HIST_ATTR(latency_send,         SFS_PHASE_SEND);
+SFS_HIST_ATTR(latency_ttfb,         SFS_PHASE_TTFB);
+SFS_HIST_ATTR(latency_transfer,     SFS_PHASE_TRANSFER);
+SFS_HIST_ATTR(latency_parse,        SFS_PHASE_PARSE);
+
+static struct attribute *surffs_stats_attrs[] = {
+    &sfs_attr_pages_fetched.attr,
+    &sfs_attr_cache_hits.attr,
+    &sfs_attr_cache_misses.attr,
+    &sfs_attr_bytes_received.attr,
+    &sfs_attr_parse_time_us.attr,
+    &sfs_attr_links_extracted.attr,
+    &sfs_attr_errors_connect.attr,
+    &sfs_attr_errors_send.attr,
+    &sfs_attr_errors_recv.attr,
+    &sfs_attr_errors_http.attr,
+    &sfs_attr_errors_nomem.attr,
+    &sfs_attr_errors_timeout.attr,
+    &sfs_attr_errors_disk.attr,
+    &sfs_attr_failovers.attr,
+    &sfs_attr_hedges.attr,
+    &sfs_attr_hedge_wins.attr,
+    &sfs_attr_breaker_rejects.attr,
+    &sfs_attr_redirects.attr,
+    &sfs_attr_redirect_hits.attr,
+    &sfs_attr_disk_hits.attr,
+    &sfs_attr_disk_stale.attr,
+    &sfs_attr_disk_writes.attr,
+    &sfs_attr_sitemap_urls.attr,
+    &sfs_attr_sitemap_fresh.attr,
+    &sfs_attr_ratelimit_waits.attr,
+    &sfs_attr_ratelimit_queued.attr,
+    &sfs_attr_offloaded.attr,
+    &sfs_attr_offload_fallbacks.attr,
+    &sfs_attr_refreshes.attr,
+    &sfs_attr_refresh_changes.attr,
+    &sfs_attr_range_requests.attr,
+    &sfs_attr_head_probes.attr,
+    &sfs_attr_latency_connect.attr,
+    &sfs_attr_latency_send.attr,
+    &sfs_attr_latency_ttfb.attr,
+    &sfs_attr_latency_transfer.attr,
+    &sfs_attr_latency_parse.attr,
+    NULL
+};
+
+u64 surffs_stats_sum(struct surffs_stats *stats, enum SURFFS_STAT_COUNTER counter)
+{
+    u64 sum = 0;
+    int cpu;
+
+    if (!stats->cpu) return 0;
+
+    for_each_possible_cpu(cpu)
+        sum += per_cpu_ptr(stats->cpu, cpu)->counters[counter];
+
+    return sum;
+}
+
+static void sum_histogram(struct surffs_stats *stats, int phase, u64 *hist)
+{
+    int cpu;
+    int i;
+
+    for_each_possible_cpu(cpu)
+        for (i = 0; i < SFS_HIST_BUCKETS; i++)
+            hist[i] += per_cpu_ptr(stats->cpu, cpu)->hist[phase][i];
+}
+
+/*upper bound of bucket holding percentile pct of phase, last bucket counts as its lower bound*/
+u64 surffs_stats_percentile_us(struct surffs_stats *stats, enum SURFFS_STAT_PHASE phase,
+                               unsigned int pct, u64 *samples)
+{
+    u64 hist[SFS_HIST_BUCKETS] = {0};
+    u64 total = 0;
+    u64 rank;
+    int i;
+
+    *samples = 0;
+    if (!stats || !stats->cpu) return 0;
+
+    sum_histogram(stats, phase, hist);
+    for (i = 0; i < SFS_HIST_BUCKETS; i++) total += hist[i];
+
+    *samples = total;
+    if (!total) return 0;
+
+    rank = div_u64(total * pct + 99, 100);
+    for (i = 0; i < SFS_HIST_BUCKETS - 1; i++)
+    {
+        if (hist[i] >= rank) break;
+        rank -= hist[i];
+    }
+
+    return i == SFS_HIST_BUCKETS - 1 ? 1ULL << (i - 1) : 1ULL << i;
+}
+
+/*one line per non-empty bucket: "<from>-<to>us <count>"*/
+static ssize_t show_histogram(struct surffs_stats *stats, int phase, char *buf)
+{
+    u64 hist[SFS_HIST_BUCKETS] = {0};
+    ssize_t len = 0;
+    int i;
+
+    sum_histogram(stats, phase, hist);
+
+    for (i = 0; i < SFS_HIST_BUCKETS; i++)
+    {
+        if (!hist[i]) continue;
+
+        if (i == 0)
+            len += scnprintf(buf + len, PAGE_SIZE - len, "0-1us %llu\n", hist[i]);
+        else if (i == SFS_HIST_BUCKETS - 1)
+            len += scnprintf(buf + len, PAGE_SIZE - len, "%llu-infus %llu\n",
+                             1ULL << (i - 1), hist[i]);
+        else
+            len += scnprintf(buf + len, PAGE_SIZE - len, "%llu-%lluus %llu\n",
+                             1ULL << (i - 1), 1ULL << i, hist[i]);
+    }
+
+    return len;
+}
+
+static ssize_t surffs_stats_attr_show(struct kobject *kobj,
+                                      struct attribute *attr, char *buf)
+{
+    struct surffs_stats *stats = container_of(kobj, struct surffs_stats, kobj);
+    struct surffs_stat_attr *a = container_of(attr, struct surffs_stat_attr, attr);
+
+    if (a->phase >= 0)
+        return show_histogram(stats, a->phase, buf);
+
+    return scnprintf(buf, PAGE_SIZE, "%llu\n", surffs_stats_sum(stats, a->counter));
+}
+
+static void surffs_stats_release(struct kobject *kobj)
+{
+    struct surffs_stats *stats = container_of(kobj, struct surffs_stats, kobj);
+    complete(&stats->kobj_unregister);
+}
+
+static const struct sysfs_ops surffs_stats_sysfs_ops = {
+    .show = surffs_stats_attr_show,
+};
+
+static struct kobj_type surffs_stats_ktype = {
+    .default_attrs  = surffs_stats_attrs,
+    .sysfs_ops      = &surffs_stats_sysfs_ops,
+    .release        = surffs_stats_release,
+};
+
+int surffs_stats_register(void)
+{
+    surffs_kset = kset_create_and_add("surffs", NULL, fs_kobj);
+    if (!surffs_kset)
+    {
+        sfs_error("cannot create /sys/fs/surffs\n");
+        return -ENOMEM;
+    }
+
+    return 0;
+}
+
+void surffs_stats_unregister(void)
+{
+    if (surffs_kset) kset_unregister(surffs_kset);
+    surffs_kset = 0;
+}
+
+int surffs_stats_init(struct surffs_stats *stats, dev_t dev)
+{
+    int ret = 0;
+
+    stats->cpu = alloc_percpu(struct surffs_stats_cpu);
+    if (!stats->cpu) {ret = -ENOMEM; goto out;}
+
+    init_completion(&stats->kobj_unregister);
+    stats->kobj.kset = surffs_kset;
+    ret = kobject_init_and_add(&stats->kobj, &surffs_stats_ktype, NULL,
+                               "%u:%u", MAJOR(dev), MINOR(dev));
+    stats->kobj_added = 1;
+    if (ret) goto out;
+
+out:
+    return ret;
+}
+
+void surffs_stats_free(struct surffs_stats *stats)
+{
+    if (stats->kobj_added)
+    {
+        kobject_put(&stats->kobj);
+        wait_for_completion(&stats->kobj_unregister);
+        stats->kobj_added = 0;
+    }
+
+    if (stats->cpu) free_percpu(stats->cpu);
+    stats->cpu = 0;
+}
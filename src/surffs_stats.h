@@ -0,0 +1,125 @@
+#ifndef _SURFFS_STATS_H_
+#define _SURFFS_STATS_H_
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/percpu.h>
+#include <linux/kobject.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
+
+/*
+ * Per-mount counters, exported as /sys/fs/surffs/<major:minor>/<counter>.
+ * Counters are per-cpu, so they can be updated from any path without locks.
+ */
+enum SURFFS_STAT_COUNTER
+{
+    SFS_STAT_PAGES_FETCHED = 0,
+    SFS_STAT_CACHE_HITS,
+    SFS_STAT_CACHE_MISSES,
+    SFS_STAT_BYTES_RECEIVED,
+    SFS_STAT_PARSE_TIME_US,
+    SFS_STAT_LINKS_EXTRACTED,
+    SFS_STAT_ERR_CONNECT,
+    SFS_STAT_ERR_SEND,
+    SFS_STAT_ERR_RECV,
+    SFS_STAT_ERR_HTTP,
+    SFS_STAT_ERR_NOMEM,
+    SFS_STAT_ERR_TIMEOUT,
+    SFS_STAT_ERR_DISK,
+    SFS_STAT_FAILOVERS,
+    SFS_STAT_HEDGES,
+    SFS_STAT_HEDGE_WINS,
+    SFS_STAT_BREAKER_REJECTS,
+    SFS_STAT_REDIRECTS,
+    SFS_STAT_REDIRECT_HITS,
+    SFS_STAT_DISK_HITS,
+    SFS_STAT_DISK_STALE,
+    SFS_STAT_DISK_WRITES,
+    SFS_STAT_SITEMAP_URLS,
+    SFS_STAT_SITEMAP_FRESH,
+    SFS_STAT_RATELIMIT_WAITS,
+    SFS_STAT_RATELIMIT_QUEUED,      /*gauge*/
+    SFS_STAT_OFFLOADED,
+    SFS_STAT_OFFLOAD_FALLBACKS,
+    SFS_STAT_REFRESHES,
+    SFS_STAT_REFRESH_CHANGES,
+    SFS_STAT_RANGE_REQUESTS,
+    SFS_STAT_HEAD_PROBES,
+    SFS_STAT_COUNTERS_NUM
+};
+
+/*phases of loading web page, each one has its own latency histogram*/
+enum SURFFS_STAT_PHASE
+{
+    SFS_PHASE_CONNECT = 0,
+    SFS_PHASE_SEND,
+    SFS_PHASE_TTFB,
+    SFS_PHASE_TRANSFER,
+    SFS_PHASE_PARSE,
+    SFS_PHASES_NUM
+};
+
+/*bucket 0 is < 1us, bucket n (n > 0) is [2^(n-1), 2^n) us, last one is unbounded*/
+#define SFS_HIST_BUCKETS 32
+
+struct surffs_stats_cpu
+{
+    u64 counters[SFS_STAT_COUNTERS_NUM];
+    u64 hist[SFS_PHASES_NUM][SFS_HIST_BUCKETS];
+};
+
+struct surffs_stats
+{
+    struct surffs_stats_cpu __percpu *cpu;
+
+    struct kobject kobj;
+    struct completion kobj_unregister;
+    int kobj_added;
+};
+
+int  surffs_stats_register(void);
+void surffs_stats_unregister(void);
+
+int  surffs_stats_init(struct surffs_stats *stats, dev_t dev);
+void surffs_stats_free(struct surffs_stats *stats);
+
+u64  surffs_stats_sum(struct surffs_stats *stats, enum SURFFS_STAT_COUNTER counter);
+u64  surffs_stats_percentile_us(struct surffs_stats *stats, enum SURFFS_STAT_PHASE phase,
+                                unsigned int pct, u64 *samples);
+
+static inline void sfs_stat_add(struct surffs_stats *stats,
+                                enum SURFFS_STAT_COUNTER counter, u64 value)
+{
+    if (stats && stats->cpu) this_cpu_add(stats->cpu->counters[counter], value);
+}
+
+static inline void sfs_stat_inc(struct surffs_stats *stats,
+                                enum SURFFS_STAT_COUNTER counter)
+{
+    sfs_stat_add(stats, counter, 1);
+}
+
+/*for gauges: per-cpu parts wrap around, their sum does not*/
+static inline void sfs_stat_dec(struct surffs_stats *stats,
+                                enum SURFFS_STAT_COUNTER counter)
+{
+    sfs_stat_add(stats, counter, (u64)-1);
+}
+
+/*adds time passed since start (in microseconds) to histogram of phase*/
+static inline void sfs_stat_latency(struct surffs_stats *stats,
+                                    enum SURFFS_STAT_PHASE phase, ktime_t start)
+{
+    s64 us;
+    int bucket = 0;
+
+    if (!stats || !stats->cpu) return;
+
+    us = ktime_us_delta(ktime_get(), start);
+    if (us > 0) bucket = min(ilog2((u64)us) + 1, SFS_HIST_BUCKETS - 1);
+
+    this_cpu_inc(stats->cpu->hist[phase][bucket]);
+}
+
+#endif
@@ -0,0 +1,92 @@
+#include "surffs_timeout.h"
+#include "surffs.h"
+
+static const unsigned int default_ms[SFS_TOUT_PHASES_NUM] = {
+    [SFS_TOUT_CONNECT]  = SURFFS_CONNECT_TOUT_MS,
+    [SFS_TOUT_TTFB]     = SURFFS_TTFB_TOUT_MS,
+    [SFS_TOUT_TRANSFER] = SURFFS_TRANSFER_TOUT_MS,
+};
+
+static const char *phase_names[SFS_TOUT_PHASES_NUM] = {
+    [SFS_TOUT_CONNECT]  = "connect",
+    [SFS_TOUT_TTFB]     = "first byte",
+    [SFS_TOUT_TRANSFER] = "transfer",
+};
+
+void surffs_timeouts_init(struct surffs_timeouts *touts)
+{
+    int i;
+
+    memset(touts, 0, sizeof(*touts));
+    for (i = 0; i < SFS_TOUT_PHASES_NUM; i++) touts->ms[i] = default_ms[i];
+    spin_lock_init(&touts->lock);
+}
+
+unsigned int surffs_timeout_ms(struct surffs_timeouts *touts,
+                               enum SURFFS_TIMEOUT_PHASE phase)
+{
+    struct surffs_rtt_estimator *rtt;
+    unsigned int ms;
+    u64 rto_ms;
+
+    if (!touts) return default_ms[phase];
+
+    ms = touts->ms[phase];
+    if (!touts->adaptive || phase == SFS_TOUT_TRANSFER) return ms;
+
+    rtt = &touts->rtt[phase];
+    spin_lock(&touts->lock);
+    rto_ms = rtt->samples ? ((u64)rtt->srtt_us + 4 * (u64)rtt->rttvar_us) / 1000 : ms;
+    spin_unlock(&touts->lock);
+
+    rto_ms = max_t(u64, rto_ms, SURFFS_ADAPTIVE_TOUT_MIN_MS);
+    if (ms) rto_ms = min_t(u64, rto_ms, ms);
+
+    return rto_ms;
+}
+
+/*RFC 6298: rttvar = 3/4 rttvar + 1/4 |srtt - r|, srtt = 7/8 srtt + 1/8 r*/
+void surffs_timeout_sample(struct surffs_timeouts *touts,
+                           enum SURFFS_TIMEOUT_PHASE phase, s64 us)
+{
+    struct surffs_rtt_estimator *rtt;
+    u32 r;
+
+    if (!touts || us < 0) return;
+
+    r = min_t(s64, us, U32_MAX / 8);
+    rtt = &touts->rtt[phase];
+
+    spin_lock(&touts->lock);
+    if (!rtt->samples)
+    {
+        rtt->srtt_us = r;
+        rtt->rttvar_us = r / 2;
+    }
+    else
+    {
+        rtt->rttvar_us = (3 * rtt->rttvar_us + abs((s32)(rtt->srtt_us - r))) / 4;
+        rtt->srtt_us = (7 * rtt->srtt_us + r) / 8;
+    }
+    rtt->samples++;
+    spin_unlock(&touts->lock);
+}
+
+void surffs_timeout_backoff(struct surffs_timeouts *touts,
+                            enum SURFFS_TIMEOUT_PHASE phase)
+{
+    struct surffs_rtt_estimator *rtt;
+
+    if (!touts) return;
+
+    rtt = &touts->rtt[phase];
+
+    spin_lock(&touts->lock);
+    if (rtt->samples) rtt->srtt_us = min_t(u32, rtt->srtt_us * 2, U32_MAX / 8);
+    spin_unlock(&touts->lock);
+}
+
+const char *surffs_timeout_phase_name(enum SURFFS_TIMEOUT_PHASE phase)
+{
+    return phase_names[phase];
+}
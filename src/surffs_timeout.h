@@ -0,0 +1,57 @@
+#ifndef _SURFFS_TIMEOUT_H_
+#define _SURFFS_TIMEOUT_H_
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/spinlock.h>
+
+/*
+ * Deadlines of fetching a page:
+ *     connect  - establishing connection
+ *     ttfb     - from sending request to the first byte of response, and
+ *                also the longest pause between chunks of response
+ *     transfer - whole response after the first byte (0 - no limit)
+ * With adaptive_timeouts connect and ttfb deadlines follow observed times
+ * as TCP RTO does: srtt + 4 * rttvar, but not less than
+ * SURFFS_ADAPTIVE_TOUT_MIN_MS and not more than configured value.
+ */
+enum SURFFS_TIMEOUT_PHASE
+{
+    SFS_TOUT_CONNECT = 0,
+    SFS_TOUT_TTFB,
+    SFS_TOUT_TRANSFER,
+    SFS_TOUT_PHASES_NUM
+};
+
+struct surffs_rtt_estimator
+{
+    u32 srtt_us;
+    u32 rttvar_us;
+    u32 samples;
+};
+
+struct surffs_timeouts
+{
+    unsigned int ms[SFS_TOUT_PHASES_NUM];
+    int adaptive;
+
+    spinlock_t lock;
+    struct surffs_rtt_estimator rtt[SFS_TOUT_PHASES_NUM];
+};
+
+void surffs_timeouts_init(struct surffs_timeouts *touts);
+
+/*current deadline of phase in ms, 0 is no limit. touts may be NULL (defaults)*/
+unsigned int surffs_timeout_ms(struct surffs_timeouts *touts,
+                               enum SURFFS_TIMEOUT_PHASE phase);
+
+void surffs_timeout_sample(struct surffs_timeouts *touts,
+                           enum SURFFS_TIMEOUT_PHASE phase, s64 us);
+
+/*timeout expired: doubles estimate like RTO backoff of TCP*/
+void surffs_timeout_backoff(struct surffs_timeouts *touts,
+                            enum SURFFS_TIMEOUT_PHASE phase);
+
+const char *surffs_timeout_phase_name(enum SURFFS_TIMEOUT_PHASE phase);
+
+#endif
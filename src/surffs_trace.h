@@ -0,0 +1,136 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM surffs
+
+#if !defined(_SURFFS_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _SURFFS_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+/*
+ * Tracepoints of surffs, usage example:
+ *   echo 1 > /sys/kernel/debug/tracing/events/surffs/enable
+ *   cat /sys/kernel/debug/tracing/trace_pipe
+ * All string arguments must be non-NULL.
+ */
+
+TRACE_EVENT(surffs_fetch_start,
+    TP_PROTO(const char *ip, const char *host, const char *path),
+    TP_ARGS(ip, host, path),
+    TP_STRUCT__entry(
+        __string(ip, ip)
+        __string(host, host)
+        __string(path, path)
+    ),
+    TP_fast_assign(
+        __assign_str(ip, ip);
+        __assign_str(host, host);
+        __assign_str(path, path);
+    ),
+    TP_printk("ip=%s url=%s%s", __get_str(ip), __get_str(host), __get_str(path))
+);
+
+TRACE_EVENT(surffs_fetch_end,
+    TP_PROTO(const char *host, const char *path, int ret, int status,
+             size_t resp_bytes, u32 links),
+    TP_ARGS(host, path, ret, status, resp_bytes, links),
+    TP_STRUCT__entry(
+        __string(host, host)
+        __string(path, path)
+        __field(int, ret)
+        __field(int, status)
+        __field(size_t, resp_bytes)
+        __field(u32, links)
+    ),
+    TP_fast_assign(
+        __assign_str(host, host);
+        __assign_str(path, path);
+        __entry->ret = ret;
+        __entry->status = status;
+        __entry->resp_bytes = resp_bytes;
+        __entry->links = links;
+    ),
+    TP_printk("url=%s%s ret=%d status=%d bytes=%zu links=%u",
+              __get_str(host), __get_str(path), __entry->ret, __entry->status,
+              __entry->resp_bytes, __entry->links)
+);
+
+DECLARE_EVENT_CLASS(surffs_cache_class,
+    TP_PROTO(const char *ip, const char *host, const char *path),
+    TP_ARGS(ip, host, path),
+    TP_STRUCT__entry(
+        __string(ip, ip)
+        __string(host, host)
+        __string(path, path)
+    ),
+    TP_fast_assign(
+        __assign_str(ip, ip);
+        __assign_str(host, host);
+        __assign_str(path, path);
+    ),
+    TP_printk("ip=%s url=%s%s", __get_str(ip), __get_str(host), __get_str(path))
+);
+
+DEFINE_EVENT(surffs_cache_class, surffs_cache_hit,
+    TP_PROTO(const char *ip, const char *host, const char *path),
+    TP_ARGS(ip, host, path)
+);
+
+DEFINE_EVENT(surffs_cache_class, surffs_cache_miss,
+    TP_PROTO(const char *ip, const char *host, const char *path),
+    TP_ARGS(ip, host, path)
+);
+
+TRACE_EVENT(surffs_lookup,
+    TP_PROTO(unsigned long dir_ino, const char *name),
+    TP_ARGS(dir_ino, name),
+    TP_STRUCT__entry(
+        __field(unsigned long, dir_ino)
+        __string(name, name)
+    ),
+    TP_fast_assign(
+        __entry->dir_ino = dir_ino;
+        __assign_str(name, name);
+    ),
+    TP_printk("dir=%lu name=%s", __entry->dir_ino, __get_str(name))
+);
+
+TRACE_EVENT(surffs_readdir,
+    TP_PROTO(unsigned long ino, loff_t pos),
+    TP_ARGS(ino, pos),
+    TP_STRUCT__entry(
+        __field(unsigned long, ino)
+        __field(loff_t, pos)
+    ),
+    TP_fast_assign(
+        __entry->ino = ino;
+        __entry->pos = pos;
+    ),
+    TP_printk("ino=%lu pos=%lld", __entry->ino, __entry->pos)
+);
+
+/*check is enum SURFFS_LINK_CHECK, 0 means link was added*/
+TRACE_EVENT(surffs_link_parsed,
+    TP_PROTO(const char *title, const char *url, int check),
+    TP_ARGS(title, url, check),
+    TP_STRUCT__entry(
+        __string(title, title)
+        __string(url, url)
+        __field(int, check)
+    ),
+    TP_fast_assign(
+        __assign_str(title, title);
+        __assign_str(url, url);
+        __entry->check = check;
+    ),
+    TP_printk("title='%s' url='%s' check=%d",
+              __get_str(title), __get_str(url), __entry->check)
+);
+
+#endif
+
+/*this part must be outside of header guard*/
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE surffs_trace
+#include <trace/define_trace.h>
@@ -3,10 +3,18 @@
 #include "surffs_webpages.h"
 #include "surffs_debug.h"
 #include "surffs_internet.h"
+#include "surffs_trace.h"
+#include "surffs_sb.h"
 #include <linux/slab.h>
 #include "surffs_helpers.h"
+#include "surffs_mem.h"
+#include "surffs_redirect.h"
+#include "surffs_hosts.h"
+#include "surffs_lazybody.h"
 
 LIST_HEAD(webpages_list);
+/*protects webpages_list, pages are loaded without holding it*/
+DEFINE_MUTEX(webpages_lock);
 
 static int cmp_web_address(  struct SURFFS_WEB_ADDRESS address1,
                              struct SURFFS_WEB_ADDRESS address2)
@@ -14,6 +22,7 @@ static int cmp_web_address(  struct SURFFS_WEB_ADDRESS address1,
     if (strcmp(address1.path.data, address2.path.data)) return 0;
     if (strcmp(address1.host.data, address2.host.data)) return 0;
     if (strcmp(address1.ip.data, address2.ip.data)) return 0;
+    if (address1.port != address2.port) return 0;
     return 1;
 }
 
@@ -23,134 +32,124 @@ static struct SURFFS_WEB_PAGE* find_webpage(struct SURFFS_WEB_ADDRESS address)
     struct SURFFS_WEB_PAGE* ret = 0;
     struct SURFFS_WEB_PAGE* p;
 
-    sfs_enter();
-    sfs_trace("find_webpage\n");
-
     list_for_each(pos, &webpages_list)
     {
         p = list_entry(pos, struct SURFFS_WEB_PAGE, webpages);
         if (cmp_web_address(p->address, address))
         {
-            sfs_trace("found webpage!\n");
             ret = p;
             goto out;
         }
     }
 
-    sfs_trace("no pages found\n");
-
 out:
-    sfs_leave();
     return ret;
 }
 
+/*list holds its own reference to page*/
 static void add_webpage(struct SURFFS_WEB_PAGE* page)
 {
-    sfs_enter();
-    sfs_debug("add_webpage");
+    SURFFS_WEB_PAGE_get(page);
     list_add(&page->webpages, &webpages_list);
-    sfs_leave();
 }
 
-
-
-int get_webpage(struct SURFFS_WEB_ADDRESS address, struct SURFFS_WEB_PAGE **page)
+/*returns referenced page or 0*/
+static struct SURFFS_WEB_PAGE* find_webpage_get(struct SURFFS_WEB_ADDRESS address)
 {
-    struct SURFFS_WEB_PAGE *p = 0;
-    int ret = 0;
-
-    sfs_enter();
-    sfs_debug("get_webpage: %s%s (%s)\n", address.host.data, address.path.data, address.ip.data);
+    struct SURFFS_WEB_PAGE* p;
 
+    mutex_lock(&webpages_lock);
     p = find_webpage(address);
     if (p)
     {
-        *page = p;
-        goto out;
-    }
-    else
-    {
-        ret = SURFFS_WEB_PAGE_alloc(&p); if (ret) goto out;
-        ret = obtain_webpage(address, p); if (ret) goto out;
-        add_webpage(p);
-        *page = p;
-        goto out;
+        SURFFS_WEB_PAGE_get(p);
+        p->last_access = jiffies;
     }
+    mutex_unlock(&webpages_lock);
 
-out:
-    if (ret && p) kfree(p);
-    sfs_leave();
-    return ret;
+    return p;
 }
 
-int SURFFS_HTML_LINK_alloc(struct SURFFS_HTML_LINK **link)
+/*
+ * Page is returned referenced, caller must drop it by SURFFS_WEB_PAGE_put().
+ * If the same page was loaded concurrently, the first added one wins.
+ * Redirected page is cached by its target address only.
+ */
+int get_webpage(struct surffs_sb_info *fsi, struct SURFFS_WEB_ADDRESS address,
+                struct SURFFS_WEB_PAGE **page)
 {
+    struct SURFFS_WEB_PAGE *p = 0;
+    struct SURFFS_WEB_PAGE *existing;
+    sfs_string *target = 0;
+    sfs_string key_buf = {0};
+    sfs_string path_buf = {0};
+    const char *key;
     int ret = 0;
-    struct SURFFS_HTML_LINK *newlink = 0;
 
-    sfs_enter();
-    sfs_trace("SURFFS_HTML_LINK_alloc\n");
+    /*known redirect: page is taken by its target path*/
+    if (fsi)
+    {
+        ret = surffs_webpath(fsi, address.host.data, address.path.data, &key_buf, &key);
+        if (ret) goto out;
+        target = surffs_redirect_find(&fsi->redirects, key);
+    }
+    if (target)
+    {
+        sfs_stat_inc(&fsi->stats, SFS_STAT_REDIRECT_HITS);
+        address.path = *target;
 
-    newlink = kzalloc(sizeof(struct SURFFS_HTML_LINK), GFP_KERNEL);
-    if (!newlink) {ret = -ENOMEM; goto out;}
+        /*target of another host is "//<host><path>"*/
+        if (surffs_webpath_path(target->data) != target->data)
+        {
+            ret = sfs_string_set(&path_buf, surffs_webpath_path(target->data));
+            if (ret) goto out;
+            address.path = path_buf;
+        }
+    }
 
-    ret = sfs_string_createz(&newlink->title, 64); if (ret) goto out;
-    ret = sfs_string_createz(&newlink->protocol, 16); if (ret) goto out;
-    ret = sfs_string_createz(&newlink->host, 64); if (ret) goto out;
-    ret = sfs_string_createz(&newlink->path, 64); if (ret) goto out;
-    ret = sfs_string_createz(&newlink->full_url, 64); if (ret) goto out;
+    p = find_webpage_get(address);
+    if (p)
+    {
+        trace_surffs_cache_hit(address.ip.data, address.host.data, address.path.data);
+        if (fsi) sfs_stat_inc(&fsi->stats, SFS_STAT_CACHE_HITS);
+        *page = p;
+        p = 0;
+        goto out;
+    }
 
-    *link = newlink;
+    trace_surffs_cache_miss(address.ip.data, address.host.data, address.path.data);
+    if (fsi) sfs_stat_inc(&fsi->stats, SFS_STAT_CACHE_MISSES);
+    ret = SURFFS_WEB_PAGE_alloc(&p); if (ret) goto out;
+    ret = obtain_webpage(fsi, address, p); if (ret) goto out;
 
-out:
-    sfs_leave();
-    return ret;
-}
+    /*page may be redirected to already cached one*/
+    mutex_lock(&webpages_lock);
+    existing = find_webpage(p->address);
+    if (existing)
+    {
+        SURFFS_WEB_PAGE_get(existing);
+        existing->last_access = jiffies;
+    }
+    else
+    {
+        add_webpage(p);
+    }
+    mutex_unlock(&webpages_lock);
 
-void SURFFS_HTML_LINK_free(struct SURFFS_HTML_LINK *link)
-{
-    sfs_enter();
-    sfs_trace("SURFFS_HTML_LINK_free: '%s'\n", link->full_url.data);
+    if (existing)
+    {
+        SURFFS_WEB_PAGE_put(p);
+        p = existing;
+    }
 
-    if (!link) goto out;
-    sfs_string_free(&link->title);
-    sfs_string_free(&link->protocol);
-    sfs_string_free(&link->host);
-    sfs_string_free(&link->path);
-    sfs_string_free(&link->full_url);
-    kfree(link);
+    *page = p;
+    p = 0;
 
 out:
-    sfs_leave();
-}
-
-int SURFFS_HTML_LINK_print(struct SURFFS_HTML_LINK *link, sfs_string *str)
-{
-    int ret = 0;
+    if (p) SURFFS_WEB_PAGE_put(p);
+    sfs_string_free(&key_buf);
+    sfs_string_free(&path_buf);
 
-    sfs_enter();
-    sfs_trace("SURFFS_HTML_LINK_print\n");
-
-    ret = sfs_string_cat(str, "SURFFS_HTML_LINK: ");
-    if (ret) goto out;
-
-    ret = sfs_string_cat_param(str, "title = '%s' ", link->title.data);
-    if (ret) goto out;
-
-    ret = sfs_string_cat_param(str, "full_url = '%s' ", link->full_url.data);
-    if (ret) goto out;
-
-    ret = sfs_string_cat_param(str, "protocol = '%s' ", link->protocol.data);
-    if (ret) goto out;
-
-    ret = sfs_string_cat_param(str, "host = '%s' ", link->host.data);
-    if (ret) goto out;
-
-    ret = sfs_string_cat_param(str, "path = '%s' ", link->path.data);
-    if (ret) goto out;
-
-out:
-    sfs_leave();
     return ret;
 }
 
@@ -159,28 +158,22 @@ int SURFFS_WEB_ADDRESS_alloc(struct SURFFS_WEB_ADDRESS **addr)
     int ret = 0;
     struct SURFFS_WEB_ADDRESS *newaddr = 0;
 
-    sfs_enter();
-    sfs_trace("SURFFS_WEB_ADDRESS_alloc\n");
-
     newaddr = kzalloc(sizeof(struct SURFFS_WEB_ADDRESS), GFP_KERNEL);
     if (!newaddr) {ret = -ENOMEM; goto out;}
 
     ret = sfs_string_createz(&newaddr->ip, 16); if (ret) goto out;
+    newaddr->port = SURFFS_HTTP_PORT;
     ret = sfs_string_createz(&newaddr->host, 64); if (ret) goto out;
     ret = sfs_string_createz(&newaddr->path, 64); if (ret) goto out;
 
     *addr = newaddr;
 
 out:
-    sfs_leave();
     return ret;
 }
 
 void SURFFS_WEB_ADDRESS_free(struct SURFFS_WEB_ADDRESS *addr)
 {
-    sfs_enter();
-    sfs_trace("SURFFS_WEB_ADDRESS_free\n");
-
     if (!addr) goto out;
     sfs_string_free(&addr->ip);
     sfs_string_free(&addr->host);
@@ -188,30 +181,16 @@ void SURFFS_WEB_ADDRESS_free(struct SURFFS_WEB_ADDRESS *addr)
     kfree(addr);
 
 out:
-    sfs_leave();
+    return;
 }
 
 int SURFFS_WEB_ADDRESS_print(struct SURFFS_WEB_ADDRESS *addr, sfs_string *str)
 {
     int ret = 0;
 
-    sfs_enter();
-    sfs_trace("SURFFS_WEB_ADDRESS_print\n");
-
-    ret = sfs_string_cat(str, "SURFFS_WEB_ADDRESS: ");
-    if (ret) goto out;
-
-    ret = sfs_string_cat_param(str, "ip = '%s' ", addr->ip.data);
-    if (ret) goto out;
+    ret = sfs_string_catf(str, "SURFFS_WEB_ADDRESS: ip = '%s' port = %u host = '%s' path = '%s' ",
+                          addr->ip.data, addr->port, addr->host.data, addr->path.data);
 
-    ret = sfs_string_cat_param(str, "host = '%s' ", addr->host.data);
-    if (ret) goto out;
-
-    ret = sfs_string_cat_param(str, "path = '%s' ", addr->path.data);
-    if (ret) goto out;
-
-out:
-    sfs_leave();
     return ret;
 }
 
@@ -220,40 +199,50 @@ int SURFFS_WEB_PAGE_alloc(struct SURFFS_WEB_PAGE **page)
     int ret = 0;
     struct SURFFS_WEB_PAGE *p;
 
-    sfs_enter();
-    sfs_trace("SURFFS_WEB_PAGE_alloc\n");
-
-    p = kzalloc(sizeof(struct SURFFS_WEB_PAGE), GFP_KERNEL);
+    p = surffs_cache_zalloc(SFS_CACHE_WEB_PAGE);
     if (!p) {ret = -ENOMEM; goto out;}
 
+    sfs_arena_init(&p->arena);
+    INIT_LIST_HEAD(&p->html_links);
+    sfs_event_log_init(&p->events, &p->arena);
+
+    atomic_set(&p->refcount, 1);
+    p->last_access = jiffies;
+    p->fetched = jiffies;
     p->status = STATUS_NEED_GET;
-    ret = sfs_string_createz(&p->address.ip, 16); if (ret) goto out;
-    ret = sfs_string_createz(&p->address.host, 64); if (ret) goto out;
-    ret = sfs_string_createz(&p->address.path, 64); if (ret) goto out;
+    ret = sfs_string_createz_in(&p->address.ip, &p->arena, 16); if (ret) goto out;
+    ret = sfs_string_createz_in(&p->address.host, &p->arena, 64); if (ret) goto out;
+    ret = sfs_string_createz_in(&p->address.path, &p->arena, 64); if (ret) goto out;
     ret = sfs_string_createz(&p->http_resp, 4096); if (ret) goto out;
-    ret = sfs_string_createz(&p->log, 512); if (ret) goto out;
-    ret = sfs_string_createz(&p->full_url, 64); if (ret) goto out;
-    ret = sfs_string_createz(&p->status_str, 16); if (ret) goto out;
-
-    INIT_LIST_HEAD(&p->html_links);
+    ret = sfs_string_createz_in(&p->full_url, &p->arena, 64); if (ret) goto out;
+    ret = sfs_string_createz_in(&p->status_str, &p->arena, 16); if (ret) goto out;
 
     ret = sfs_string_set(&p->status_str, STATUS_NEED_GET_STR);
 
     *page = p;
 out:
-    sfs_leave();
+    if (ret && p) SURFFS_WEB_PAGE_free(p);
+
     return ret;
 }
 
+void SURFFS_WEB_PAGE_get(struct SURFFS_WEB_PAGE *p)
+{
+    atomic_inc(&p->refcount);
+}
+
+void SURFFS_WEB_PAGE_put(struct SURFFS_WEB_PAGE *p)
+{
+    if (p && atomic_dec_and_test(&p->refcount))
+        SURFFS_WEB_PAGE_free(p);
+}
+
 void SURFFS_WEB_PAGE_free(struct SURFFS_WEB_PAGE *p)
 {  
     struct list_head *pos;
     struct list_head *tmp;
     struct SURFFS_HTML_LINK* link;
 
-    sfs_enter();
-    sfs_trace("SURFFS_WEB_PAGE_free: '%s'\n", p->full_url.data);
-
     list_for_each_safe(pos, tmp, &p->html_links)
     {
         link = list_entry(pos, struct SURFFS_HTML_LINK, html_links);
@@ -261,16 +250,10 @@ void SURFFS_WEB_PAGE_free(struct SURFFS_WEB_PAGE *p)
         SURFFS_HTML_LINK_free(link);
     }
 
-    sfs_string_free(&p->address.ip);
-    sfs_string_free(&p->address.host);
-    sfs_string_free(&p->address.path);
+    surffs_lazy_body_free(p->lazy);
     sfs_string_free(&p->http_resp);
-    sfs_string_free(&p->log);
-    sfs_string_free(&p->full_url);
-    sfs_string_free(&p->status_str);
-    kfree(p);
-
-    sfs_leave();
+    sfs_arena_free(&p->arena);
+    surffs_cache_free(SFS_CACHE_WEB_PAGE, p);
 }
 
 void free_webpages(void)
@@ -279,17 +262,52 @@ void free_webpages(void)
     struct list_head *tmp;
     struct SURFFS_WEB_PAGE* page;
 
-    sfs_enter();
     sfs_info("free_webpages\n");
 
-
-
+    mutex_lock(&webpages_lock);
     list_for_each_safe(pos, tmp, &webpages_list)
     {
         page = list_entry(pos, struct SURFFS_WEB_PAGE, webpages);
         list_del(pos);
-        SURFFS_WEB_PAGE_free(page);
+        SURFFS_WEB_PAGE_put(page);
     }
+    mutex_unlock(&webpages_lock);
+}
 
-    sfs_leave();
+void replace_webpage(struct SURFFS_WEB_PAGE *old, struct SURFFS_WEB_PAGE *fresh)
+{
+    int cached = 0;
+
+    mutex_lock(&webpages_lock);
+    if (find_webpage(old->address) == old)
+    {
+        SURFFS_WEB_PAGE_get(fresh);
+        list_replace_init(&old->webpages, &fresh->webpages);
+        cached = 1;
+    }
+    mutex_unlock(&webpages_lock);
+
+    if (cached) SURFFS_WEB_PAGE_put(old);
+}
+
+/*memory occupied by cached pages of host (with same ip) of root address*/
+void webpages_usage(struct SURFFS_WEB_ADDRESS *root, u64 *bytes, u64 *pages)
+{
+    struct SURFFS_WEB_PAGE* page;
+
+    *bytes = 0;
+    *pages = 0;
+
+    mutex_lock(&webpages_lock);
+    list_for_each_entry(page, &webpages_list, webpages)
+    {
+        if (strcmp(page->address.ip.data, root->ip.data) != 0) continue;
+        if (page->address.port != root->port) continue;
+        if (strcmp(page->address.host.data, root->host.data) != 0) continue;
+
+        *bytes += sizeof(struct SURFFS_WEB_PAGE) + page->arena.allocated
+                  + page->http_resp.memlen;
+        (*pages)++;
+    }
+    mutex_unlock(&webpages_lock);
 }
@@ -4,7 +4,11 @@
 #include <linux/kernel.h>
 #include <linux/list.h>
 #include <linux/types.h>
+#include <linux/mutex.h>
+#include <linux/atomic.h>
 #include "surffs_helpers.h"
+#include "surffs_arena.h"
+#include "surffs_eventlog.h"
 
 enum SURFFS_WEB_STATUS
 {
@@ -27,8 +31,13 @@ struct SURFFS_HTML_LINK
     sfs_string path;
 
     sfs_string full_url;
+
+    /*number of link on its page (also appended to title)*/
+    u32 number;
 };
 int  SURFFS_HTML_LINK_alloc(struct SURFFS_HTML_LINK **link);
+int  SURFFS_HTML_LINK_clone(struct SURFFS_HTML_LINK *src, struct sfs_arena *arena,
+                            struct SURFFS_HTML_LINK **link);
 void SURFFS_HTML_LINK_free(struct SURFFS_HTML_LINK *link);
 int  SURFFS_HTML_LINK_print(struct SURFFS_HTML_LINK *link, sfs_string *str);
 
@@ -36,6 +45,7 @@ int  SURFFS_HTML_LINK_print(struct SURFFS_HTML_LINK *link, sfs_string *str);
 struct SURFFS_WEB_ADDRESS
 {
     sfs_string ip;
+    u16 port;
     sfs_string host;
     sfs_string path;
 };
@@ -43,26 +53,51 @@ int  SURFFS_WEB_ADDRESS_alloc(struct SURFFS_WEB_ADDRESS **addr);
 void SURFFS_WEB_ADDRESS_free(struct SURFFS_WEB_ADDRESS *addr);
 int  SURFFS_WEB_ADDRESS_print(struct SURFFS_WEB_ADDRESS *addr, sfs_string *str);
 
+struct surffs_lazy_body;
+
 struct SURFFS_WEB_PAGE
 {
     struct list_head webpages;
 
+    /*one reference is held by webpages_list, one by every inode of page*/
+    atomic_t refcount;
+    /*jiffies*/
+    unsigned long last_access;
+    unsigned long fetched;      /*jiffies, refresh fetches page again after ttl*/
+
+    /*owns links strings, event log and other small per-page strings*/
+    struct sfs_arena arena;
+
     struct SURFFS_WEB_ADDRESS address;
     enum SURFFS_WEB_STATUS status;
 
     sfs_string http_resp;
     char *http_payload;
+    struct surffs_lazy_body *lazy;  /*body past http_payload is read by ranges*/
     struct list_head html_links;
+    u32 links_count;
 
-    sfs_string log;
+    struct sfs_event_log events;
     sfs_string full_url;
     sfs_string status_str;
 };
 int  SURFFS_WEB_PAGE_alloc(struct SURFFS_WEB_PAGE **p);
 void SURFFS_WEB_PAGE_free(struct SURFFS_WEB_PAGE *p);
+void SURFFS_WEB_PAGE_get(struct SURFFS_WEB_PAGE *p);
+void SURFFS_WEB_PAGE_put(struct SURFFS_WEB_PAGE *p);
+
+/*cache of loaded pages*/
+extern struct list_head webpages_list;
+extern struct mutex webpages_lock;
+
 
+struct surffs_sb_info;
 
-int get_webpage(struct SURFFS_WEB_ADDRESS address, struct SURFFS_WEB_PAGE **page);
+int get_webpage(struct surffs_sb_info *fsi, struct SURFFS_WEB_ADDRESS address,
+                struct SURFFS_WEB_PAGE **page);
 void free_webpages(void);
+/*refreshed page takes place of cached one*/
+void replace_webpage(struct SURFFS_WEB_PAGE *old, struct SURFFS_WEB_PAGE *fresh);
+void webpages_usage(struct SURFFS_WEB_ADDRESS *root, u64 *bytes, u64 *pages);
 
 #endif
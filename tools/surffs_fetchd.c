@@ -0,0 +1,256 @@
+/*
+ * Fetch daemon of surffs mounts with option offload: takes requests from
+ * /dev/surffs-fetch, fetches pages by plain http and puts responses right
+ * into the shared slots of the device. Every request is served by its own
+ * thread, so all slots may be in flight at once. It is a reference daemon:
+ * TLS, proxies or io_uring go into fetch_page() of a real one.
+ *
+ * usage: surffs_fetchd [-d device] [-v]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "surffs_fetchd.h"
+
+struct fetch_job
+{
+    struct surffs_fetchd_request req;
+    char *slot;
+};
+
+static int dev_fd = -1;
+static char *area;
+static int verbose;
+static pthread_mutex_t reply_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int connect_origin(struct surffs_fetchd_request *req)
+{
+    struct addrinfo hints;
+    struct addrinfo *res = 0;
+    struct timeval tv;
+    char port[8];
+    int fd = -1;
+    int ret;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICHOST;
+    snprintf(port, sizeof(port), "%u", req->port);
+
+    ret = getaddrinfo(req->ip, port, &hints, &res);
+    if (ret) return -EHOSTUNREACH;
+
+    fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0)
+    {
+        ret = -errno;
+        goto out;
+    }
+
+    if (req->timeout_ms)
+    {
+        tv.tv_sec = req->timeout_ms / 1000;
+        tv.tv_usec = (req->timeout_ms % 1000) * 1000;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+
+    if (connect(fd, res->ai_addr, res->ai_addrlen) < 0)
+    {
+        ret = -errno;
+        close(fd);
+        goto out;
+    }
+
+    ret = fd;
+
+out:
+    freeaddrinfo(res);
+    return ret;
+}
+
+static int send_all(int fd, const char *buf, size_t len)
+{
+    ssize_t n;
+
+    while (len)
+    {
+        n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -errno;
+        buf += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+/*same request as kernel sends, response is read into slot; length or -errno*/
+static long fetch_page(struct surffs_fetchd_request *req, char *slot)
+{
+    char request[SURFFS_FETCHD_PATH_LEN + SURFFS_FETCHD_HOST_LEN +
+                 SURFFS_FETCHD_ETAG_LEN + SURFFS_FETCHD_DATE_LEN + 256];
+    size_t len;
+    long size = 0;
+    ssize_t n;
+    int fd;
+    int ret;
+
+    len = snprintf(request, sizeof(request), "GET %s HTTP/1.1\n"
+                                             "Host: %s\n"
+                                             "User-Agent: surffs_filesystem\n"
+                                             "Accept: text/html\n", req->path, req->host);
+    if (req->etag[0])
+        len += snprintf(request + len, sizeof(request) - len, "If-None-Match: %s\n", req->etag);
+    if (req->last_modified[0])
+        len += snprintf(request + len, sizeof(request) - len, "If-Modified-Since: %s\n",
+                        req->last_modified);
+    len += snprintf(request + len, sizeof(request) - len, "Connection: close\n\n");
+
+    fd = connect_origin(req);
+    if (fd < 0) return fd;
+
+    ret = send_all(fd, request, len);
+    if (ret)
+    {
+        close(fd);
+        return ret;
+    }
+
+    while (1)
+    {
+        if (size == SURFFS_FETCHD_SLOT_SIZE)
+        {
+            /*does not fit: kernel fetches it itself*/
+            size = -EFBIG;
+            break;
+        }
+
+        n = recv(fd, slot + size, SURFFS_FETCHD_SLOT_SIZE - size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0)
+        {
+            size = errno == EAGAIN ? -ETIMEDOUT : -errno;
+            break;
+        }
+        if (n == 0) break;
+        size += n;
+    }
+
+    close(fd);
+    return size;
+}
+
+/*size is length of response in slot or -errno*/
+static void send_reply(struct surffs_fetchd_request *req, long size)
+{
+    struct surffs_fetchd_reply reply;
+
+    reply.slot = req->slot;
+    reply.seq = req->seq;
+    reply.error = size < 0 ? size : 0;
+    reply.len = size < 0 ? 0 : size;
+
+    if (verbose)
+        fprintf(stderr, "slot %u: %s%s -> %d, %u bytes\n", reply.slot, req->host,
+                req->path, reply.error, reply.len);
+
+    pthread_mutex_lock(&reply_lock);
+    if (write(dev_fd, &reply, sizeof(reply)) != sizeof(reply))
+        fprintf(stderr, "slot %u: reply not taken: %s\n", reply.slot, strerror(errno));
+    pthread_mutex_unlock(&reply_lock);
+}
+
+static void *fetch_thread(void *arg)
+{
+    struct fetch_job *job = arg;
+
+    send_reply(&job->req, fetch_page(&job->req, job->slot));
+
+    free(job);
+    return 0;
+}
+
+static int serve(void)
+{
+    struct surffs_fetchd_request reqs[8];
+    struct fetch_job *job;
+    pthread_attr_t attr;
+    pthread_t thread;
+    ssize_t n;
+    int i;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    while (1)
+    {
+        n = read(dev_fd, reqs, sizeof(reqs));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0)
+        {
+            perror("read");
+            return 1;
+        }
+
+        for (i = 0; i < n / (ssize_t)sizeof(reqs[0]); i++)
+        {
+            job = malloc(sizeof(*job));
+            if (job)
+            {
+                job->req = reqs[i];
+                job->slot = area + (size_t)reqs[i].slot * SURFFS_FETCHD_SLOT_SIZE;
+                if (pthread_create(&thread, &attr, fetch_thread, job) == 0) continue;
+                free(job);
+            }
+
+            /*no thread for it: page is fetched by kernel*/
+            send_reply(&reqs[i], -ENODEV);
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *device = SURFFS_FETCHD_DEVICE;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'd': device = optarg; break;
+            case 'v': verbose = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-d device] [-v]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    dev_fd = open(device, O_RDWR);
+    if (dev_fd < 0)
+    {
+        fprintf(stderr, "%s: %s\n", device, strerror(errno));
+        return 1;
+    }
+
+    area = mmap(0, SURFFS_FETCHD_AREA_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, dev_fd, 0);
+    if (area == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    return serve();
+}